@@ -0,0 +1,34 @@
+#include "Affinity.h"
+#include <cstring>
+#include <iostream>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+
+bool pinCurrentThread(int cpu, const char* threadName) {
+    if (cpu < 0) return true;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (rc != 0) {
+        std::cerr << "WARNING: cannot pin " << threadName << " thread to CPU " << cpu << ": " << strerror(rc) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool parseCpuList(const std::string& text, std::vector<int>& cpus) {
+    cpus.clear();
+    std::istringstream iss(text);
+    std::string item;
+    while (std::getline(iss, item, ',')) {
+        if (item == "-") {
+            cpus.push_back(-1);
+            continue;
+        }
+        if (item.empty() || item.find_first_not_of("0123456789") != std::string::npos) return false;
+        cpus.push_back(std::stoi(item));
+    }
+    return !cpus.empty();
+}
@@ -0,0 +1,15 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <string>
+#include <vector>
+
+// Pins the calling thread to one CPU. A negative cpu leaves the thread unpinned.
+// Prints a warning and returns false if the kernel refuses the mask.
+bool pinCurrentThread(int cpu, const char* threadName);
+
+// Parses a comma separated CPU list ("2,3,-" - a dash leaves that position unpinned).
+// Returns false on malformed input.
+bool parseCpuList(const std::string& text, std::vector<int>& cpus);
+
+#endif // AFFINITY_H
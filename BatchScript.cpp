@@ -0,0 +1,121 @@
+#include "BatchScript.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+BatchScript::BatchScript(const std::string& path, RequestTracker& requests, const Wakeup& wakeup, Wakeup& ready,
+                         const ChatEvents& events)
+    : path(path), requests(requests), wakeup(wakeup), events(events), replies(wakeup, -1, &ready) {}
+
+BatchScript::~BatchScript() {
+    if (fd != -1) close(fd);
+}
+
+bool BatchScript::open() {
+    fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        std::cerr << "ERROR: Cannot open batch script " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    input = std::make_unique<InputLoop>(wakeup, fd);
+    scriptStart = std::chrono::steady_clock::now();
+    return true;
+}
+
+InputLoop::Event BatchScript::next(std::string& line) {
+    if (stopped) return InputLoop::Event::END_OF_INPUT;
+
+    while (true) {
+        // A line after an AUTH or JOIN waits until the client finished and handled it
+        if (requests.busy()) {
+            std::string unused;
+            InputLoop::Event event = replies.next(unused);
+            if (event == InputLoop::Event::READY) return event;
+            report("interrupted");
+            signal = replies.lastSignal();
+            return stop(event);
+        }
+        if (auto status = requests.takeHandled()) {
+            // A timeout was already reported by the client
+            if (*status == RequestStatus::CANCELLED) {
+                events.notice("ERROR: Connection lost while " + stepName + " (line " + std::to_string(firstLine) +
+                              ") waited for its REPLY");
+            }
+            if (*status != RequestStatus::OK) {
+                report(*status == RequestStatus::NOK ? "NOK" : *status == RequestStatus::CANCELLED ? "lost" : "timeout");
+                return stop(InputLoop::Event::END_OF_INPUT);
+            }
+            report("OK");
+        }
+
+        InputLoop::Event event = input->next(line);
+        if (event != InputLoop::Event::LINE) {
+            if (!stepName.empty()) report("done");
+            signal = input->lastSignal();
+            if (event == InputLoop::Event::END_OF_INPUT) printSummary();
+            stopped = true;
+            return event;
+        }
+        ++lineNumber;
+        if (line.empty() || line[0] == '#') continue;
+
+        // Consecutive chat messages form one step
+        bool isMessage = line[0] != '/';
+        if (isMessage && stepName == "MSG") {
+            lastLine = lineNumber;
+            ++messageCount;
+            return InputLoop::Event::LINE;
+        }
+        if (!stepName.empty()) report("done");
+        stepName = isMessage ? "MSG" : line.substr(0, line.find(' '));
+        firstLine = lastLine = lineNumber;
+        messageCount = isMessage ? 1 : 0;
+        stepStart = std::chrono::steady_clock::now();
+        return InputLoop::Event::LINE;
+    }
+}
+
+// Ends the script as failed
+InputLoop::Event BatchScript::stop(InputLoop::Event event) {
+    stopped = true;
+    hasFailed = true;
+    printSummary();
+    return event;
+}
+
+// Prints the timing of the current step and closes it
+void BatchScript::report(const std::string& outcome) {
+    if (stepName.empty()) return;
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - stepStart).count();
+    std::ostringstream out;
+    out << "batch: ";
+    if (messageCount > 0) {
+        if (lastLine > firstLine) out << "lines " << firstLine << "-" << lastLine;
+        else out << "line " << firstLine;
+        out << " " << messageCount << " message(s)";
+    } else {
+        out << "line " << firstLine << " " << stepName;
+    }
+    out << " " << outcome << " " << std::fixed << std::setprecision(3) << ms << " ms";
+    std::cerr << out.str() << std::endl;
+    stepName.clear();
+}
+
+// Prints the total time of the script
+void BatchScript::printSummary() {
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - scriptStart).count();
+    std::ostringstream out;
+    out << "batch: " << lineNumber << " line(s) of " << path << " in " << std::fixed << std::setprecision(3) << ms
+        << " ms, " << (hasFailed ? "FAILED" : "OK");
+    std::cerr << out.str() << std::endl;
+}
+
+void BatchScript::fail(const std::string& reason) {
+    events.notice("ERROR: batch script " + path + " failed: " + reason);
+    hasFailed = true;
+}
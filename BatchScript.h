@@ -0,0 +1,63 @@
+#ifndef BATCHSCRIPT_H
+#define BATCHSCRIPT_H
+
+#include "ChatEvents.h"
+#include "RequestTracker.h"
+#include "Shutdown.h"
+#include <chrono>
+#include <memory>
+#include <string>
+
+// Replaces stdin with a script (--batch FILE). Lines are handed out like typed input, but a
+// line after an AUTH or JOIN is only returned once the client's RequestTracker finished and
+// handled the request (REPLY, --reply-timeout or loss), so requests never overlap while chat
+// messages are sent back to back. Each step is timed on stderr
+// (consecutive messages form one step). A NOK, a missing REPLY or a lost connection stops the
+// script and marks the run as failed. Empty lines and lines starting with '#' are skipped.
+class BatchScript {
+public:
+    // `ready` is the client's held-input wakeup: while a request is busy, next() waits on it and
+    // returns READY, so the client's loop runs the finished handlers (releaseHeldInput())
+    BatchScript(const std::string& path, RequestTracker& requests, const Wakeup& wakeup, Wakeup& ready,
+                const ChatEvents& events);
+    ~BatchScript();
+
+    bool open();
+
+    // Same events as InputLoop::next(), READY while a request is being finished
+    InputLoop::Event next(std::string& line);
+    int lastSignal() const { return signal; }
+
+    // Marks the run as failed for a reason found after the script ended (undelivered messages)
+    void fail(const std::string& reason);
+    bool failed() const { return hasFailed; }
+
+private:
+    using TimePoint = std::chrono::steady_clock::time_point;
+
+    void printSummary();
+    void report(const std::string& outcome);
+    InputLoop::Event stop(InputLoop::Event event);
+
+    std::string path;
+    RequestTracker& requests;
+    const Wakeup& wakeup;
+    const ChatEvents& events;  // Errors are reported as notices
+    int fd = -1;
+    std::unique_ptr<InputLoop> input;
+    InputLoop replies;  // Waits for a request without reading the script
+    int signal = 0;
+    bool hasFailed = false;
+    bool stopped = false;
+
+    // Current step: one command, or a run of chat messages from firstLine to lastLine
+    std::string stepName;
+    size_t firstLine = 0;
+    size_t lastLine = 0;
+    size_t messageCount = 0;
+    size_t lineNumber = 0;
+    TimePoint stepStart;
+    TimePoint scriptStart;
+};
+
+#endif // BATCHSCRIPT_H
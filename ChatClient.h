@@ -1,7 +1,14 @@
 #ifndef CHATCLIENT_H
 #define CHATCLIENT_H
 
+#include "ChatEvents.h"
+#include "RequestTracker.h"
+#include "ShmInbox.h"
+#include "Shutdown.h"
+#include <atomic>
+#include <chrono>
 #include <string>
+#include <string_view>
 
 // Abstract base class representing a generic chat client.
 // This allows using either TCP or UDP clients with a common interface.
@@ -13,10 +20,96 @@ public:
     virtual bool connectToServer() = 0;
 
     // Start the main loop for user interaction and message handling.
+    // Equivalent to start(), feeding stdin to submitLine() and finish().
     virtual void run() = 0;
 
     // Send a BYE message before exiting.
     virtual void sendByeMessage() = 0;
+
+    // Starts the background threads without reading stdin (embedding)
+    virtual void start() = 0;
+
+    // Handles one line like typed input, a /command or a chat message.
+    // Returns false once the session has ended.
+    virtual bool submitLine(const std::string& line) = 0;
+
+    // Sends a chat message as it is, also when it starts with '/'
+    virtual bool sendChat(std::string_view content) = 0;
+
+    // Sends the input held while an AUTH/JOIN waited for its REPLY, once that is possible.
+    // run() calls it when heldInputReady() is notified, an embedder from its own thread.
+    virtual void releaseHeldInput() = 0;
+    Wakeup& heldInputReady() { return inputReady; }
+
+    // Waits until the input held behind outstanding requests is handled, so input that ends
+    // right after a /join still reaches the channel. Requests time out, the wait is bounded;
+    // it also stops at a termination signal, when `stop` is notified or the session ends.
+    void awaitHeldInput(const Wakeup& stop) {
+        InputLoop loop(stop, -1, &inputReady);
+        std::string unused;
+        releaseHeldInput();
+        while (!sessionEnded() && requests.busy()) {
+            if (loop.next(unused) != InputLoop::Event::READY) return;
+            releaseHeldInput();
+        }
+    }
+
+    // Sends BYE and waits for the drain (unless the session already ended), stops the
+    // background threads and returns exitStatus()
+    virtual int finish() = 0;
+
+    // How long an AUTH/JOIN waits for its REPLY before it fails (--reply-timeout)
+    void setReplyTimeout(std::chrono::milliseconds timeout) { requests.setTimeout(timeout); }
+
+    // Input descriptor of run() instead of stdin; -1 reads no input, the session then runs until
+    // a signal or the server ends it (--no-stdin)
+    void setInputFd(int fd) { inputFd = fd; }
+
+    // Shared-memory ring that run() polls next to stdin (--shm-ring), must outlive run()
+    void setInbox(ShmInbox* ring) { inbox = ring; }
+
+    // Replaces the console output, must be called before start()
+    void setEvents(ChatEvents handlers) { events = std::move(handlers); }
+
+    // True once the server ended the session (BYE, ERR) or a fatal error occurred
+    bool sessionEnded() const { return endStatus.load() >= 0; }
+
+    // Process exit status of the session: 0, or 1 after an error
+    int exitStatus() const {
+        int status = endStatus.load();
+        return status < 0 ? 0 : status;
+    }
+
+protected:
+    // Records the end of the session (the clients never exit the process). The first call wins
+    // and reports ChatEvents::ended; returns false for later calls.
+    bool markSessionEnded(int status) {
+        int running = -1;
+        if (!endStatus.compare_exchange_strong(running, status)) return false;
+        events.ended(status);
+        inputReady.notify();  // Nothing held is sent any more
+        return true;
+    }
+
+    // Sends the records waiting in the ring like input: chat records as they are, line records
+    // like typed lines. Returns false once the session has ended.
+    bool drainInbox() {
+        bool open = true;
+        inbox->drain([this, &open](std::string_view text, uint32_t flags) {
+            open = flags == SHM_RECORD_LINE ? submitLine(std::string(text)) : sendChat(text);
+            return open;
+        });
+        return open;
+    }
+
+    ChatEvents events = ChatEvents::console();
+    RequestTracker requests;  // AUTH/JOIN waiting for a REPLY and the input held meanwhile
+    Wakeup inputReady;        // Notified when a request finished and held input may be sent
+    int inputFd = STDIN_FILENO;
+    ShmInbox* inbox = nullptr;
+
+private:
+    std::atomic<int> endStatus{-1};
 };
 
 #endif // CHATCLIENT_H
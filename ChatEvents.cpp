@@ -0,0 +1,31 @@
+#include "ChatEvents.h"
+#include "JsonLineWriter.h"
+#include <iostream>
+#include <memory>
+
+ChatEvents ChatEvents::console() {
+    ChatEvents events;
+    events.onMessage = [](std::string_view from, std::string_view content) {
+        std::cout << from << ": " << content << std::endl;
+    };
+    events.onReply = [](bool success, std::string_view content) {
+        std::cout << (success ? "Action Success: " : "Action Failure: ") << content << std::endl;
+    };
+    events.onError = [](std::string_view from, std::string_view content) {
+        std::cout << "ERROR FROM " << from << ": " << content << std::endl;
+    };
+    events.onNotice = [](std::string_view text) {
+        std::cout << text << std::endl;
+    };
+    events.onInfo = [](std::string_view text) {
+        std::cout << text << std::endl;
+    };
+    return events;
+}
+
+ChatEvents ChatEvents::jsonLines(int fd) {
+    auto writer = std::make_shared<JsonLineWriter>(fd);
+    ChatEvents events;
+    events.onRecord = [writer](const ChatRecord& record) { writer->write(record); };
+    return events;
+}
@@ -0,0 +1,113 @@
+#ifndef CHATEVENTS_H
+#define CHATEVENTS_H
+
+#include <chrono>
+#include <functional>
+#include <string_view>
+
+// One event of a session with its metadata, for machine-readable output (--output jsonl)
+struct ChatRecord {
+    enum class Kind { MSG, REPLY, ERR, BYE, NOTICE, INFO, CONFIRMED, RETRANSMIT };
+
+    Kind kind = Kind::NOTICE;
+    std::chrono::steady_clock::time_point at;  // When it happened (received, confirmed, resent)
+    int messageId = -1;                        // UDP MessageID, -1 over TCP and for local notices
+    int refId = -1;                            // REPLY: MessageID of the request it answers (UDP)
+    bool success = false;                      // REPLY
+    int attempt = 0;                           // RETRANSMIT: 1 for the first retransmission
+    std::chrono::steady_clock::duration rtt{};  // CONFIRMED: from the first transmission
+    std::string_view from;                     // MSG, ERR
+    std::string_view content;                  // MSG, REPLY, ERR, NOTICE, INFO
+};
+
+// Inbound events of a chat session. The clients report through these callbacks instead of
+// writing to stdout, so the library can be embedded; the command-line client installs
+// console() which prints the usual lines. Every callback is optional. They run on the thread
+// that received the message (the render thread with --pipeline) and should return quickly.
+struct ChatEvents {
+    using TimePoint = std::chrono::steady_clock::time_point;
+
+    std::function<void(std::string_view from, std::string_view content)> onMessage;
+    std::function<void(bool success, std::string_view content)> onReply;
+    std::function<void(std::string_view from, std::string_view content)> onError;  // ERR from the server
+    std::function<void(std::string_view text)> onNotice;  // Local problems ("ERROR: ...")
+    std::function<void(std::string_view text)> onInfo;    // Output of local commands (/help, /history, /search)
+    std::function<void(int status)> onEnded;  // The server or a fatal error ended the session
+    std::function<void()> onServerLost;  // Liveness probing declared the server dead (--keepalive)
+    // Every event above plus BYE, CONFIRMs and retransmissions, with MessageIDs and timestamps.
+    // The record's strings are only valid during the call.
+    std::function<void(const ChatRecord& record)> onRecord;
+
+    // A zero `at` means now; the clients pass the receive time where they have it
+    void message(std::string_view from, std::string_view content, TimePoint at = {}, int messageId = -1) const {
+        if (onMessage) onMessage(from, content);
+        if (onRecord) record(ChatRecord::Kind::MSG, at, messageId, from, content);
+    }
+    void reply(bool success, std::string_view content, TimePoint at = {}, int messageId = -1, int refId = -1) const {
+        if (onReply) onReply(success, content);
+        if (onRecord) {
+            ChatRecord entry = makeRecord(ChatRecord::Kind::REPLY, at, messageId, {}, content);
+            entry.refId = refId;
+            entry.success = success;
+            onRecord(entry);
+        }
+    }
+    void error(std::string_view from, std::string_view content, TimePoint at = {}, int messageId = -1) const {
+        if (onError) onError(from, content);
+        if (onRecord) record(ChatRecord::Kind::ERR, at, messageId, from, content);
+    }
+    void notice(std::string_view text) const {
+        if (onNotice) onNotice(text);
+        if (onRecord) record(ChatRecord::Kind::NOTICE, {}, -1, {}, text);
+    }
+    void info(std::string_view text) const {
+        if (onInfo) onInfo(text);
+        if (onRecord) record(ChatRecord::Kind::INFO, {}, -1, {}, text);
+    }
+    void ended(int status) const {
+        if (onEnded) onEnded(status);
+    }
+    void serverLost() const {
+        if (onServerLost) onServerLost();
+    }
+    // Record-only events
+    void bye(TimePoint at = {}, int messageId = -1) const {
+        if (onRecord) record(ChatRecord::Kind::BYE, at, messageId, {}, {});
+    }
+    void confirmed(int messageId, TimePoint at, std::chrono::steady_clock::duration rtt) const {
+        if (!onRecord) return;
+        ChatRecord entry = makeRecord(ChatRecord::Kind::CONFIRMED, at, messageId, {}, {});
+        entry.rtt = rtt;
+        onRecord(entry);
+    }
+    void retransmitted(int messageId, int attempt, TimePoint at) const {
+        if (!onRecord) return;
+        ChatRecord entry = makeRecord(ChatRecord::Kind::RETRANSMIT, at, messageId, {}, {});
+        entry.attempt = attempt;
+        onRecord(entry);
+    }
+
+    // Prints events in the format of the IPK25-CHAT client specification
+    static ChatEvents console();
+
+    // Writes every event as one JSON object per line to `fd` (JsonLineWriter)
+    static ChatEvents jsonLines(int fd);
+
+private:
+    static ChatRecord makeRecord(ChatRecord::Kind kind, TimePoint at, int messageId, std::string_view from,
+                                 std::string_view content) {
+        ChatRecord entry;
+        entry.kind = kind;
+        entry.at = at == TimePoint{} ? std::chrono::steady_clock::now() : at;
+        entry.messageId = messageId;
+        entry.from = from;
+        entry.content = content;
+        return entry;
+    }
+    void record(ChatRecord::Kind kind, TimePoint at, int messageId, std::string_view from,
+                std::string_view content) const {
+        onRecord(makeRecord(kind, at, messageId, from, content));
+    }
+};
+
+#endif // CHATEVENTS_H
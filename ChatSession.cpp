@@ -0,0 +1,82 @@
+#include "ChatSession.h"
+#include "TcpChatClient.h"
+#include "UdpChatClient.h"
+
+std::unique_ptr<ChatSession> ChatSession::open(const ChatSessionConfig& config, ChatEvents events) {
+    std::unique_ptr<ChatClient> client;
+    if (config.transport == "tcp") {
+        auto tcp = std::make_unique<TcpChatClient>(config.server, config.port);
+        tcp->setReconnectPolicy(config.reconnect);
+        tcp->setDrainTimeout(config.drainTimeout);
+        if (config.sendRate > 0) tcp->setPacing(config.sendRate, config.sendBurst);
+        tcp->setHistoryLimits(config.history);
+        tcp->setLiveness(config.liveness);
+        client = std::move(tcp);
+    } else if (config.transport == "udp") {
+        auto udp = std::make_unique<UdpChatClient>(config.server, config.port, config.udpTimeoutMs, config.udpRetries);
+        udp->setReconnectPolicy(config.reconnect);
+        udp->setDrainTimeout(config.drainTimeout);
+        if (config.sendRate > 0) udp->setPacing(config.sendRate, config.sendBurst);
+        udp->setHistoryLimits(config.history);
+        udp->setLiveness(config.liveness);
+        client = std::move(udp);
+    } else {
+        events.notice("ERROR: Unknown transport: " + config.transport);
+        return nullptr;
+    }
+
+    client->setEvents(events);
+    client->setReplyTimeout(config.replyTimeout);
+    if (!client->connectToServer()) {
+        events.notice("ERROR: Could not connect to " + config.server + ":" + std::to_string(config.port));
+        return nullptr;
+    }
+    client->start();
+    return std::unique_ptr<ChatSession>(new ChatSession(std::move(client)));
+}
+
+ChatSession::ChatSession(std::unique_ptr<ChatClient> client) : client(std::move(client)) {
+    pump = std::thread([this]() {
+        InputLoop loop(pumpStop, -1, &this->client->heldInputReady());
+        std::string unused;
+        while (loop.next(unused) == InputLoop::Event::READY) this->client->releaseHeldInput();
+    });
+}
+
+ChatSession::~ChatSession() {
+    close();
+}
+
+bool ChatSession::auth(const std::string& username, const std::string& secret, const std::string& displayName) {
+    return command("/auth " + username + " " + secret + " " + displayName);
+}
+
+bool ChatSession::join(const std::string& channel) {
+    return command("/join " + channel);
+}
+
+bool ChatSession::rename(const std::string& displayName) {
+    return command("/rename " + displayName);
+}
+
+bool ChatSession::send(std::string_view content) {
+    if (closed) return false;
+    return client->sendChat(content);
+}
+
+bool ChatSession::command(const std::string& line) {
+    if (closed) return false;
+    return client->submitLine(line);
+}
+
+int ChatSession::close() {
+    if (!closed) {
+        closed = true;
+        pumpStop.notify();
+        pump.join();
+        Wakeup never;  // Only the session end or a timeout stops the wait
+        client->awaitHeldInput(never);
+        status = client->finish();
+    }
+    return status;
+}
@@ -0,0 +1,81 @@
+#ifndef CHATSESSION_H
+#define CHATSESSION_H
+
+#include "ChatClient.h"
+#include "ChatEvents.h"
+#include "History.h"
+#include "Liveness.h"
+#include "Reconnect.h"
+#include <chrono>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// Settings of an embedded session, the same knobs as the command-line options
+struct ChatSessionConfig {
+    std::string transport = "tcp";  // "tcp" or "udp"
+    std::string server;
+    int port = 4567;
+    int udpTimeoutMs = 250;         // -d
+    int udpRetries = 3;             // -r
+    ReconnectPolicy reconnect;      // --reconnect, off by default
+    std::chrono::milliseconds drainTimeout{2000};
+    double sendRate = 0;            // Messages per second, 0 = no pacing
+    double sendBurst = 1;
+    HistoryLimits history;          // Disabled unless messagesPerChannel is set
+    LivenessPolicy liveness;        // Off by default, ChatEvents::onServerLost reports a dead server
+    std::chrono::milliseconds replyTimeout{5000};  // AUTH/JOIN without a REPLY fail after this
+};
+
+// Entry point of libipk25chat: one IPK25-CHAT session over TCP or UDP. Inbound messages,
+// replies and errors arrive through the ChatEvents callbacks on a background thread; nothing is
+// read from stdin and the process is never terminated. The request methods return false once
+// the session has ended (BYE or ERR from the server, or a fatal error), close() then reports 1
+// after an error and 0 otherwise.
+//
+//     ChatEvents events;
+//     events.onMessage = [](std::string_view from, std::string_view text) { ... };
+//     auto session = ChatSession::open(config, events);
+//     session->auth("user", "secret", "Name");
+//     session->send("hello");
+//     int status = session->close();
+class ChatSession {
+public:
+    // Connects and starts the background threads. Returns nullptr after reporting the problem
+    // through ChatEvents::onNotice when the transport is unknown or the server unreachable.
+    static std::unique_ptr<ChatSession> open(const ChatSessionConfig& config, ChatEvents events);
+
+    ChatSession(const ChatSession&) = delete;
+    ChatSession& operator=(const ChatSession&) = delete;
+    ~ChatSession();  // Closes the session if close() was not called
+
+    // Requests answered by a REPLY, delivered to ChatEvents::onReply
+    bool auth(const std::string& username, const std::string& secret, const std::string& displayName);
+    bool join(const std::string& channel);
+
+    // Changes the local display name, nothing is sent
+    bool rename(const std::string& displayName);
+
+    // Sends a chat message verbatim, content over the protocol limit is split
+    bool send(std::string_view content);
+
+    // Handles a line exactly like the command-line client does (/auth, /join, /send, ...)
+    bool command(const std::string& line);
+
+    bool ended() const { return client->sessionEnded(); }
+
+    // Sends BYE, waits for the drain timeout at most and stops the threads. Idempotent.
+    int close();
+
+private:
+    explicit ChatSession(std::unique_ptr<ChatClient> client);
+
+    std::unique_ptr<ChatClient> client;
+    Wakeup pumpStop;
+    std::thread pump;  // Sends the input held behind an AUTH/JOIN once its REPLY arrived
+    bool closed = false;
+    int status = 0;
+};
+
+#endif // CHATSESSION_H
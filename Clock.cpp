@@ -0,0 +1,31 @@
+#include "Clock.h"
+#include <thread>
+
+Clock& Clock::system() {
+    static SystemClock instance;
+    return instance;
+}
+
+Clock::time_point SystemClock::now() {
+    return std::chrono::steady_clock::now();
+}
+
+void SystemClock::sleepFor(std::chrono::nanoseconds duration) {
+    std::this_thread::sleep_for(duration);
+}
+
+// The virtual time starts one second after the steady_clock epoch, so no valid
+// time point is zero (the clients use 0 as "no timestamp")
+VirtualClock::VirtualClock() : current(std::chrono::seconds(1)) {}
+
+Clock::time_point VirtualClock::now() {
+    return current;
+}
+
+void VirtualClock::sleepFor(std::chrono::nanoseconds duration) {
+    current += std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration);
+}
+
+void VirtualClock::advanceTo(time_point target) {
+    if (target > current) current = target;
+}
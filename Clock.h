@@ -0,0 +1,46 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <chrono>
+
+// Time source used by the clients for timeouts and retransmissions.
+// The real clients use the system clock, the simulator (SimNetwork) a virtual one.
+class Clock {
+public:
+    using time_point = std::chrono::steady_clock::time_point;
+
+    virtual ~Clock() {}
+
+    // Returns the current time
+    virtual time_point now() = 0;
+
+    // Blocks (or, for a virtual clock, advances time) for the given duration
+    virtual void sleepFor(std::chrono::nanoseconds duration) = 0;
+
+    // Returns the shared wall-clock instance
+    static Clock& system();
+};
+
+// Clock backed by std::chrono::steady_clock
+class SystemClock : public Clock {
+public:
+    time_point now() override;
+    void sleepFor(std::chrono::nanoseconds duration) override;
+};
+
+// Clock that only moves when told to, so simulations are fast and reproducible
+class VirtualClock : public Clock {
+public:
+    VirtualClock();
+
+    time_point now() override;
+    void sleepFor(std::chrono::nanoseconds duration) override;
+
+    // Moves the time forward to the given point (never backwards)
+    void advanceTo(time_point target);
+
+private:
+    time_point current;
+};
+
+#endif // CLOCK_H
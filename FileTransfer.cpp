@@ -0,0 +1,173 @@
+#include "FileTransfer.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::vector<std::string_view> splitMessageContent(std::string_view content, size_t limit) {
+    std::vector<std::string_view> pieces;
+    while (content.size() > limit) {
+        // Prefer to end the piece after a line break or a space
+        size_t cut = content.find_last_of("\n ", limit - 1);
+        if (cut == std::string_view::npos || cut == 0) {
+            // No boundary, cut hard but step back over UTF-8 continuation bytes
+            cut = limit;
+            while (cut > 0 && (static_cast<unsigned char>(content[cut]) & 0xC0) == 0x80) --cut;
+            if (cut == 0) cut = limit;
+        } else {
+            ++cut;  // The separator stays at the end of the piece
+        }
+        pieces.push_back(content.substr(0, cut));
+        content.remove_prefix(cut);
+    }
+    if (!content.empty()) {
+        pieces.push_back(content);
+    }
+    return pieces;
+}
+
+MappedFile::~MappedFile() {
+    if (data != nullptr) {
+        munmap(data, length);
+    }
+}
+
+bool MappedFile::open(const std::string& path, std::string& error) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error = "ERROR: Unable to open file " + path + ": " + std::strerror(errno);
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) < 0 || !S_ISREG(info.st_mode)) {
+        error = "ERROR: " + path + " is not a regular file";
+        ::close(fd);
+        return false;
+    }
+    length = static_cast<size_t>(info.st_size);
+    if (length > 0) {
+        data = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            error = "ERROR: Unable to map file " + path + ": " + std::strerror(errno);
+            data = nullptr;
+            length = 0;
+            ::close(fd);
+            return false;
+        }
+        // The file is read once from start to end
+        madvise(data, length, MADV_SEQUENTIAL);
+    }
+    ::close(fd);  // The mapping stays valid
+    return true;
+}
+
+bool FileTransfer::open() {
+    if (!file.open(path, errorText)) {
+        return false;
+    }
+    std::string_view contents = file.contents();
+    if (contents.empty()) {
+        errorText = "ERROR: " + path + " is empty";
+        return false;
+    }
+    binary = std::any_of(contents.begin(), contents.end(), [](char c) {
+        return c != '\n' && (c < 0x20 || c > 0x7E);
+    });
+
+    // The marker length depends on the number of chunks, split again until it is stable
+    size_t count = 1;
+    while (true) {
+        size_t payloadLimit = MAX_MESSAGE_CONTENT - markerLength(count);
+        chunks.clear();
+        if (binary) {
+            splitBinary(payloadLimit);
+        } else {
+            splitText(payloadLimit);
+        }
+        if (markerLength(chunks.size()) == markerLength(count)) break;
+        count = chunks.size();
+    }
+    std::cerr << "Sending " << path << ": " << contents.size() << " bytes in " << chunks.size()
+              << " message(s)" << (binary ? " (base64)" : "") << std::endl;
+    return true;
+}
+
+// "[i/n] " or "[i/n base64] " with i printed at most as wide as n
+size_t FileTransfer::markerLength(size_t count) const {
+    size_t digits = std::to_string(count).size();
+    return 2 * digits + 4 + (binary ? 7 : 0);
+}
+
+void FileTransfer::splitText(size_t payloadLimit) {
+    chunks = splitMessageContent(file.contents(), payloadLimit);
+}
+
+// Every chunk carries a whole number of 3-byte groups, so it encodes without padding
+// except for the last one
+void FileTransfer::splitBinary(size_t payloadLimit) {
+    size_t rawLimit = payloadLimit / 4 * 3;
+    std::string_view contents = file.contents();
+    for (size_t offset = 0; offset < contents.size(); offset += rawLimit) {
+        chunks.push_back(contents.substr(offset, rawLimit));
+    }
+}
+
+size_t FileTransfer::window() const {
+    size_t largest = 0;
+    for (std::string_view piece : chunks) largest = std::max(largest, piece.size());
+    if (binary) largest = largest / 3 * 4 + 4;
+    return std::clamp<size_t>(SEND_WINDOW_BYTES / std::max<size_t>(largest, 1), 1, SEND_WINDOW);
+}
+
+// Standard base64 with padding
+static void appendBase64(std::string& out, std::string_view raw) {
+    static const char ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t i = 0;
+    for (; i + 3 <= raw.size(); i += 3) {
+        uint32_t group = static_cast<uint8_t>(raw[i]) << 16 | static_cast<uint8_t>(raw[i + 1]) << 8 |
+                         static_cast<uint8_t>(raw[i + 2]);
+        out += ALPHABET[group >> 18];
+        out += ALPHABET[(group >> 12) & 0x3F];
+        out += ALPHABET[(group >> 6) & 0x3F];
+        out += ALPHABET[group & 0x3F];
+    }
+    size_t rest = raw.size() - i;
+    if (rest > 0) {
+        uint32_t group = static_cast<uint8_t>(raw[i]) << 16;
+        if (rest == 2) group |= static_cast<uint8_t>(raw[i + 1]) << 8;
+        out += ALPHABET[group >> 18];
+        out += ALPHABET[(group >> 12) & 0x3F];
+        out += rest == 2 ? ALPHABET[(group >> 6) & 0x3F] : '=';
+        out += '=';
+    }
+}
+
+std::string FileTransfer::chunk(size_t index) const {
+    std::string content = "[" + std::to_string(index + 1) + "/" + std::to_string(chunks.size()) +
+                          (binary ? " base64] " : "] ");
+    if (binary) {
+        content.reserve(content.size() + (chunks[index].size() + 2) / 3 * 4);
+        appendBase64(content, chunks[index]);
+    } else {
+        content.append(chunks[index]);
+    }
+    return content;
+}
+
+void FileTransfer::report(std::chrono::steady_clock::duration elapsed) const {
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    size_t bytes = file.contents().size();
+    std::ostringstream line;
+    line << "File " << path << " sent: " << bytes << " bytes in " << chunks.size() << " message(s), "
+         << std::fixed << std::setprecision(2) << seconds << " s, "
+         << bytes / 1024.0 / std::max(seconds, 1e-6) << " KiB/s";
+    std::cerr << line.str() << std::endl;
+}
@@ -0,0 +1,78 @@
+#ifndef FILETRANSFER_H
+#define FILETRANSFER_H
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Longest MessageContent allowed by IPK25-CHAT
+constexpr size_t MAX_MESSAGE_CONTENT = 60000;
+
+// Limits of the chunks a /send transfer keeps in flight (sent but not yet confirmed or still
+// queued). Full-size chunks easily overflow the peer's socket receive buffer (around 200 KiB by
+// default on Linux), so the window is given in bytes as well as in messages.
+constexpr size_t SEND_WINDOW = 32;
+constexpr size_t SEND_WINDOW_BYTES = 128 * 1024;
+
+// Splits content longer than `limit` into pieces of at most `limit` bytes. A piece ends after
+// the last line break or space that fits, otherwise it is cut hard, but never inside a UTF-8
+// sequence. Short content is returned as a single piece.
+std::vector<std::string_view> splitMessageContent(std::string_view content, size_t limit = MAX_MESSAGE_CONTENT);
+
+// Read-only mapping of a whole file
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Maps the file, returns false with the reason in `error` on failure
+    bool open(const std::string& path, std::string& error);
+
+    std::string_view contents() const { return std::string_view(static_cast<const char*>(data), length); }
+
+private:
+    void* data = nullptr;
+    size_t length = 0;
+};
+
+// One file sent as a sequence of chat messages (/send).
+// Every message starts with a "[i/n] " marker. Files made only of printable ASCII and line
+// feeds are sent as they are and split at line or word boundaries. Anything else is sent
+// base64 encoded with a "[i/n base64] " marker.
+class FileTransfer {
+public:
+    explicit FileTransfer(const std::string& path) : path(path) {}
+
+    // Maps and splits the file, returns false if it cannot be sent (reason in error())
+    bool open();
+    const std::string& error() const { return errorText; }
+
+    size_t chunkCount() const { return chunks.size(); }
+
+    // Number of chunks that may be in flight at once (at least 1)
+    size_t window() const;
+
+    // Builds the message content of the given chunk (0-based), marker included
+    std::string chunk(size_t index) const;
+
+    // Prints the completion line with throughput on stderr
+    void report(std::chrono::steady_clock::duration elapsed) const;
+
+private:
+    size_t markerLength(size_t count) const;
+    void splitText(size_t payloadLimit);
+    void splitBinary(size_t payloadLimit);
+
+    std::string path;
+    MappedFile file;
+    bool binary = false;
+    std::vector<std::string_view> chunks;  // Slices of the mapped file
+    std::string errorText;
+};
+
+#endif // FILETRANSFER_H
@@ -0,0 +1,620 @@
+#include "Gateway.h"
+#include "MessageTcp.h"
+#include "Stats.h"
+#include "UdpCommandBuilder.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <netdb.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+// epoll tags of the two descriptors that are not sessions
+char udpTag;
+char stopTag;
+
+// Display name the gateway uses for its own ERR and BYE towards the clients
+const char* const GATEWAY_NAME = "gateway";
+
+// Splits `count` NUL-terminated strings off the payload, false if they are not all there
+bool payloadFields(const std::pmr::vector<uint8_t>& payload, size_t count, std::string_view* fields) {
+    const char* data = reinterpret_cast<const char*>(payload.data());
+    size_t pos = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (pos >= payload.size()) return false;
+        const void* end = std::memchr(data + pos, '\0', payload.size() - pos);
+        if (end == nullptr) return false;
+        size_t length = static_cast<size_t>(static_cast<const char*>(end) - (data + pos));
+        fields[i] = std::string_view(data + pos, length);
+        pos += length + 1;
+    }
+    return true;
+}
+
+// Splits the next space separated word off `rest`
+std::string_view nextWord(std::string_view& rest) {
+    size_t start = rest.find_first_not_of(' ');
+    if (start == std::string_view::npos) {
+        rest = std::string_view();
+        return rest;
+    }
+    size_t end = std::min(rest.find(' ', start), rest.size());
+    std::string_view word = rest.substr(start, end - start);
+    rest.remove_prefix(end);
+    return word;
+}
+
+// Case-insensitive keyword comparison, the TCP variant ignores the case of keywords
+bool keywordIs(std::string_view word, std::string_view keyword) {
+    if (word.size() != keyword.size()) return false;
+    for (size_t i = 0; i < word.size(); ++i) {
+        if (std::toupper(static_cast<unsigned char>(word[i])) != keyword[i]) return false;
+    }
+    return true;
+}
+
+// Content after "... IS "
+std::string_view contentAfterIs(std::string_view rest) {
+    if (!rest.empty() && rest.front() == ' ') rest.remove_prefix(1);
+    return rest;
+}
+
+uint64_t clientKey(const sockaddr_in& addr) {
+    return (static_cast<uint64_t>(addr.sin_addr.s_addr) << 16) | addr.sin_port;
+}
+
+}  // namespace
+
+bool transcodeUdpToTcp(const UdpMessage& msg, std::string& line, std::string& displayName) {
+    std::string_view fields[3];
+    switch (msg.type) {
+    case UdpMessageType::AUTH:  // Username, DisplayName, Secret
+        if (!payloadFields(msg.payload, 3, fields)) return false;
+        displayName.assign(fields[1]);
+        line = Message::createAuthMessage(std::string(fields[0]), displayName, std::string(fields[2])).getContent();
+        break;
+    case UdpMessageType::JOIN:  // ChannelID, DisplayName
+        if (!payloadFields(msg.payload, 2, fields)) return false;
+        displayName.assign(fields[1]);
+        line = Message::createJoinMessage(std::string(fields[0]), displayName).getContent();
+        break;
+    case UdpMessageType::MSG:  // DisplayName, MessageContent; the hot path, built in place
+        if (!payloadFields(msg.payload, 2, fields)) return false;
+        displayName.assign(fields[0]);
+        line.assign("MSG FROM ").append(fields[0]).append(" IS ").append(fields[1]);
+        break;
+    case UdpMessageType::ERR:
+        if (!payloadFields(msg.payload, 2, fields)) return false;
+        displayName.assign(fields[0]);
+        line = Message::createErrorMessage(displayName, std::string(fields[1])).getContent();
+        break;
+    case UdpMessageType::BYE:
+        if (!payloadFields(msg.payload, 1, fields)) return false;
+        displayName.assign(fields[0]);
+        line = Message::createByeMessage(displayName).getContent();
+        break;
+    default:
+        return false;
+    }
+    line.append("\r\n");
+    return true;
+}
+
+bool transcodeTcpToUdp(std::string_view line, uint16_t messageId, uint16_t refId, UdpMessage& msg) {
+    std::string_view rest = line;
+    std::string_view keyword = nextWord(rest);
+
+    if (keywordIs(keyword, "REPLY")) {  // REPLY OK|NOK IS {MessageContent}
+        std::string_view status = nextWord(rest);
+        bool ok = keywordIs(status, "OK");
+        if ((!ok && !keywordIs(status, "NOK")) || !keywordIs(nextWord(rest), "IS")) return false;
+        msg = buildReplyUdpMessage(std::string(contentAfterIs(rest)), messageId, refId, ok ? 1 : 0);
+        return true;
+    }
+
+    bool isMsg = keywordIs(keyword, "MSG");
+    if (isMsg || keywordIs(keyword, "ERR")) {  // MSG|ERR FROM {DisplayName} IS {MessageContent}
+        if (!keywordIs(nextWord(rest), "FROM")) return false;
+        std::string_view from = nextWord(rest);
+        if (from.empty() || !keywordIs(nextWord(rest), "IS")) return false;
+        msg = buildMsgUdpMessage(std::string(from), std::string(contentAfterIs(rest)), messageId);
+        if (!isMsg) msg.type = UdpMessageType::ERR;  // Same payload layout
+        return true;
+    }
+
+    if (keywordIs(keyword, "BYE")) {  // BYE FROM {DisplayName}
+        if (!keywordIs(nextWord(rest), "FROM")) return false;
+        std::string_view from = nextWord(rest);
+        if (from.empty()) return false;
+        std::vector<uint8_t> name = packString(std::string(from));
+        msg.type = UdpMessageType::BYE;
+        msg.messageId = messageId;
+        msg.payload.assign(name.begin(), name.end());
+        return true;
+    }
+    return false;
+}
+
+bool DedupWindow::seen(uint16_t id) {
+    if (!started) {
+        started = true;
+        newest = id;
+        bits.reset();
+        bits.set(0);
+        return false;
+    }
+    int16_t ahead = static_cast<int16_t>(static_cast<uint16_t>(id - newest));
+    if (ahead > 0) {
+        bits = ahead >= WINDOW ? std::bitset<WINDOW>() : bits << static_cast<size_t>(ahead);
+        bits.set(0);
+        newest = id;
+        return false;
+    }
+    int behind = -ahead;
+    if (behind >= WINDOW || bits.test(static_cast<size_t>(behind))) return true;
+    bits.set(static_cast<size_t>(behind));
+    return false;
+}
+
+struct Gateway::Session {
+    // A message sent to the client that waits for its CONFIRM
+    struct Unconfirmed {
+        uint16_t messageId;
+        std::vector<uint8_t> bytes;
+        TimePoint sentAt;
+        int retries = 0;
+    };
+
+    sockaddr_in client{};
+    uint64_t key = 0;
+    int fd = -1;                  // Upstream TCP connection, -1 once closed
+    bool connected = false;
+    bool writeInterest = false;   // EPOLLOUT registered
+    bool closing = false;         // BYE or ERR seen, ends once the client confirmed everything
+    bool retired = false;
+    std::string displayName;      // Last name the client used, for BYE/ERR upstream
+    std::string inbound;          // Incomplete line from the server
+    std::string outbound;         // Lines the server socket did not take yet
+    DedupWindow received;
+    uint16_t nextMessageId = 0;   // Towards the client
+    std::deque<uint16_t> requests;  // MessageIDs of AUTH/JOIN waiting for a REPLY, in order
+    std::vector<Unconfirmed> unconfirmed;
+};
+
+Gateway::Gateway(const GatewayConfig& config, const Wakeup& stop) : config(config), stop(stop) {}
+
+Gateway::~Gateway() {
+    for (auto& entry : sessions) closeUpstream(*entry.second);
+    if (epollFd != -1) close(epollFd);
+    if (udpFd != -1) close(udpFd);
+}
+
+bool Gateway::open() {
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    int rc = getaddrinfo(config.server.c_str(), std::to_string(config.serverPort).c_str(), &hints, &result);
+    if (rc != 0 || result == nullptr) {
+        std::cerr << "ERROR: Cannot resolve " << config.server << ": " << gai_strerror(rc) << std::endl;
+        return false;
+    }
+    std::memcpy(&serverAddr, result->ai_addr, sizeof(serverAddr));
+    freeaddrinfo(result);
+
+    udpFd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (udpFd == -1) {
+        perror("socket");
+        return false;
+    }
+    int one = 1;
+    if (setsockopt(udpFd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) == -1) perror("SO_REUSEPORT");
+    // One socket takes the bursts of every session of the loop, the default buffer holds only a
+    // few hundred datagrams (capped by net.core.rmem_max)
+    int receiveBuffer = 4 * 1024 * 1024;
+    if (setsockopt(udpFd, SOL_SOCKET, SO_RCVBUF, &receiveBuffer, sizeof(receiveBuffer)) == -1) perror("SO_RCVBUF");
+    sockaddr_in local{};
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(config.listenPort);
+    if (bind(udpFd, reinterpret_cast<const sockaddr*>(&local), sizeof(local)) == -1) {
+        perror("bind");
+        return false;
+    }
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd == -1) {
+        perror("epoll_create1");
+        return false;
+    }
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.ptr = &udpTag;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, udpFd, &event);
+    event.data.ptr = &stopTag;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, stop.fd(), &event);
+    return true;
+}
+
+void Gateway::run() {
+    // Retransmissions are checked a few times per confirmation timeout
+    auto tick = std::chrono::milliseconds(std::clamp(config.timeoutMs / 4, 10, 100));
+    TimePoint nextCheck = std::chrono::steady_clock::now() + tick;
+    epoll_event events[256];
+    bool stopping = false;
+
+    while (!stopping) {
+        auto wait = std::chrono::ceil<std::chrono::milliseconds>(nextCheck - std::chrono::steady_clock::now());
+        int count = epoll_wait(epollFd, events, 256, static_cast<int>(std::max<int64_t>(0, wait.count())));
+        if (count == -1) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < count; ++i) {
+            void* tag = events[i].data.ptr;
+            if (tag == &udpTag) {
+                receiveDatagrams();
+            } else if (tag == &stopTag) {
+                stopping = true;
+            } else {
+                Session* session = static_cast<Session*>(tag);
+                if (!session->retired) handleUpstream(*session, events[i].events);
+            }
+        }
+        purgeRetired();
+
+        TimePoint now = std::chrono::steady_clock::now();
+        if (now >= nextCheck) {
+            checkRetransmissions(now);
+            purgeRetired();
+            nextCheck = now + tick;
+        }
+    }
+
+    // The gateway goes away: end every session on both sides, best effort
+    for (auto& entry : sessions) {
+        Session& session = *entry.second;
+        if (session.fd != -1 && session.connected && !session.closing && !session.displayName.empty()) {
+            std::string bye = Message::createByeMessage(session.displayName).getContent() + "\r\n";
+            if (::send(session.fd, bye.data(), bye.size(), MSG_NOSIGNAL) == -1 && errno != EAGAIN) perror("send");
+        }
+        if (!session.closing) {
+            UdpMessage bye{UdpMessageType::BYE, session.nextMessageId++, {}};
+            std::vector<uint8_t> name = packString(GATEWAY_NAME);
+            bye.payload.assign(name.begin(), name.end());
+            std::vector<uint8_t> bytes = packUdpMessage(bye);
+            sendto(udpFd, bytes.data(), bytes.size(), 0, reinterpret_cast<const sockaddr*>(&session.client),
+                   sizeof(session.client));
+        }
+        closeUpstream(session);
+    }
+    counters.sessions.store(0, std::memory_order_relaxed);
+    sessions.clear();
+}
+
+// Drains the UDP socket, a bounded number of datagrams per wakeup so the TCP side is not starved
+void Gateway::receiveDatagrams() {
+    uint8_t buffer[65536];
+    for (int i = 0; i < 64; ++i) {
+        sockaddr_in from{};
+        socklen_t fromLength = sizeof(from);
+        ssize_t length = recvfrom(udpFd, buffer, sizeof(buffer), 0, reinterpret_cast<sockaddr*>(&from), &fromLength);
+        if (length == -1) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("recvfrom");
+                statAdd(threadCounters().receiveErrors);
+            }
+            return;
+        }
+        handleDatagram(buffer, static_cast<size_t>(length), from);
+    }
+}
+
+void Gateway::handleDatagram(const uint8_t* data, size_t length, const sockaddr_in& from) {
+    if (length < 3) return;  // Not even a header
+    statMessageReceived(statKindFromUdpType(data[0]), length);
+    UdpMessageType type = static_cast<UdpMessageType>(data[0]);
+    uint16_t messageId = static_cast<uint16_t>((data[1] << 8) | data[2]);
+
+    auto found = sessions.find(clientKey(from));
+    Session* session = found == sessions.end() ? nullptr : found->second.get();
+    if (session != nullptr && session->retired) return;
+
+    if (type == UdpMessageType::CONFIRM) {
+        if (session == nullptr) return;
+        auto& pending = session->unconfirmed;
+        pending.erase(std::remove_if(pending.begin(), pending.end(),
+                                     [messageId](const Session::Unconfirmed& entry) { return entry.messageId == messageId; }),
+                      pending.end());
+        finishIfDone(*session);
+        return;
+    }
+
+    sendConfirm(messageId, from);
+    if (session == nullptr) {
+        if (type != UdpMessageType::AUTH) return;  // E.g. a retransmitted BYE of a finished session
+        session = openSession(from);
+    }
+    if (session->received.seen(messageId)) {
+        counters.duplicates.fetch_add(1, std::memory_order_relaxed);
+        statAdd(threadCounters().duplicatesDropped);
+        return;
+    }
+    if (type == UdpMessageType::PING || session->closing) return;
+
+    UdpMessage msg;
+    std::string line;
+    if (!unpackUdpMessage(data, length, msg) || !transcodeUdpToTcp(msg, line, session->displayName)) {
+        sendError(*session, "Malformed message from the client", true);
+        return;
+    }
+    if (msg.type == UdpMessageType::AUTH || msg.type == UdpMessageType::JOIN) {
+        session->requests.push_back(messageId);
+    }
+    counters.upstream.fetch_add(1, std::memory_order_relaxed);
+    sendUpstream(*session, line);
+    if (msg.type == UdpMessageType::BYE || msg.type == UdpMessageType::ERR) {
+        session->closing = true;
+        finishIfDone(*session);
+    }
+}
+
+// Starts a session with a non-blocking connect, the AUTH waits in `outbound` until it completes
+Gateway::Session* Gateway::openSession(const sockaddr_in& from) {
+    auto owned = std::make_unique<Session>();
+    Session* session = owned.get();
+    session->client = from;
+    session->key = clientKey(from);
+    sessions.emplace(session->key, std::move(owned));
+    counters.sessions.fetch_add(1, std::memory_order_relaxed);
+    counters.sessionsOpened.fetch_add(1, std::memory_order_relaxed);
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        perror("socket");
+        sendError(*session, "Server unreachable", false);
+        return session;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));  // Chat lines are small
+    if (connect(fd, reinterpret_cast<const sockaddr*>(&serverAddr), sizeof(serverAddr)) == -1 && errno != EINPROGRESS) {
+        perror("connect");
+        close(fd);
+        sendError(*session, "Server unreachable", false);
+        return session;
+    }
+    session->fd = fd;
+    session->writeInterest = true;  // Reports the end of the connect
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLOUT;
+    event.data.ptr = session;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+    return session;
+}
+
+void Gateway::handleUpstream(Session& session, uint32_t events) {
+    if (session.fd == -1) return;
+    if (!session.connected) {
+        if (!(events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) return;
+        int error = 0;
+        socklen_t errorLength = sizeof(error);
+        getsockopt(session.fd, SOL_SOCKET, SO_ERROR, &error, &errorLength);
+        if (error != 0) {
+            std::cerr << "ERROR: Connecting to the server failed: " << std::strerror(error) << std::endl;
+            closeUpstream(session);
+            sendError(session, "Server unreachable", false);
+            return;
+        }
+        session.connected = true;
+        flushUpstream(session);
+    }
+
+    if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+        char buffer[16384];
+        bool lost = false;
+        while (true) {
+            ssize_t n = read(session.fd, buffer, sizeof(buffer));
+            if (n > 0) {
+                session.inbound.append(buffer, static_cast<size_t>(n));
+                if (static_cast<size_t>(n) < sizeof(buffer)) break;
+                continue;
+            }
+            if (n == -1 && errno == EINTR) continue;
+            if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            lost = true;  // Closed by the server or failed
+            break;
+        }
+
+        size_t start = 0;
+        size_t end;
+        while (session.fd != -1 && (end = session.inbound.find("\r\n", start)) != std::string::npos) {
+            handleServerLine(session, std::string_view(session.inbound).substr(start, end - start));
+            start = end + 2;
+        }
+        session.inbound.erase(0, start);
+
+        if (lost && session.fd != -1) {
+            closeUpstream(session);
+            if (!session.closing) sendError(session, "Connection to the server lost", false);
+            finishIfDone(session);
+            return;
+        }
+    }
+
+    if (session.fd != -1 && (events & EPOLLOUT)) flushUpstream(session);
+}
+
+void Gateway::handleServerLine(Session& session, std::string_view line) {
+    statMessageReceived(statKindFromTcpLine(line), line.size() + 2);
+    if (session.closing) return;  // The client already said BYE
+
+    // REPLYs come in the order of the requests
+    uint16_t refId = 0;
+    std::string_view rest = line;
+    if (keywordIs(nextWord(rest), "REPLY")) {
+        if (session.requests.empty()) {
+            std::cerr << "Dropping REPLY without a request: " << line << std::endl;
+            return;
+        }
+        refId = session.requests.front();
+        session.requests.pop_front();
+    }
+
+    UdpMessage msg;
+    if (!transcodeTcpToUdp(line, session.nextMessageId, refId, msg)) {
+        std::cerr << "ERROR: Malformed message from the server: " << line << std::endl;
+        sendError(session, "Malformed message from the server", true);
+        return;
+    }
+    session.nextMessageId++;
+    counters.downstream.fetch_add(1, std::memory_order_relaxed);
+    sendReliable(session, msg);
+    if (msg.type == UdpMessageType::BYE || msg.type == UdpMessageType::ERR) {
+        session.closing = true;
+        closeUpstream(session);
+    }
+}
+
+void Gateway::sendUpstream(Session& session, const std::string& line) {
+    if (session.fd == -1) return;
+    statMessageSent(statKindFromTcpLine(line), line.size());
+    session.outbound.append(line);
+    flushUpstream(session);
+}
+
+// Writes as much of `outbound` as the socket takes, EPOLLOUT reports when it takes more
+void Gateway::flushUpstream(Session& session) {
+    if (session.fd == -1 || !session.connected) return;
+    size_t written = 0;
+    while (written < session.outbound.size()) {
+        ssize_t n = ::send(session.fd, session.outbound.data() + written, session.outbound.size() - written,
+                           MSG_NOSIGNAL);
+        if (n > 0) {
+            written += static_cast<size_t>(n);
+            continue;
+        }
+        if (n == -1 && errno == EINTR) continue;
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        perror("send");
+        closeUpstream(session);
+        if (!session.closing) sendError(session, "Connection to the server lost", false);
+        finishIfDone(session);
+        return;
+    }
+    session.outbound.erase(0, written);
+    updateInterest(session);
+    finishIfDone(session);
+}
+
+void Gateway::updateInterest(Session& session) {
+    bool wanted = !session.connected || !session.outbound.empty();
+    if (session.fd == -1 || wanted == session.writeInterest) return;
+    epoll_event event{};
+    event.events = wanted ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+    event.data.ptr = &session;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, session.fd, &event);
+    session.writeInterest = wanted;
+}
+
+void Gateway::sendReliable(Session& session, const UdpMessage& msg) {
+    Session::Unconfirmed entry{msg.messageId, packUdpMessage(msg), std::chrono::steady_clock::now()};
+    if (sendto(udpFd, entry.bytes.data(), entry.bytes.size(), 0, reinterpret_cast<const sockaddr*>(&session.client),
+               sizeof(session.client)) == -1) {
+        perror("sendto");
+    }
+    statMessageSent(statKindFromUdpType(entry.bytes[0]), entry.bytes.size());
+    session.unconfirmed.push_back(std::move(entry));
+}
+
+void Gateway::sendConfirm(uint16_t refId, const sockaddr_in& to) {
+    uint8_t confirm[3] = {static_cast<uint8_t>(UdpMessageType::CONFIRM), static_cast<uint8_t>(refId >> 8),
+                          static_cast<uint8_t>(refId & 0xFF)};
+    if (sendto(udpFd, confirm, sizeof(confirm), 0, reinterpret_cast<const sockaddr*>(&to), sizeof(to)) == -1) {
+        perror("sendto");
+        return;
+    }
+    statMessageSent(StatKind::CONFIRM, sizeof(confirm));
+    statAdd(threadCounters().confirmsSent);
+}
+
+// Ends the session with an ERR to the client; `upstream` also reports it to the server, for
+// problems on the client side or with what the server sent
+void Gateway::sendError(Session& session, const std::string& content, bool upstream) {
+    UdpMessage err = buildMsgUdpMessage(GATEWAY_NAME, content, session.nextMessageId++);
+    err.type = UdpMessageType::ERR;
+    sendReliable(session, err);
+    if (upstream && !session.closing && !session.displayName.empty()) {
+        sendUpstream(session, Message::createErrorMessage(session.displayName, content).getContent() + "\r\n");
+    }
+    session.closing = true;
+    finishIfDone(session);
+}
+
+// Retransmits unconfirmed messages; a client that stops confirming is gone, its session ends
+// with BYE upstream
+void Gateway::checkRetransmissions(TimePoint now) {
+    auto timeout = std::chrono::milliseconds(config.timeoutMs);
+    for (auto& entry : sessions) {
+        Session& session = *entry.second;
+        if (session.retired) continue;
+        bool lost = false;
+        for (Session::Unconfirmed& pending : session.unconfirmed) {
+            if (now - pending.sentAt < timeout) continue;
+            if (pending.retries >= config.retries) {
+                lost = true;
+                break;
+            }
+            sendto(udpFd, pending.bytes.data(), pending.bytes.size(), 0,
+                   reinterpret_cast<const sockaddr*>(&session.client), sizeof(session.client));
+            pending.sentAt = now;
+            pending.retries++;
+            counters.retransmissions.fetch_add(1, std::memory_order_relaxed);
+            statAdd(threadCounters().retransmissions);
+        }
+        if (!lost) continue;
+        if (!session.closing && !session.displayName.empty()) {
+            sendUpstream(session, Message::createByeMessage(session.displayName).getContent() + "\r\n");
+        }
+        retire(session);
+    }
+}
+
+void Gateway::closeUpstream(Session& session) {
+    if (session.fd == -1) return;
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, session.fd, nullptr);
+    close(session.fd);
+    session.fd = -1;
+    session.outbound.clear();
+}
+
+// A closing session ends once the server took its last line and the client confirmed ours
+void Gateway::finishIfDone(Session& session) {
+    if (session.closing && session.outbound.empty() && session.unconfirmed.empty()) retire(session);
+}
+
+// Closes the session now, its memory is released after the current batch of events
+void Gateway::retire(Session& session) {
+    if (session.retired) return;
+    session.retired = true;
+    closeUpstream(session);
+    retired.push_back(&session);
+}
+
+void Gateway::purgeRetired() {
+    for (Session* session : retired) {
+        sessions.erase(session->key);
+        counters.sessions.fetch_sub(1, std::memory_order_relaxed);
+    }
+    retired.clear();
+}
@@ -0,0 +1,114 @@
+#ifndef GATEWAY_H
+#define GATEWAY_H
+
+#include "MessageUdp.h"
+#include "Shutdown.h"
+#include <atomic>
+#include <bitset>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <netinet/in.h>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Settings of the UDP-to-TCP gateway (tools/ipk25gw)
+struct GatewayConfig {
+    uint16_t listenPort = 4567;  // UDP port the edge clients send AUTH to
+    std::string server;          // Upstream TCP server
+    int serverPort = 4567;
+    int timeoutMs = 250;         // Confirmation timeout towards the UDP clients
+    int retries = 3;
+};
+
+// Transcoding between the two IPK25-CHAT variants.
+// UDP message from a client to a TCP line including CRLF; AUTH, BYE, ERR and MSG carry the
+// display name, which is stored in `displayName`. False for messages without a TCP form
+// (CONFIRM, PING, REPLY) and for malformed payloads.
+bool transcodeUdpToTcp(const UdpMessage& msg, std::string& line, std::string& displayName);
+
+// TCP line from the server (without CRLF) to a UDP message with the given MessageID, a REPLY
+// refers to `refId`. False for lines that are not REPLY, MSG, ERR or BYE or are malformed.
+bool transcodeTcpToUdp(std::string_view line, uint16_t messageId, uint16_t refId, UdpMessage& msg);
+
+// MessageIDs recently received from one client: the newest one and a bitmap of the IDs before
+// it. IDs older than the window count as seen, a client only retransmits its last messages.
+// 40 bytes instead of a 64 Kib bitmap per session; handles the 16-bit wrap-around.
+class DedupWindow {
+public:
+    static constexpr int WINDOW = 256;
+
+    // Returns true if the ID was seen before, otherwise records it
+    bool seen(uint16_t id);
+
+private:
+    bool started = false;
+    uint16_t newest = 0;
+    std::bitset<WINDOW> bits;  // bits[k]: newest - k was received
+};
+
+// Totals of one gateway loop, readable from other threads
+struct GatewayTotals {
+    std::atomic<uint64_t> sessions{0};         // Sessions currently open
+    std::atomic<uint64_t> sessionsOpened{0};
+    std::atomic<uint64_t> upstream{0};         // UDP messages transcoded to TCP lines
+    std::atomic<uint64_t> downstream{0};       // TCP lines transcoded to UDP messages
+    std::atomic<uint64_t> retransmissions{0};
+    std::atomic<uint64_t> duplicates{0};
+};
+
+// One event loop of the gateway. Accepts UDP sessions on the listening port, confirms,
+// deduplicates and retransmits towards the clients and opens one upstream TCP connection per
+// session, transcoding in both directions. All sessions of the loop share its UDP socket and
+// one epoll instance, the loop never blocks on a single session. Several loops may listen on
+// the same port (SO_REUSEPORT), the kernel keeps each client on one of them.
+class Gateway {
+public:
+    Gateway(const GatewayConfig& config, const Wakeup& stop);
+    ~Gateway();
+
+    Gateway(const Gateway&) = delete;
+    Gateway& operator=(const Gateway&) = delete;
+
+    // Binds the UDP port and resolves the server, false after reporting the problem
+    bool open();
+
+    // Serves the sessions until `stop` is notified, then closes them with BYE upstream
+    void run();
+
+    const GatewayTotals& totals() const { return counters; }
+
+private:
+    using TimePoint = std::chrono::steady_clock::time_point;
+    struct Session;
+
+    void receiveDatagrams();
+    void handleDatagram(const uint8_t* data, size_t length, const sockaddr_in& from);
+    Session* openSession(const sockaddr_in& from);
+    void handleUpstream(Session& session, uint32_t events);
+    void handleServerLine(Session& session, std::string_view line);
+    void sendUpstream(Session& session, const std::string& line);
+    void flushUpstream(Session& session);
+    void updateInterest(Session& session);
+    void sendReliable(Session& session, const UdpMessage& msg);
+    void sendConfirm(uint16_t refId, const sockaddr_in& to);
+    void sendError(Session& session, const std::string& content, bool upstream);
+    void checkRetransmissions(TimePoint now);
+    void closeUpstream(Session& session);
+    void finishIfDone(Session& session);
+    void retire(Session& session);
+    void purgeRetired();
+
+    GatewayConfig config;
+    const Wakeup& stop;
+    int udpFd = -1;
+    int epollFd = -1;
+    sockaddr_in serverAddr{};
+    std::unordered_map<uint64_t, std::unique_ptr<Session>> sessions;  // By client address
+    std::vector<Session*> retired;  // Removed after the current batch of events
+    GatewayTotals counters;
+};
+
+#endif // GATEWAY_H
@@ -0,0 +1,150 @@
+#include "History.h"
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+StringInterner::StringInterner(size_t limit) : limit(limit) {
+    names.push_back("?");
+}
+
+uint32_t StringInterner::intern(std::string_view name) {
+    auto it = ids.find(name);
+    if (it != ids.end()) return it->second;
+    if (names.size() > limit) return 0;  // Table full, the name is not kept
+
+    std::string_view stored = store(name);
+    uint32_t id = static_cast<uint32_t>(names.size());
+    names.push_back(stored);
+    ids.emplace(stored, id);
+    return id;
+}
+
+// Copies the name into the current chunk, starting a new one when it does not fit
+std::string_view StringInterner::store(std::string_view name) {
+    if (chunkUsed + name.size() > CHUNK_SIZE) {
+        chunks.push_back(std::make_unique<char[]>(std::max(CHUNK_SIZE, name.size())));
+        chunkUsed = 0;
+    }
+    char* target = chunks.back().get() + chunkUsed;
+    std::memcpy(target, name.data(), name.size());
+    chunkUsed += name.size();
+    return std::string_view(target, name.size());
+}
+
+ChannelHistory::ChannelHistory(size_t capacity, size_t arenaBytes) : entries(capacity), arena(arenaBytes) {}
+
+void ChannelHistory::append(uint32_t sender, std::string_view content, std::chrono::steady_clock::time_point receivedAt) {
+    if (entries.empty() || arena.empty()) return;
+    size_t length = std::min(content.size(), arena.size());
+
+    if (count == 0) {
+        writeOffset = 0;
+    } else if (writeOffset + length > arena.size()) {
+        // Wrap around. Entries in the skipped tail are the oldest ones, drop them first so the
+        // remaining entries keep their age order along the arena.
+        while (count > 0 && oldest().offset >= writeOffset) --count;
+        writeOffset = 0;
+    }
+    size_t end = writeOffset + length;
+    // The oldest entries lie right ahead of the write position
+    while (count > 0 && (count == entries.size() || (oldest().offset < end && oldest().offset >= writeOffset))) {
+        --count;
+    }
+
+    std::memcpy(arena.data() + writeOffset, content.data(), length);
+    entries[head] = Entry{sender, static_cast<uint32_t>(writeOffset), static_cast<uint32_t>(length), receivedAt};
+    head = (head + 1) % entries.size();
+    ++count;
+    writeOffset = end;
+}
+
+void MessageHistory::configure(const HistoryLimits& newLimits) {
+    std::lock_guard<std::mutex> lock(mutex);
+    limits = newLimits;
+    names = StringInterner(limits.names);
+    channels.clear();
+}
+
+void MessageHistory::setChannel(const std::string& newChannel) {
+    std::lock_guard<std::mutex> lock(mutex);
+    channel = newChannel;
+}
+
+// Returns the history of the current channel, creating it (and dropping the least recently
+// used channel when over the limit) on first use. The mutex must be held.
+ChannelHistory& MessageHistory::currentChannel() {
+    Channel& entry = channels[channel];
+    entry.lastUsed = ++useCounter;
+    if (!entry.messages) {
+        entry.messages = std::make_unique<ChannelHistory>(limits.messagesPerChannel, limits.bytesPerChannel);
+        if (channels.size() > std::max<size_t>(limits.channels, 1)) {
+            auto victim = std::min_element(channels.begin(), channels.end(), [](const auto& a, const auto& b) {
+                return a.second.lastUsed < b.second.lastUsed;
+            });
+            channels.erase(victim);
+        }
+    }
+    return *channels[channel].messages;
+}
+
+void MessageHistory::record(std::string_view sender, std::string_view content,
+                            std::chrono::steady_clock::time_point receivedAt) {
+    if (!enabled()) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    currentChannel().append(names.intern(sender), content, receivedAt);
+}
+
+// Formats one entry as "[index] name: content", index 1 is the newest message
+std::string MessageHistory::formatEntry(const ChannelHistory& messages, size_t index) const {
+    const ChannelHistory::Entry& entry = messages.recent(index);
+    std::string text = "[" + std::to_string(index + 1) + "] ";
+    text += names.name(entry.sender);
+    text += ": ";
+    text += messages.content(entry);
+    return text;
+}
+
+bool MessageHistory::handleCommand(const std::string& line, const ChatEvents& events) {
+    bool isHistory = line == "/history" || line.rfind("/history ", 0) == 0;
+    bool isSearch = line == "/search" || line.rfind("/search ", 0) == 0;
+    if (!isHistory && !isSearch) return false;
+
+    if (!enabled()) {
+        events.notice("ERROR: history is disabled (start with --history N)");
+        return true;
+    }
+
+    std::string needle = isSearch && line.size() > 8 ? line.substr(8) : "";
+    if (isSearch && needle.empty()) {
+        events.notice("ERROR: Invalid /search command. Correct format: /search {Text}");
+        return true;
+    }
+
+    // Reported after the lock is released, the receiver keeps recording meanwhile
+    std::vector<std::string> found;
+    std::string notFound;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ChannelHistory& messages = currentChannel();
+        if (isHistory) {
+            // Oldest of the requested messages first, like they were printed when received
+            size_t wanted = 10;
+            std::istringstream iss(line.substr(8));
+            iss >> wanted;
+            for (size_t i = std::min(wanted, messages.size()); i-- > 0;) {
+                found.push_back(formatEntry(messages, i));
+            }
+        } else {
+            for (size_t i = messages.size(); i-- > 0;) {
+                const ChannelHistory::Entry& entry = messages.recent(i);
+                if (messages.content(entry).find(needle) != std::string_view::npos) {
+                    found.push_back(formatEntry(messages, i));
+                }
+            }
+            if (found.empty()) notFound = "No message in " + channel + " contains \"" + needle + "\"";
+        }
+    }
+    for (const std::string& entry : found) events.info(entry);
+    if (!notFound.empty()) events.info(notFound);
+    return true;
+}
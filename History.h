@@ -0,0 +1,115 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "ChatEvents.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Hard memory limits of the message history (--history, --history-bytes, --history-channels)
+struct HistoryLimits {
+    size_t messagesPerChannel = 0;         // 0 disables the history
+    size_t bytesPerChannel = 1024 * 1024;  // Content arena of one channel
+    size_t channels = 16;                  // The least recently used channel is dropped beyond this
+    size_t names = 4096;                   // Distinct display names, later ones are stored as "?"
+};
+
+// Display names stored once in an append-only arena. Views returned by name() stay valid for
+// the lifetime of the interner, so a history entry only keeps a 32-bit id.
+class StringInterner {
+public:
+    explicit StringInterner(size_t limit);
+
+    // Returns the id of the name, adding it if there is still room (id 0 is "?")
+    uint32_t intern(std::string_view name);
+
+    std::string_view name(uint32_t id) const { return names[id]; }
+
+private:
+    static constexpr size_t CHUNK_SIZE = 4096;
+
+    std::string_view store(std::string_view name);
+
+    size_t limit;
+    std::vector<std::unique_ptr<char[]>> chunks;
+    size_t chunkUsed = CHUNK_SIZE;
+    std::vector<std::string_view> names;
+    std::unordered_map<std::string_view, uint32_t> ids;
+};
+
+// Fixed-capacity ring of the newest messages of one channel. Contents are copied into a
+// circular byte arena; writing a new message evicts the oldest entries whose bytes it
+// overwrites, so both the entry count and the memory are bounded.
+class ChannelHistory {
+public:
+    struct Entry {
+        uint32_t sender;
+        uint32_t offset;  // Content position in the arena
+        uint32_t length;
+        std::chrono::steady_clock::time_point receivedAt;
+    };
+
+    ChannelHistory(size_t capacity, size_t arenaBytes);
+
+    // Content longer than the whole arena is truncated
+    void append(uint32_t sender, std::string_view content, std::chrono::steady_clock::time_point receivedAt);
+
+    size_t size() const { return count; }
+
+    // O(1) access by recency, 0 is the newest message
+    const Entry& recent(size_t index) const { return entries[(head + entries.size() - 1 - index) % entries.size()]; }
+
+    std::string_view content(const Entry& entry) const { return std::string_view(arena.data() + entry.offset, entry.length); }
+
+private:
+    const Entry& oldest() const { return entries[(head + entries.size() - count) % entries.size()]; }
+
+    std::vector<Entry> entries;
+    size_t head = 0;   // Next slot to write
+    size_t count = 0;
+    std::vector<char> arena;
+    size_t writeOffset = 0;
+};
+
+// Received chat messages per channel, fed by the receiver and queried from the input thread
+// (/history, /search)
+class MessageHistory {
+public:
+    MessageHistory() : names(0) {}
+
+    void configure(const HistoryLimits& limits);
+    bool enabled() const { return limits.messagesPerChannel > 0; }
+
+    // Channel that receives the following messages (the last joined one)
+    void setChannel(const std::string& channel);
+
+    void record(std::string_view sender, std::string_view content, std::chrono::steady_clock::time_point receivedAt);
+
+    // Handles "/history [N]" and "/search TEXT", one info event per message found, returns
+    // false for any other line
+    bool handleCommand(const std::string& line, const ChatEvents& events);
+
+private:
+    struct Channel {
+        std::unique_ptr<ChannelHistory> messages;
+        uint64_t lastUsed = 0;
+    };
+
+    ChannelHistory& currentChannel();
+    std::string formatEntry(const ChannelHistory& messages, size_t index) const;
+
+    std::mutex mutex;
+    HistoryLimits limits;
+    StringInterner names;
+    std::unordered_map<std::string, Channel> channels;
+    std::string channel = "default";
+    uint64_t useCounter = 0;
+};
+
+#endif // HISTORY_H
@@ -1,10 +1,12 @@
 #include "InputHandler.h"
+#include "Trace.h"
 #include <sstream>
 #include <optional>
 
 // Parses the /auth command from user input.
 // Expected format: /auth <username> <secret> <displayName>
 std::optional<AuthCommand> InputHandler::parseAuthCommand(const std::string& input) {
+    TRACE_SCOPE("parse");
     std::istringstream iss(input);
     std::string cmd, username, secret, displayName;
 
@@ -23,6 +25,7 @@ std::optional<AuthCommand> InputHandler::parseAuthCommand(const std::string& inp
 // Parses the /join command from user input.
 // Expected format: /join <channel>
 std::optional<std::string> InputHandler::parseJoinCommand(const std::string& line) {
+    TRACE_SCOPE("parse");
     std::istringstream iss(line);
     std::string cmd, channel;
 
@@ -41,3 +44,18 @@ std::optional<std::string> InputHandler::parseJoinCommand(const std::string& lin
 
     return std::nullopt; // Return no result if command is invalid or empty
 }
+
+// Parses the /send command from user input.
+// Expected format: /send <path>, the path may contain spaces
+std::optional<std::string> InputHandler::parseSendCommand(const std::string& line) {
+    TRACE_SCOPE("parse");
+    if (line.rfind("/send", 0) != 0 || (line.size() > 5 && line[5] != ' ')) {
+        return std::nullopt;
+    }
+    size_t start = line.find_first_not_of(" \t", 5);
+    if (start == std::string::npos) {
+        return std::nullopt;
+    }
+    size_t end = line.find_last_not_of(" \t");
+    return line.substr(start, end - start + 1);
+}
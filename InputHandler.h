@@ -24,4 +24,8 @@ public:
     // Parses the "/auth" command from the input string and returns an AuthCommand object if valid
     // If the input format is invalid, returns an empty optional
     static std::optional<AuthCommand> parseAuthCommand(const std::string& input);
+
+    // Parses the "/send" command and returns the file path (the rest of the line, trimmed)
+    // If no path is given, returns an empty optional
+    static std::optional<std::string> parseSendCommand(const std::string& input);
 };
@@ -0,0 +1,159 @@
+#include "JsonLineWriter.h"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <unistd.h>
+
+namespace {
+
+// Escape sequence of every byte, empty for bytes copied as they are. Control characters and
+// DEL are escaped, bytes from 0x80 up pass through (UTF-8).
+struct EscapeTable {
+    std::array<char[7], 256> sequence{};
+
+    constexpr EscapeTable() {
+        const char* hex = "0123456789abcdef";
+        for (int c = 0; c < 0x20; ++c) {
+            char* s = sequence[c];
+            s[0] = '\\', s[1] = 'u', s[2] = '0', s[3] = '0', s[4] = hex[c >> 4], s[5] = hex[c & 0xF];
+        }
+        char* del = sequence[0x7F];
+        del[0] = '\\', del[1] = 'u', del[2] = '0', del[3] = '0', del[4] = '7', del[5] = 'f';
+        setShort('"', '"');
+        setShort('\\', '\\');
+        setShort('\n', 'n');
+        setShort('\r', 'r');
+        setShort('\t', 't');
+        setShort('\b', 'b');
+        setShort('\f', 'f');
+    }
+
+    constexpr void setShort(char c, char letter) {
+        char* s = sequence[static_cast<unsigned char>(c)];
+        s[0] = '\\', s[1] = letter, s[2] = '\0';
+    }
+};
+
+constexpr EscapeTable ESCAPES;
+
+}  // namespace
+
+const char* JsonLineWriter::eventName(ChatRecord::Kind kind) {
+    switch (kind) {
+        case ChatRecord::Kind::MSG: return "msg";
+        case ChatRecord::Kind::REPLY: return "reply";
+        case ChatRecord::Kind::ERR: return "err";
+        case ChatRecord::Kind::BYE: return "bye";
+        case ChatRecord::Kind::NOTICE: return "notice";
+        case ChatRecord::Kind::INFO: return "info";
+        case ChatRecord::Kind::CONFIRMED: return "confirmed";
+        case ChatRecord::Kind::RETRANSMIT: return "retransmit";
+    }
+    return "unknown";
+}
+
+void JsonLineWriter::write(const ChatRecord& record) {
+    int64_t ts = std::chrono::duration_cast<std::chrono::nanoseconds>(record.at.time_since_epoch()).count();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    append("{\"ts\":");
+    appendNumber(ts);
+    append(",\"event\":\"");
+    append(eventName(record.kind));
+    put('"');
+    if (record.messageId >= 0) {
+        appendField("id");
+        appendNumber(record.messageId);
+    }
+    switch (record.kind) {
+        case ChatRecord::Kind::MSG:
+        case ChatRecord::Kind::ERR:
+            appendField("from");
+            appendString(record.from);
+            appendField("content");
+            appendString(record.content);
+            break;
+        case ChatRecord::Kind::REPLY:
+            if (record.refId >= 0) {
+                appendField("ref");
+                appendNumber(record.refId);
+            }
+            appendField("ok");
+            append(record.success ? "true" : "false");
+            appendField("content");
+            appendString(record.content);
+            break;
+        case ChatRecord::Kind::NOTICE:
+        case ChatRecord::Kind::INFO:
+            appendField("text");
+            appendString(record.content);
+            break;
+        case ChatRecord::Kind::CONFIRMED:
+            appendField("rtt_us");
+            appendNumber(std::chrono::duration_cast<std::chrono::microseconds>(record.rtt).count());
+            break;
+        case ChatRecord::Kind::RETRANSMIT:
+            appendField("attempt");
+            appendNumber(record.attempt);
+            break;
+        case ChatRecord::Kind::BYE:
+            break;
+    }
+    append("}\n");
+    flush();
+}
+
+void JsonLineWriter::append(std::string_view text) {
+    while (!text.empty()) {
+        if (used == BUFFER_SIZE) flush();
+        size_t count = std::min(text.size(), BUFFER_SIZE - used);
+        std::memcpy(buffer + used, text.data(), count);
+        used += count;
+        text.remove_prefix(count);
+    }
+}
+
+// Copies runs of plain bytes in one piece and replaces the rest from the escape table
+void JsonLineWriter::appendString(std::string_view text) {
+    put('"');
+    size_t runStart = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        const char* escape = ESCAPES.sequence[static_cast<unsigned char>(text[i])];
+        if (escape[0] == '\0') continue;
+        append(text.substr(runStart, i - runStart));
+        append(escape);
+        runStart = i + 1;
+    }
+    append(text.substr(runStart));
+    put('"');
+}
+
+void JsonLineWriter::appendNumber(int64_t value) {
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    append(std::string_view(digits, static_cast<size_t>(result.ptr - digits)));
+}
+
+void JsonLineWriter::appendField(std::string_view name) {
+    put(',');
+    put('"');
+    append(name);
+    put('"');
+    put(':');
+}
+
+// Hands the buffer to the kernel; a reader that went away only loses the output
+void JsonLineWriter::flush() {
+    size_t offset = 0;
+    while (offset < used) {
+        ssize_t written = ::write(fd, buffer + offset, used - offset);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        offset += static_cast<size_t>(written);
+    }
+    used = 0;
+}
@@ -0,0 +1,47 @@
+#ifndef JSONLINEWRITER_H
+#define JSONLINEWRITER_H
+
+#include "ChatEvents.h"
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+
+// Serializes ChatRecords as JSON lines (--output jsonl), one object per event:
+//   {"ts":81234567890123,"event":"msg","id":7,"from":"bob","content":"hi"}
+// "ts" is CLOCK_MONOTONIC in nanoseconds, "id" is left out when there is no MessageID (TCP,
+// local notices). Hand-written: the line is formatted into a fixed buffer with a table-driven
+// escaper and integer conversion by std::to_chars, so writing a record never allocates, and is
+// handed to the kernel with one write(2). Lines from several threads never interleave.
+class JsonLineWriter {
+public:
+    explicit JsonLineWriter(int fd) : fd(fd) {}
+
+    JsonLineWriter(const JsonLineWriter&) = delete;
+    JsonLineWriter& operator=(const JsonLineWriter&) = delete;
+
+    // Writes one line, thread-safe
+    void write(const ChatRecord& record);
+
+    static const char* eventName(ChatRecord::Kind kind);
+
+private:
+    static constexpr size_t BUFFER_SIZE = 64 * 1024;
+
+    void put(char c) {
+        if (used == BUFFER_SIZE) flush();
+        buffer[used++] = c;
+    }
+    void append(std::string_view text);
+    void appendString(std::string_view text);  // Quoted and escaped
+    void appendNumber(int64_t value);
+    void appendField(std::string_view name);   // ,"name":
+    void flush();
+
+    int fd;
+    std::mutex mutex;
+    size_t used = 0;
+    char buffer[BUFFER_SIZE];  // A record longer than this is written in several pieces
+};
+
+#endif // JSONLINEWRITER_H
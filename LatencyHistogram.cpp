@@ -0,0 +1,133 @@
+#include "LatencyHistogram.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+// Constructor that only stores the histogram name, all counters start at zero
+LatencyHistogram::LatencyHistogram(const std::string& name) : name(name) {}
+
+// Maps a value to its bucket.
+// Values below SUB_BUCKET_COUNT get their own bucket, larger values are grouped by their
+// highest set bit and the next SUB_BUCKET_BITS-1 bits select the linear sub-bucket.
+size_t LatencyHistogram::bucketIndex(uint64_t value) {
+    if (value < SUB_BUCKET_COUNT) {
+        return static_cast<size_t>(value);
+    }
+    int highestBit = 63 - __builtin_clzll(value);
+    int shift = highestBit - SUB_BUCKET_BITS + 1;
+    return static_cast<size_t>(shift) * SUB_BUCKET_HALF + static_cast<size_t>(value >> shift);
+}
+
+// Returns the largest value that still falls into the given bucket
+uint64_t LatencyHistogram::bucketUpperBound(size_t index) {
+    if (index < SUB_BUCKET_COUNT) {
+        return index;
+    }
+    uint64_t shift = index / SUB_BUCKET_HALF - 1;
+    uint64_t subBucket = index - shift * SUB_BUCKET_HALF;
+    return ((subBucket + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(std::chrono::nanoseconds value) {
+    uint64_t ns = value.count() > 0 ? static_cast<uint64_t>(value.count()) : 0;
+
+    buckets[bucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(ns, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+
+    // Lock-free maximum update
+    uint64_t currentMax = maxValue.load(std::memory_order_relaxed);
+    while (ns > currentMax &&
+           !maxValue.compare_exchange_weak(currentMax, ns, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::recordSince(std::chrono::steady_clock::time_point start) {
+    record(std::chrono::steady_clock::now() - start);
+}
+
+uint64_t LatencyHistogram::count() const {
+    return total.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::percentile(double fraction) const {
+    // Take a snapshot of the buckets first, writers may still be running
+    uint64_t samples = 0;
+    std::array<uint64_t, BUCKET_COUNT> snapshot;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        snapshot[i] = buckets[i].load(std::memory_order_relaxed);
+        samples += snapshot[i];
+    }
+    if (samples == 0) return 0;
+
+    uint64_t target = static_cast<uint64_t>(fraction * static_cast<double>(samples) + 0.5);
+    target = std::clamp<uint64_t>(target, 1, samples);
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        seen += snapshot[i];
+        if (seen >= target) {
+            return std::min(bucketUpperBound(i), maxValue.load(std::memory_order_relaxed));
+        }
+    }
+    return maxValue.load(std::memory_order_relaxed);
+}
+
+// Formats a nanosecond value as microseconds or milliseconds for the report
+static std::string formatNs(uint64_t ns) {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(ns < 10000000 ? 1 : 0);
+    if (ns < 1000000) {
+        oss << ns / 1000.0 << "us";
+    } else {
+        oss << ns / 1000000.0 << "ms";
+    }
+    return oss.str();
+}
+
+void LatencyHistogram::print(std::ostream& out) const {
+    uint64_t samples = count();
+    out << std::left << std::setw(22) << name << std::right << " count=" << samples;
+    if (samples == 0) {
+        out << std::endl;
+        return;
+    }
+    out << " mean=" << formatNs(sum.load(std::memory_order_relaxed) / samples)
+        << " p50=" << formatNs(percentile(0.50))
+        << " p99=" << formatNs(percentile(0.99))
+        << " p999=" << formatNs(percentile(0.999))
+        << " max=" << formatNs(maxValue.load(std::memory_order_relaxed))
+        << std::endl;
+}
+
+LatencyMetrics::LatencyMetrics()
+    : confirmRtt{LatencyHistogram("confirm_rtt[retry=0]"),
+                 LatencyHistogram("confirm_rtt[retry=1]"),
+                 LatencyHistogram("confirm_rtt[retry=2]"),
+                 LatencyHistogram("confirm_rtt[retry>=3]")},
+      replyLatency("reply_latency"),
+      deliveryLatency("delivery_latency"),
+      controlQueueLatency("send_queue[control]"),
+      bulkQueueLatency("send_queue[bulk]") {}
+
+// Intentionally never destroyed, background threads and atexit handlers may still use it
+LatencyMetrics& latencyMetrics() {
+    static LatencyMetrics* metrics = new LatencyMetrics();
+    return *metrics;
+}
+
+void dumpLatencyMetrics(std::ostream& out) {
+    LatencyMetrics& metrics = latencyMetrics();
+    out << "--- Latency histograms ---" << std::endl;
+    for (const auto& histogram : metrics.confirmRtt) {
+        histogram.print(out);
+    }
+    metrics.replyLatency.print(out);
+    metrics.deliveryLatency.print(out);
+    // Only printed when the send scheduler was used
+    if (metrics.controlQueueLatency.count() > 0 || metrics.bulkQueueLatency.count() > 0) {
+        metrics.controlQueueLatency.print(out);
+        metrics.bulkQueueLatency.print(out);
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// HDR-style latency histogram with logarithmic buckets split into linear sub-buckets.
+// Values are stored in nanoseconds with ~3% relative precision.
+// record() only does relaxed atomic increments, so it is safe to call from any thread
+// on the hot path without taking a lock.
+class LatencyHistogram {
+public:
+    explicit LatencyHistogram(const std::string& name);
+
+    // Records one sample (negative durations are clamped to zero)
+    void record(std::chrono::nanoseconds value);
+
+    // Records the time elapsed since the given start point
+    void recordSince(std::chrono::steady_clock::time_point start);
+
+    // Returns the number of recorded samples
+    uint64_t count() const;
+
+    // Returns the value (in ns) below which the given fraction of samples falls (0.0 - 1.0)
+    uint64_t percentile(double fraction) const;
+
+    // Prints a one-line summary with count, mean, p50, p99, p999 and max
+    void print(std::ostream& out) const;
+
+    const std::string& getName() const { return name; }
+
+private:
+    static constexpr int SUB_BUCKET_BITS = 5;
+    static constexpr uint64_t SUB_BUCKET_COUNT = 1u << SUB_BUCKET_BITS;
+    static constexpr uint64_t SUB_BUCKET_HALF = SUB_BUCKET_COUNT / 2;
+    static constexpr size_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS) * SUB_BUCKET_HALF + SUB_BUCKET_COUNT;
+
+    static size_t bucketIndex(uint64_t value);
+    static uint64_t bucketUpperBound(size_t index);
+
+    std::string name;
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets{};
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> maxValue{0};
+};
+
+// Number of separately tracked retransmission attempts for CONFIRM RTT (last one is "N or more")
+constexpr int CONFIRM_RTT_ATTEMPTS = 4;
+
+// Latency histograms collected by both clients during the session.
+struct LatencyMetrics {
+    LatencyMetrics();
+
+    // UDP send-to-CONFIRM time, indexed by how many retransmissions the message needed
+    LatencyHistogram confirmRtt[CONFIRM_RTT_ATTEMPTS];
+    // AUTH/JOIN sent until the matching REPLY arrived (TCP and UDP)
+    LatencyHistogram replyLatency;
+    // Message received from the socket until it was written to stdout
+    LatencyHistogram deliveryLatency;
+    // Time a send waited in the send scheduler, per traffic class
+    LatencyHistogram controlQueueLatency;
+    LatencyHistogram bulkQueueLatency;
+};
+
+// Returns the process-wide latency metrics
+LatencyMetrics& latencyMetrics();
+
+// Prints all latency histograms to the given stream
+void dumpLatencyMetrics(std::ostream& out);
+
+#endif // LATENCYHISTOGRAM_H
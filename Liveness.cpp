@@ -0,0 +1,87 @@
+#include "Liveness.h"
+#include <algorithm>
+#include <cstdio>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+static int64_t nanosOf(LivenessMonitor::TimePoint time) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+void LivenessMonitor::configure(const LivenessPolicy& livenessPolicy, std::chrono::milliseconds retry) {
+    policy = livenessPolicy;
+    retryInterval = retry;
+}
+
+void LivenessMonitor::heard(TimePoint now) {
+    lastHeard.store(nanosOf(now), std::memory_order_relaxed);
+}
+
+bool LivenessMonitor::probeDue(TimePoint now) const {
+    int64_t heardAt = lastHeard.load(std::memory_order_relaxed);
+    if (!policy.enabled || heardAt == 0) return false;
+    int64_t nowNs = nanosOf(now);
+    if (nowNs - heardAt < std::chrono::nanoseconds(policy.idle).count()) return false;
+    int64_t probeAt = lastProbe.load(std::memory_order_relaxed);
+    // One probe per retry interval while the silence lasts
+    return probeAt <= heardAt || nowNs - probeAt >= std::chrono::nanoseconds(retryInterval).count();
+}
+
+void LivenessMonitor::probed(TimePoint now, uint16_t id) {
+    probeId.store(id, std::memory_order_relaxed);
+    int64_t nowNs = nanosOf(now);
+    lastProbe.store(nowNs, std::memory_order_relaxed);
+    // Only the first probe of a silent period is timed, a CONFIRM cannot tell retries apart
+    int64_t expected = 0;
+    probeSentAt.compare_exchange_strong(expected, nowNs, std::memory_order_relaxed);
+}
+
+void LivenessMonitor::confirmed(uint16_t refId, TimePoint now) {
+    int64_t sentAt = probeSentAt.load(std::memory_order_relaxed);
+    if (sentAt == 0 || refId != probeId.load(std::memory_order_relaxed)) return;
+    probeSentAt.store(0, std::memory_order_relaxed);
+    rttSample(std::chrono::nanoseconds(nanosOf(now) - sentAt));
+}
+
+void LivenessMonitor::rttSample(std::chrono::nanoseconds rtt) {
+    int64_t sample = std::max<int64_t>(1, std::chrono::duration_cast<std::chrono::microseconds>(rtt).count());
+    int64_t smoothed = srttUs.load(std::memory_order_relaxed);
+    // SRTT = 7/8 SRTT + 1/8 sample, the first sample is taken as is
+    srttUs.store(smoothed == 0 ? sample : smoothed + (sample - smoothed) / 8, std::memory_order_relaxed);
+}
+
+bool LivenessMonitor::dead(TimePoint now) const {
+    int64_t heardAt = lastHeard.load(std::memory_order_relaxed);
+    if (!policy.enabled || heardAt == 0) return false;
+    return nanosOf(now) - heardAt >= std::chrono::nanoseconds(policy.deadAfter).count();
+}
+
+bool applyTcpLiveness(int fd, const LivenessPolicy& policy) {
+    if (!policy.enabled) return true;
+    // Keepalive counts in whole seconds: probe after `idle`, then three probes spread over the
+    // rest of deadAfter
+    int idle = std::max<int>(1, std::chrono::duration_cast<std::chrono::seconds>(policy.idle).count());
+    auto rest = std::max(policy.deadAfter - policy.idle, std::chrono::milliseconds(3000));
+    int interval = std::max<int>(1, std::chrono::duration_cast<std::chrono::seconds>(rest).count() / 3);
+    int count = 3;
+    int on = 1;
+    // Unacknowledged data fails the connection after deadAfter
+    unsigned int userTimeout = static_cast<unsigned int>(policy.deadAfter.count());
+    if (setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on)) == -1 ||
+        setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle)) == -1 ||
+        setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval)) == -1 ||
+        setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count)) == -1 ||
+        setsockopt(fd, IPPROTO_TCP, TCP_USER_TIMEOUT, &userTimeout, sizeof(userTimeout)) == -1) {
+        perror("ERROR: setsockopt (keepalive)");
+        return false;
+    }
+    return true;
+}
+
+std::chrono::microseconds tcpKernelRtt(int fd) {
+    tcp_info info{};
+    socklen_t length = sizeof(info);
+    if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &length) == -1) return std::chrono::microseconds(0);
+    return std::chrono::microseconds(info.tcpi_rtt);
+}
@@ -0,0 +1,70 @@
+#ifndef LIVENESS_H
+#define LIVENESS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Settings of the opt-in liveness probing (--keepalive, --dead-after)
+struct LivenessPolicy {
+    bool enabled = false;
+    std::chrono::milliseconds idle{5000};        // Silence from the server before probing
+    std::chrono::milliseconds deadAfter{15000};  // Silence after which the server is declared dead
+};
+
+// Tracks when the server was last heard from and the smoothed round-trip time. Probing starts
+// with the first message from the server; after `idle` of silence a probe is due every
+// `retryInterval`, after `deadAfter` of silence the server counts as dead, so a crash is
+// detected within deadAfter plus one check period whatever the user does.
+// Updated from the receiving thread and read from the timer thread, hence the atomics.
+class LivenessMonitor {
+public:
+    using TimePoint = std::chrono::steady_clock::time_point;
+
+    void configure(const LivenessPolicy& policy, std::chrono::milliseconds retryInterval);
+    bool enabled() const { return policy.enabled; }
+    std::chrono::milliseconds deadAfter() const { return policy.deadAfter; }
+
+    // Any message from the server proves it is alive
+    void heard(TimePoint now);
+
+    // True when a probe should be sent now, the caller then calls probed()
+    bool probeDue(TimePoint now) const;
+    void probed(TimePoint now, uint16_t probeId);
+
+    // Takes an RTT sample if `refId` confirms the outstanding probe
+    void confirmed(uint16_t refId, TimePoint now);
+
+    // Round-trip sample from any request/response pair (not retransmitted ones, Karn's rule)
+    void rttSample(std::chrono::nanoseconds rtt);
+
+    // True once the server was silent for deadAfter. restart() begins a new period.
+    bool dead(TimePoint now) const;
+    void restart() {
+        lastHeard.store(0, std::memory_order_relaxed);
+        probeSentAt.store(0, std::memory_order_relaxed);
+    }
+
+    // Smoothed RTT (RFC 6298 weights), 0 until the first sample
+    std::chrono::microseconds srtt() const { return std::chrono::microseconds(srttUs.load(std::memory_order_relaxed)); }
+
+private:
+    LivenessPolicy policy;
+    std::chrono::milliseconds retryInterval{250};
+    std::atomic<int64_t> lastHeard{0};   // steady_clock nanoseconds, 0 = not started
+    std::atomic<int64_t> lastProbe{0};
+    std::atomic<int64_t> probeSentAt{0};  // 0 = no probe outstanding
+    std::atomic<uint16_t> probeId{0};
+    std::atomic<int64_t> srttUs{0};
+};
+
+// Enables TCP keepalive and TCP_USER_TIMEOUT on a connected socket so the kernel fails reads
+// with ETIMEDOUT once the server stayed silent (keepalive) or did not acknowledge data for
+// deadAfter. IPK25-CHAT over TCP has no protocol-level probe. Returns false if an option
+// could not be set.
+bool applyTcpLiveness(int fd, const LivenessPolicy& policy);
+
+// Round-trip time the kernel measured on a TCP socket, 0 if unknown
+std::chrono::microseconds tcpKernelRtt(int fd);
+
+#endif // LIVENESS_H
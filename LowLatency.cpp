@@ -0,0 +1,44 @@
+#include "LowLatency.h"
+#include "WireBuffer.h"
+#include <alloca.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <malloc.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+void prepareLowLatencyMemory() {
+    // Freed memory stays in the (single) heap arena instead of going back to the kernel
+    mallopt(M_MMAP_MAX, 0);
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_ARENA_MAX, 1);
+
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        std::cerr << "WARNING: mlockall failed (" << strerror(errno)
+                  << "), memory may be paged out; check ulimit -l" << std::endl;
+    }
+
+    // Fault in a heap reserve and give it back to the arena, later allocations reuse it
+    char* reserve = static_cast<char*>(std::malloc(LOW_LATENCY_HEAP_RESERVE));
+    if (reserve != nullptr) {
+        long pageSize = sysconf(_SC_PAGESIZE);
+        for (size_t offset = 0; offset < LOW_LATENCY_HEAP_RESERVE; offset += static_cast<size_t>(pageSize)) {
+            reserve[offset] = 0;
+        }
+        std::free(reserve);
+    }
+
+    // Encoded messages and received datagrams come from the pool
+    WireBuffer::prewarm(512, 2048);
+}
+
+void prefaultStack(size_t bytes) {
+    // volatile so the compiler cannot drop the writes
+    volatile char* area = static_cast<volatile char*>(alloca(bytes));
+    long pageSize = sysconf(_SC_PAGESIZE);
+    for (size_t offset = 0; offset < bytes; offset += static_cast<size_t>(pageSize)) {
+        area[offset] = 0;
+    }
+}
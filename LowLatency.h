@@ -0,0 +1,31 @@
+#ifndef LOWLATENCY_H
+#define LOWLATENCY_H
+
+#include <cstddef>
+
+// Heap reserve that is faulted in and locked before the session starts
+constexpr size_t LOW_LATENCY_HEAP_RESERVE = 32 * 1024 * 1024;
+
+// Prepares the process for --low-latency, must run before the client threads start:
+// freed heap memory is kept by the process (no trimming, no per-allocation mmap, one arena),
+// a heap reserve and the WireBuffer pool are faulted in and all current and future pages are
+// locked with mlockall(). Allocations during the session then reuse resident, locked memory
+// and never page-fault or enter the kernel; the clients also skip their per-message stderr
+// diagnostics in this mode. Output of received messages and socket I/O still make system
+// calls. Failures (e.g. RLIMIT_MEMLOCK) are reported as warnings, the mode then still spins but
+// memory may be paged.
+void prepareLowLatencyMemory();
+
+// Touches `bytes` of the calling thread's stack, so the receive path never faults on it
+void prefaultStack(size_t bytes = 256 * 1024);
+
+// Spin-wait hint for busy-polling loops
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+#endif // LOWLATENCY_H
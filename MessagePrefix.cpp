@@ -0,0 +1,41 @@
+#include "MessagePrefix.h"
+#include "MessageUdp.h"
+#include "Trace.h"
+
+void TcpMsgPrefix::rebuild(const std::string& displayName) {
+    prefix = "MSG FROM " + displayName + " IS ";
+}
+
+WireBuffer TcpMsgPrefix::encode(std::string_view content) const {
+    TRACE_SCOPE("encode");
+    WireBuffer buffer = WireBuffer::acquire();
+    std::vector<uint8_t>& bytes = buffer.bytes();
+    bytes.reserve(prefix.size() + content.size() + 2);
+    bytes.insert(bytes.end(), prefix.begin(), prefix.end());
+    bytes.insert(bytes.end(), content.begin(), content.end());
+    bytes.push_back('\r');
+    bytes.push_back('\n');
+    return buffer;
+}
+
+void UdpMsgPrefix::rebuild(const std::string& displayName) {
+    prefix.clear();
+    prefix.push_back(static_cast<uint8_t>(UdpMessageType::MSG));
+    prefix.push_back(0);  // MessageID, filled in by encode()
+    prefix.push_back(0);
+    prefix.insert(prefix.end(), displayName.begin(), displayName.end());
+    prefix.push_back(0);
+}
+
+WireBuffer UdpMsgPrefix::encode(uint16_t messageId, const std::string& content) const {
+    TRACE_SCOPE("encode");
+    WireBuffer buffer = WireBuffer::acquire();
+    std::vector<uint8_t>& bytes = buffer.bytes();
+    bytes.reserve(prefix.size() + content.size() + 1);
+    bytes.insert(bytes.end(), prefix.begin(), prefix.end());
+    bytes[1] = static_cast<uint8_t>(messageId >> 8);  // Network byte order
+    bytes[2] = static_cast<uint8_t>(messageId & 0xFF);
+    bytes.insert(bytes.end(), content.begin(), content.end());
+    bytes.push_back(0);
+    return buffer;
+}
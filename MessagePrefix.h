@@ -0,0 +1,40 @@
+#ifndef MESSAGEPREFIX_H
+#define MESSAGEPREFIX_H
+
+#include "WireBuffer.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Pre-encoded start of a chat message for the current display name.
+// It is rebuilt only when the name changes (AUTH, /rename); encoding a message is then one
+// prefix copy plus the content append into a pooled WireBuffer.
+
+// TCP: "MSG FROM {DisplayName} IS "
+class TcpMsgPrefix {
+public:
+    TcpMsgPrefix() { rebuild(""); }
+    void rebuild(const std::string& displayName);
+
+    // Returns the complete line: prefix + content + CRLF
+    WireBuffer encode(std::string_view content) const;
+
+private:
+    std::string prefix;
+};
+
+// UDP: type byte, MessageID placeholder, display name and its NUL terminator
+class UdpMsgPrefix {
+public:
+    UdpMsgPrefix() { rebuild(""); }
+    void rebuild(const std::string& displayName);
+
+    // Returns the complete datagram with the given MessageID: prefix + content + NUL
+    WireBuffer encode(uint16_t messageId, const std::string& content) const;
+
+private:
+    std::vector<uint8_t> prefix;
+};
+
+#endif // MESSAGEPREFIX_H
@@ -1,9 +1,12 @@
 #include "MessageUdp.h"
+#include "Trace.h"
 #include <arpa/inet.h>
 #include <cstring>
 
 std::vector<uint8_t> packUdpMessage(const UdpMessage& msg) {
+    TRACE_SCOPE("encode");
     std::vector<uint8_t> buffer;
+    buffer.reserve(3 + msg.payload.size());
 
     buffer.push_back(static_cast<uint8_t>(msg.type));
 
@@ -22,20 +25,25 @@ std::vector<uint8_t> packUdpMessage(const UdpMessage& msg) {
 
 // Rozbalí (unpack) binární buffer zpět do struktury UdpMessage.
 bool unpackUdpMessage(const std::vector<uint8_t>& buffer, UdpMessage& msg) {
-    if (buffer.size() < 3) {
+    return unpackUdpMessage(buffer.data(), buffer.size(), msg);
+}
+
+bool unpackUdpMessage(const uint8_t* data, size_t length, UdpMessage& msg) {
+    TRACE_SCOPE("decode");
+    if (length < 3) {
         return false;
     }
     
     // První bajt je typ zprávy
-    msg.type = static_cast<UdpMessageType>(buffer[0]);
+    msg.type = static_cast<UdpMessageType>(data[0]);
     
     // Následující 2 bajty jsou MessageID 
     uint16_t netMessageId;
-    std::memcpy(&netMessageId, &buffer[1], sizeof(uint16_t));
+    std::memcpy(&netMessageId, &data[1], sizeof(uint16_t));
     msg.messageId = ntohs(netMessageId);
     
-    // Zbytek bufferu je payload
-    msg.payload = std::vector<uint8_t>(buffer.begin() + 3, buffer.end());
+    // Zbytek bufferu je payload (v paměti, kterou si zpráva přinesla)
+    msg.payload.assign(data + 3, data + length);
     
     return true;
 }
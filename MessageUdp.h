@@ -1,7 +1,9 @@
 #ifndef MESSAGEUDP_H
 #define MESSAGEUDP_H
 
+#include <cstddef>
 #include <cstdint>
+#include <memory_resource>
 #include <vector>
 #include <string>
 
@@ -17,11 +19,13 @@ enum class UdpMessageType : uint8_t {
     BYE     = 0xFF   // Terminate connection
 };
 
-// Structure representing a UDP message to be sent or received
+// Structure representing a UDP message to be sent or received.
+// The payload takes its memory from the resource it was constructed with (the session pool by
+// default, a ScratchArena for received datagrams).
 struct UdpMessage {
     UdpMessageType type;       // Message type (1 byte)
     uint16_t messageId;        // Message ID (2 bytes) for deduplication/retry
-    std::vector<uint8_t> payload; // Message content (can be empty)
+    std::pmr::vector<uint8_t> payload; // Message content (can be empty)
 };
 
 // Converts a UdpMessage struct into a raw byte buffer for sending via UDP
@@ -29,5 +33,6 @@ std::vector<uint8_t> packUdpMessage(const UdpMessage& msg);
 
 // Converts a received raw byte buffer into a UdpMessage struct
 bool unpackUdpMessage(const std::vector<uint8_t>& buffer, UdpMessage& msg);
+bool unpackUdpMessage(const uint8_t* data, size_t length, UdpMessage& msg);
 
 #endif // MESSAGEUDP_H
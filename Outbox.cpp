@@ -0,0 +1,318 @@
+#include "Outbox.h"
+#include "debug.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <new>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char FILE_MAGIC[8] = {'I', 'P', 'K', 'O', 'B', 'X', '1', '\0'};
+constexpr size_t HEADER_SIZE = 64;           // File magic, then the records
+constexpr uint32_t RECORD_MAGIC = 0x584f4252;  // Written last, marks a complete record
+constexpr uint32_t STATE_PENDING = 1;
+constexpr uint32_t STATE_DONE = 2;
+
+// Followed by `length` bytes of content, padded to 8 bytes
+struct RecordHeader {
+    std::atomic<uint32_t> magic;
+    uint32_t length;
+    std::atomic<uint32_t> state;
+    uint32_t checksum;
+};
+
+size_t recordSize(size_t length) {
+    return (sizeof(RecordHeader) + length + 7) & ~size_t(7);
+}
+
+// FNV-1a, detects records torn by a crash of the machine between two msyncs
+uint32_t checksumOf(const char* data, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+RecordHeader* recordAt(char* base, size_t offset) {
+    return reinterpret_cast<RecordHeader*>(base + offset);
+}
+
+// Maps a journal file of `size` bytes, nullptr after perror
+char* mapJournal(int fd, size_t size) {
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED) {
+        perror("ERROR: Unable to map the outbox");
+        return nullptr;
+    }
+    return static_cast<char*>(memory);
+}
+
+// Makes a rename() in the directory of `path` durable, false after perror
+bool syncParentDirectory(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    int dirFd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd < 0 || fsync(dirFd) < 0) {
+        perror("ERROR: Unable to sync the outbox directory");
+        if (dirFd >= 0) ::close(dirFd);
+        return false;
+    }
+    ::close(dirFd);
+    return true;
+}
+
+}  // namespace
+
+Outbox::Outbox(const std::string& path, size_t capacity, std::chrono::milliseconds syncInterval)
+    : path(path), capacity(std::max(capacity, HEADER_SIZE + 4096)), syncInterval(syncInterval) {}
+
+Outbox::~Outbox() {
+    close();
+}
+
+bool Outbox::open() {
+    struct stat info {};
+    for (;;) {
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        if (fd < 0) {
+            perror(("ERROR: Unable to open the outbox " + path).c_str());
+            return false;
+        }
+        // One client per journal: two would resend each other's messages and compact the file
+        // under each other's mapping
+        if (flock(fd, LOCK_EX | LOCK_NB) < 0) {
+            if (errno == EWOULDBLOCK) {
+                std::cerr << "ERROR: Outbox " << path << " is used by another client" << std::endl;
+            } else {
+                perror(("ERROR: Unable to lock the outbox " + path).c_str());
+            }
+            return false;
+        }
+        // The holder may have compacted it between our open() and flock(), then the locked
+        // file is the replaced one
+        struct stat current {};
+        if (fstat(fd, &info) < 0) {
+            perror(("ERROR: Unable to open the outbox " + path).c_str());
+            return false;
+        }
+        if (stat(path.c_str(), &current) == 0 && current.st_ino == info.st_ino && current.st_dev == info.st_dev) break;
+        ::close(fd);
+    }
+    bool fresh = info.st_size == 0;
+    if (fresh) {
+        if (ftruncate(fd, static_cast<off_t>(capacity)) < 0) {
+            perror("ERROR: Unable to size the outbox");
+            return false;
+        }
+    } else {
+        capacity = static_cast<size_t>(info.st_size);
+    }
+    base = mapJournal(fd, capacity);
+    if (base == nullptr) return false;
+    if (fresh) {
+        std::memcpy(base, FILE_MAGIC, sizeof(FILE_MAGIC));
+        msync(base, HEADER_SIZE, MS_SYNC);
+    } else if (capacity < HEADER_SIZE || std::memcmp(base, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0) {
+        std::cerr << "ERROR: " << path << " is not an outbox journal" << std::endl;
+        return false;
+    }
+    recover();
+    if (!recovered.empty()) {
+        std::cerr << "Outbox: " << recovered.size() << " unconfirmed message(s) from the previous run" << std::endl;
+    }
+    syncThread = std::thread(&Outbox::syncLoop, this);
+    return true;
+}
+
+// Scans the records of the previous run, pending ones get tickets again
+void Outbox::recover() {
+    size_t offset = HEADER_SIZE;
+    while (offset + sizeof(RecordHeader) <= capacity) {
+        RecordHeader* record = recordAt(base, offset);
+        if (record->magic.load(std::memory_order_acquire) != RECORD_MAGIC) break;
+        size_t size = recordSize(record->length);
+        if (record->length > capacity || offset + size > capacity) break;
+        const char* content = reinterpret_cast<const char*>(record + 1);
+        if (checksumOf(content, record->length) != record->checksum) break;  // Torn, the rest is lost
+        if (record->state.load(std::memory_order_relaxed) == STATE_PENDING) {
+            uint64_t ticket = nextTicket++;
+            offsets[ticket] = offset;
+            recovered.push_back({ticket, std::string(content, record->length)});
+        } else {
+            deadBytes += size;
+        }
+        offset += size;
+    }
+    tail = offset;
+    // Leftovers behind a torn record must not turn up as records once new ones are appended
+    if (std::any_of(base + tail, base + capacity, [](char c) { return c != 0; })) {
+        std::memset(base + tail, 0, capacity - tail);
+        dirtyBegin = tail;
+        dirtyEnd = capacity;
+    }
+}
+
+void Outbox::close() {
+    if (base == nullptr) {
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+        return;
+    }
+    stop.notify();
+    if (syncThread.joinable()) syncThread.join();
+    std::lock_guard<std::mutex> mapping(mappingMutex);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (deadBytes == 0 || !rewriteLocked(capacity)) msync(base, capacity, MS_SYNC);
+    munmap(base, capacity);
+    ::close(fd);
+    base = nullptr;
+    fd = -1;
+}
+
+std::vector<Outbox::Recovered> Outbox::takeRecovered() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::move(recovered);
+}
+
+uint64_t Outbox::add(std::string_view content) {
+    size_t size = recordSize(content.size());
+    std::unique_lock<std::mutex> lock(mutex);
+    if (tail + size > capacity) {
+        // Full: compact, or grow if the pending records need the room. Rare, the sync thread
+        // compacts long before; the mapping is only replaced with both mutexes held.
+        lock.unlock();
+        std::lock_guard<std::mutex> mapping(mappingMutex);
+        lock.lock();
+        if (tail + size > capacity) {
+            size_t live = tail - deadBytes;
+            size_t needed = live + size;
+            if (!rewriteLocked(needed * 2 > capacity ? std::max(capacity * 2, needed * 2) : capacity)) return 0;
+        }
+    }
+
+    RecordHeader* record = new (recordAt(base, tail)) RecordHeader();
+    record->length = static_cast<uint32_t>(content.size());
+    record->state.store(STATE_PENDING, std::memory_order_relaxed);
+    record->checksum = checksumOf(content.data(), content.size());
+    std::memcpy(reinterpret_cast<char*>(record + 1), content.data(), content.size());
+    record->magic.store(RECORD_MAGIC, std::memory_order_release);
+
+    uint64_t ticket = nextTicket++;
+    offsets[ticket] = tail;
+    dirtyBegin = std::min(dirtyBegin, tail);
+    tail += size;
+    dirtyEnd = std::max(dirtyEnd, tail);
+    return ticket;
+}
+
+void Outbox::done(uint64_t ticket) {
+    if (ticket == 0) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = offsets.find(ticket);
+    if (it == offsets.end()) return;
+    RecordHeader* record = recordAt(base, it->second);
+    record->state.store(STATE_DONE, std::memory_order_release);
+    deadBytes += recordSize(record->length);
+    dirtyBegin = std::min(dirtyBegin, it->second);
+    dirtyEnd = std::max(dirtyEnd, it->second + sizeof(RecordHeader));
+    offsets.erase(it);
+}
+
+size_t Outbox::pending() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return offsets.size();
+}
+
+// Copies the pending records, in order, into a new file that replaces the journal by rename(),
+// so a crash leaves either the old or the new journal complete
+bool Outbox::rewriteLocked(size_t newCapacity) {
+    std::string tempPath = path + ".tmp";
+    int newFd = ::open(tempPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (newFd < 0 || ftruncate(newFd, static_cast<off_t>(newCapacity)) < 0) {
+        perror("ERROR: Unable to compact the outbox");
+        if (newFd >= 0) ::close(newFd);
+        unlink(tempPath.c_str());
+        return false;
+    }
+    char* newBase = mapJournal(newFd, newCapacity);
+    if (newBase == nullptr) {
+        ::close(newFd);
+        unlink(tempPath.c_str());
+        return false;
+    }
+    std::memcpy(newBase, FILE_MAGIC, sizeof(FILE_MAGIC));
+
+    std::vector<std::pair<size_t, uint64_t>> live;  // Old offset, ticket
+    live.reserve(offsets.size());
+    for (const auto& entry : offsets) live.emplace_back(entry.second, entry.first);
+    std::sort(live.begin(), live.end());
+    size_t newTail = HEADER_SIZE;
+    for (const auto& entry : live) {
+        size_t size = recordSize(recordAt(base, entry.first)->length);
+        std::memcpy(newBase + newTail, base + entry.first, size);
+        offsets[entry.second] = newTail;
+        newTail += size;
+    }
+    msync(newBase, newTail, MS_SYNC);
+    // Locked before it appears under the journal's name, so no other client can take it over
+    if (flock(newFd, LOCK_EX | LOCK_NB) < 0 || rename(tempPath.c_str(), path.c_str()) < 0) {
+        perror("ERROR: Unable to replace the outbox");
+        munmap(newBase, newCapacity);
+        ::close(newFd);
+        unlink(tempPath.c_str());
+        for (const auto& entry : live) offsets[entry.second] = entry.first;
+        return false;
+    }
+
+    syncParentDirectory(path);  // Otherwise a crash of the machine may bring back the old file
+
+    munmap(base, capacity);
+    ::close(fd);
+    fd = newFd;
+    base = newBase;
+    capacity = newCapacity;
+    tail = newTail;
+    deadBytes = 0;
+    dirtyBegin = SIZE_MAX;
+    dirtyEnd = 0;
+    printf_debug("Outbox compacted: %zu pending record(s), %zu bytes", live.size(), newTail);
+    return true;
+}
+
+// Syncs what was written since the last round, one msync per interval however many messages
+// were journaled, and compacts once more than half of the file is done records
+void Outbox::syncLoop() {
+    const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    while (!stop.waitFor(syncInterval)) {
+        std::lock_guard<std::mutex> mapping(mappingMutex);
+        size_t begin, end;
+        bool compact;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            begin = dirtyBegin;
+            end = dirtyEnd;
+            dirtyBegin = SIZE_MAX;
+            dirtyEnd = 0;
+            compact = deadBytes > capacity / 2;
+        }
+        // The senders keep appending meanwhile, only the mapping is held
+        if (begin < end) {
+            begin -= begin % pageSize;
+            if (msync(base + begin, end - begin, MS_SYNC) < 0) perror("ERROR: Unable to sync the outbox");
+        }
+        if (compact) {
+            std::lock_guard<std::mutex> lock(mutex);
+            rewriteLocked(capacity);
+        }
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef OUTBOX_H
+#define OUTBOX_H
+
+#include "Shutdown.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Crash-safe journal of outbound chat messages (--outbox FILE, UDP). Every message is appended
+// to a memory-mapped file before it is sent and marked done in place when its CONFIRM arrives,
+// so a killed client leaves the unconfirmed ones behind; the next run resends them after the
+// first successful AUTH. Delivery across a restart is at least once: a message confirmed just
+// before the crash may be sent again.
+//
+// The mapping survives a crash of the process by itself; a background thread pushes the dirty
+// range to the disk with one msync per interval (not per message) against a crash of the
+// machine, and compacts the file by writing the pending records into a new one and renaming it
+// over the old. Records carry a checksum, recovery stops at the first torn one.
+//
+// Thread-safe: add() runs on the sending threads, done() on the receiver.
+class Outbox {
+public:
+    struct Recovered {
+        uint64_t ticket;
+        std::string content;
+    };
+
+    explicit Outbox(const std::string& path, size_t capacity = 4 * 1024 * 1024,
+                    std::chrono::milliseconds syncInterval = std::chrono::milliseconds(100));
+    ~Outbox();
+
+    Outbox(const Outbox&) = delete;
+    Outbox& operator=(const Outbox&) = delete;
+
+    // Maps the journal (creating it if needed), recovers the pending records of the previous
+    // run and starts the sync thread. False after reporting the problem.
+    bool open();
+
+    // Stops the sync thread, compacts and syncs the journal; pending records stay for next run
+    void close();
+
+    // Pending messages of the previous run in their original order, once. They keep their
+    // journal records, pass the ticket to done() when they are confirmed at last.
+    std::vector<Recovered> takeRecovered();
+
+    // Journals a message before it is sent, returns its ticket (0 if it could not be written)
+    uint64_t add(std::string_view content);
+
+    // The message was confirmed, ticket 0 is ignored
+    void done(uint64_t ticket);
+
+    size_t pending() const;
+
+private:
+    bool rewriteLocked(size_t newCapacity);  // Compaction into a new file, both mutexes held
+    void recover();
+    void syncLoop();
+
+    std::string path;
+    size_t capacity;
+    std::chrono::milliseconds syncInterval;
+    int fd = -1;
+    char* base = nullptr;
+    size_t tail = 0;                                 // End of the last record
+    size_t dirtyBegin = SIZE_MAX, dirtyEnd = 0;      // Written since the last msync
+    size_t deadBytes = 0;                            // Records already done
+    uint64_t nextTicket = 1;
+    std::unordered_map<uint64_t, size_t> offsets;   // Pending ticket -> record offset
+    std::vector<Recovered> recovered;
+    mutable std::mutex mutex;  // Records, offsets and counters
+    std::mutex mappingMutex;   // Taken before `mutex` to replace the mapping or msync outside it
+    Wakeup stop;
+    std::thread syncThread;
+};
+
+#endif // OUTBOX_H
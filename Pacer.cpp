@@ -0,0 +1,13 @@
+#include "Pacer.h"
+#include <algorithm>
+
+TokenBucket::TokenBucket(double ratePerSecond, double burst)
+    : emissionInterval(static_cast<int64_t>(1e9 / ratePerSecond)),
+      burstTolerance(static_cast<int64_t>((std::max(burst, 1.0) - 1.0) * 1e9 / ratePerSecond)),
+      theoreticalArrival() {}
+
+TokenBucket::time_point TokenBucket::acquire(time_point now) {
+    time_point sendAt = std::max(now, theoreticalArrival - burstTolerance);
+    theoreticalArrival = std::max(theoreticalArrival, sendAt) + emissionInterval;
+    return sendAt;
+}
@@ -0,0 +1,26 @@
+#ifndef PACER_H
+#define PACER_H
+
+#include <chrono>
+
+// Token bucket in its "virtual scheduling" form (GCRA): instead of counting tokens it keeps the
+// theoretical arrival time of the next message, so the result is an exact send time and not
+// a polling decision. Up to `burst` messages may go out back to back, then one per 1/rate.
+class TokenBucket {
+public:
+    using time_point = std::chrono::steady_clock::time_point;
+
+    TokenBucket(double ratePerSecond, double burst);
+
+    // Takes one token and returns the time at which it may be used (`now` if one is available)
+    time_point acquire(time_point now);
+
+    std::chrono::nanoseconds interval() const { return emissionInterval; }
+
+private:
+    std::chrono::nanoseconds emissionInterval;  // 1 / rate
+    std::chrono::nanoseconds burstTolerance;    // (burst - 1) / rate
+    time_point theoreticalArrival;
+};
+
+#endif // PACER_H
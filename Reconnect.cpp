@@ -0,0 +1,75 @@
+#include "Reconnect.h"
+#include <algorithm>
+
+Backoff::Backoff(const ReconnectPolicy& policy, uint32_t seed)
+    : initialDelay(policy.initialDelay),
+      maxDelay(std::max(policy.maxDelay, policy.initialDelay)),
+      base(policy.initialDelay),
+      random(seed) {}
+
+std::chrono::milliseconds Backoff::next() {
+    std::chrono::milliseconds current = base;
+    base = std::min(base * 2, maxDelay);
+    ++attempt;
+
+    // Half of the step is fixed, the other half is random
+    int64_t half = current.count() / 2;
+    std::uniform_int_distribution<int64_t> jitter(0, current.count() - half);
+    return std::chrono::milliseconds(half + jitter(random));
+}
+
+void Backoff::reset() {
+    base = initialDelay;
+    attempt = 0;
+}
+
+void OutageQueue::setCapacity(size_t newCapacity) {
+    std::lock_guard<std::mutex> lock(mutex);
+    capacity = newCapacity;
+}
+
+bool OutageQueue::push(const std::string& message, uint64_t ticket) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (messages.size() >= capacity) {
+        ++droppedCount;
+        return false;
+    }
+    messages.push_back(message);
+    tickets.push_back(ticket);
+    return true;
+}
+
+void OutageQueue::pushFront(const std::vector<std::string>& front, const std::vector<uint64_t>& frontTickets) {
+    std::lock_guard<std::mutex> lock(mutex);
+    messages.insert(messages.begin(), front.begin(), front.end());
+    if (frontTickets.size() == front.size()) {
+        tickets.insert(tickets.begin(), frontTickets.begin(), frontTickets.end());
+    } else {
+        tickets.insert(tickets.begin(), front.size(), 0);
+    }
+    while (messages.size() > capacity) {
+        messages.pop_back();
+        tickets.pop_back();
+        ++droppedCount;
+    }
+}
+
+std::vector<std::string> OutageQueue::takeAll(std::vector<uint64_t>* takenTickets) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::string> all(std::make_move_iterator(messages.begin()),
+                                 std::make_move_iterator(messages.end()));
+    if (takenTickets != nullptr) takenTickets->assign(tickets.begin(), tickets.end());
+    messages.clear();
+    tickets.clear();
+    return all;
+}
+
+size_t OutageQueue::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return messages.size();
+}
+
+uint64_t OutageQueue::dropped() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return droppedCount;
+}
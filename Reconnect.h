@@ -0,0 +1,73 @@
+#ifndef RECONNECT_H
+#define RECONNECT_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+// Settings of the opt-in resilient mode (--reconnect)
+struct ReconnectPolicy {
+    bool enabled = false;
+    std::chrono::milliseconds initialDelay{200};   // First backoff step
+    std::chrono::milliseconds maxDelay{10000};     // Upper bound of one backoff step
+    size_t queueLimit = 1000;                      // Messages held while the server is unreachable
+};
+
+// Jittered exponential backoff: every step doubles the base delay up to maxDelay and
+// waits a random time between half and the whole base ("equal jitter"), so that many
+// clients dropped at once do not reconnect in lockstep.
+class Backoff {
+public:
+    explicit Backoff(const ReconnectPolicy& policy, uint32_t seed = std::random_device{}());
+
+    // Returns the delay before the next attempt and advances the backoff
+    std::chrono::milliseconds next();
+
+    // Starts again from the initial delay (after a successful reconnect)
+    void reset();
+
+    int attempts() const { return attempt; }
+
+private:
+    std::chrono::milliseconds initialDelay;
+    std::chrono::milliseconds maxDelay;
+    std::chrono::milliseconds base;
+    int attempt = 0;
+    std::mt19937 random;
+};
+
+// Bounded FIFO of outgoing user messages kept during an outage, each with the ticket of its
+// outbox record (0 without --outbox). Thread-safe: the input thread pushes, the thread that restores the session drains.
+class OutageQueue {
+public:
+    explicit OutageQueue(size_t capacity = 1000) : capacity(capacity) {}
+
+    void setCapacity(size_t newCapacity);
+
+    // Appends a message, returns false (and counts it as dropped) when the queue is full
+    bool push(const std::string& message, uint64_t ticket = 0);
+
+    // Puts messages back in front of the queue (e.g. unconfirmed ones), keeping their order.
+    // Messages that no longer fit are dropped from the end. `tickets` is empty or parallel.
+    void pushFront(const std::vector<std::string>& messages, const std::vector<uint64_t>& tickets = {});
+
+    // Removes and returns all queued messages in order, their tickets into `tickets` if given
+    std::vector<std::string> takeAll(std::vector<uint64_t>* tickets = nullptr);
+
+    size_t size() const;
+    uint64_t dropped() const;
+
+private:
+    mutable std::mutex mutex;
+    std::deque<std::string> messages;
+    std::deque<uint64_t> tickets;  // Parallel to messages
+    size_t capacity;
+    uint64_t droppedCount = 0;
+};
+
+#endif // RECONNECT_H
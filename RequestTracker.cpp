@@ -0,0 +1,124 @@
+#include "RequestTracker.h"
+#include <algorithm>
+#include <vector>
+#include <utility>
+
+void RequestTracker::add(PendingRequest request) {
+    std::lock_guard<std::mutex> lock(mutex);
+    request.deadline = request.sentAt + timeout;
+    requests.push_back(std::move(request));
+    outstanding.store(requests.size(), std::memory_order_release);
+}
+
+// Moves the request to the finished queue, `mutex` must be held
+void RequestTracker::finishLocked(std::deque<PendingRequest>::iterator it, RequestStatus status,
+                                  std::string content, TimePoint now) {
+    RequestResult result{status, std::move(content), now - it->sentAt};
+    finished.push_back({std::move(*it), std::move(result)});
+    requests.erase(it);
+    outstanding.store(requests.size(), std::memory_order_release);
+}
+
+std::optional<std::chrono::steady_clock::duration> RequestTracker::completeById(uint16_t refId, bool ok,
+                                                                                std::string content, TimePoint now) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = std::find_if(requests.begin(), requests.end(),
+                           [refId](const PendingRequest& request) { return request.messageId == refId; });
+    if (it == requests.end()) return std::nullopt;
+    auto waited = now - it->sentAt;
+    finishLocked(it, ok ? RequestStatus::OK : RequestStatus::NOK, std::move(content), now);
+    return waited;
+}
+
+std::optional<std::chrono::steady_clock::duration> RequestTracker::completeOldest(bool ok, std::string content,
+                                                                                  TimePoint now) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (lateReplies > 0) {
+        lateReplies--;  // Answers a request that already timed out
+        return std::nullopt;
+    }
+    if (requests.empty()) return std::nullopt;
+    auto waited = now - requests.front().sentAt;
+    finishLocked(requests.begin(), ok ? RequestStatus::OK : RequestStatus::NOK, std::move(content), now);
+    return waited;
+}
+
+size_t RequestTracker::expire(TimePoint now, bool awaitLateReply) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t count = 0;
+    if (awaitLateReply) {
+        while (!requests.empty() && requests.front().deadline <= now) {
+            finishLocked(requests.begin(), RequestStatus::TIMEOUT, std::string(), now);
+            lateReplies++;
+            count++;
+        }
+        return count;
+    }
+    for (auto it = requests.begin(); it != requests.end();) {
+        if (it->deadline <= now) {
+            size_t index = static_cast<size_t>(it - requests.begin());
+            finishLocked(it, RequestStatus::TIMEOUT, std::string(), now);
+            it = requests.begin() + static_cast<std::ptrdiff_t>(index);
+            count++;
+        } else {
+            ++it;
+        }
+    }
+    return count;
+}
+
+size_t RequestTracker::cancelAll(TimePoint now) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t count = requests.size();
+    lateReplies = 0;
+    while (!requests.empty()) finishLocked(requests.begin(), RequestStatus::CANCELLED, std::string(), now);
+    return count;
+}
+
+std::optional<RequestTracker::TimePoint> RequestTracker::nextDeadline() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (requests.empty()) return std::nullopt;
+    auto earliest = std::min_element(requests.begin(), requests.end(), [](const auto& a, const auto& b) {
+        return a.deadline < b.deadline;
+    });
+    return earliest->deadline;
+}
+
+void RequestTracker::runFinished() {
+    std::vector<Finished> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.assign(std::make_move_iterator(finished.begin()), std::make_move_iterator(finished.end()));
+        finished.clear();
+        if (!ready.empty()) lastHandled = ready.back().result.status;
+    }
+    // Handlers run unlocked, they may open the next request
+    for (const Finished& entry : ready) {
+        if (entry.request.onDone) entry.request.onDone(entry.result);
+    }
+}
+
+bool RequestTracker::holdIfPending(std::string_view text, bool verbatim) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (requests.empty() && finished.empty() && held.empty()) return false;
+    held.push_back({std::string(text), verbatim});
+    return true;
+}
+
+bool RequestTracker::busy() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return !requests.empty() || !finished.empty() || !held.empty();
+}
+
+std::optional<RequestStatus> RequestTracker::takeHandled() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::exchange(lastHandled, std::nullopt);
+}
+
+bool RequestTracker::nextHeld(HeldInput& input) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!requests.empty() || !finished.empty() || held.empty()) return false;
+    input = std::move(held.front());
+    held.pop_front();
+    return true;
+}
@@ -0,0 +1,121 @@
+#ifndef REQUESTTRACKER_H
+#define REQUESTTRACKER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// How an AUTH or JOIN ended
+enum class RequestStatus { OK, NOK, TIMEOUT, CANCELLED };
+
+struct RequestResult {
+    RequestStatus status;
+    std::string content;                         // REPLY content, empty without a REPLY
+    std::chrono::steady_clock::duration waited;  // From sending to the REPLY, timeout or loss
+};
+
+// An AUTH or JOIN waiting for its REPLY
+struct PendingRequest {
+    enum class Kind { AUTH, JOIN };
+
+    Kind kind = Kind::AUTH;
+    uint16_t messageId = 0;  // MessageID a UDP REPLY refers to, unused over TCP
+    std::string argument;    // Display name for AUTH, channel for JOIN
+    std::chrono::steady_clock::time_point sentAt;
+    std::chrono::steady_clock::time_point deadline;
+    std::function<void(const RequestResult&)> onDone;
+};
+
+// A line of input held back while a request is outstanding
+struct HeldInput {
+    std::string text;
+    bool verbatim = false;  // A chat message from sendChat(), never parsed as a command
+};
+
+// Correlates REPLYs with the outstanding AUTH/JOIN requests: by RefMessageID over UDP, by order
+// over TCP (the server answers requests in sequence). Every request has a deadline.
+//
+// The receiving side only completes requests. The completion handlers run on the input side
+// (runFinished()), which owns the session state they change, so a REPLY never waits for the
+// input and the handlers never race with it. Input entered while a request is outstanding is
+// held instead of being sent or dropped: a JOIN and the messages after it can be entered back to
+// back and still reach the new channel, in order. The held input is released once every request
+// is done and handled; a held /join opens the next request and keeps the rest held.
+// Thread-safe.
+class RequestTracker {
+public:
+    using TimePoint = std::chrono::steady_clock::time_point;
+
+    void setTimeout(std::chrono::milliseconds replyTimeout) { timeout = replyTimeout; }
+    std::chrono::milliseconds replyTimeout() const { return timeout; }
+
+    // Starts tracking, the deadline is sentAt plus the timeout
+    void add(PendingRequest request);
+
+    // UDP: completes the request the RefMessageID answers. Returns how long it waited, or
+    // nothing for unknown and already finished requests.
+    std::optional<std::chrono::steady_clock::duration> completeById(uint16_t refId, bool ok, std::string content,
+                                                                    TimePoint now);
+
+    // TCP: completes the oldest request. A REPLY that arrives for a request expired with
+    // `awaitLateReply` is consumed and discarded (nothing is returned), so it cannot complete
+    // the request sent after it.
+    std::optional<std::chrono::steady_clock::duration> completeOldest(bool ok, std::string content, TimePoint now);
+
+    // Finishes overdue requests with TIMEOUT, returns how many. With `awaitLateReply` (TCP, where
+    // REPLYs are matched by order) only the oldest requests expire and each keeps a slot for its
+    // REPLY, which may still come.
+    size_t expire(TimePoint now, bool awaitLateReply = false);
+
+    // Finishes everything outstanding with CANCELLED (the connection was lost), returns how many.
+    // Late REPLYs are no longer awaited.
+    size_t cancelAll(TimePoint now);
+
+    // Outstanding requests, lock-free for polling loops
+    bool pending() const { return outstanding.load(std::memory_order_acquire) > 0; }
+    std::optional<TimePoint> nextDeadline() const;
+
+    // Input side: runs the handlers of the finished requests in completion order. The input side
+    // (runFinished, holdIfPending, nextHeld) must be serialized by the caller.
+    void runFinished();
+
+    // Holds the input and returns true while a request is outstanding or not handled yet, or
+    // earlier input is held. Copies the text only when holding it.
+    bool holdIfPending(std::string_view text, bool verbatim = false);
+
+    // Next held input once every request is done and handled, false otherwise or if none is left
+    bool nextHeld(HeldInput& input);
+
+    // True while requests are outstanding or not handled, or input is held
+    bool busy() const;
+
+    // Status of the last request runFinished() handled since the previous call, if any
+    // (--batch checks the outcome of each step)
+    std::optional<RequestStatus> takeHandled();
+
+private:
+    struct Finished {
+        PendingRequest request;
+        RequestResult result;
+    };
+
+    void finishLocked(std::deque<PendingRequest>::iterator it, RequestStatus status, std::string content,
+                      TimePoint now);
+
+    mutable std::mutex mutex;
+    std::deque<PendingRequest> requests;  // In the order they were sent
+    std::deque<Finished> finished;        // Waiting for runFinished()
+    std::deque<HeldInput> held;
+    std::optional<RequestStatus> lastHandled;
+    std::atomic<size_t> outstanding{0};   // requests.size()
+    size_t lateReplies = 0;               // Expired TCP requests before `requests`, REPLY not seen yet
+    std::chrono::milliseconds timeout{5000};
+};
+
+#endif // REQUESTTRACKER_H
@@ -0,0 +1,132 @@
+#include "SendScheduler.h"
+#include "LatencyHistogram.h"
+#include "Stats.h"
+#include "Trace.h"
+
+SendScheduler::SendScheduler(double bulkRatePerSecond, double bulkBurst)
+    : bucket(bulkRatePerSecond, bulkBurst), windowStart(std::chrono::steady_clock::now()) {
+    gaugeIds[0] = registerStatGauge("ipk25_pacer_rate", "Chat messages per second sent by the pacer.",
+                                    [this]() { return static_cast<int64_t>(currentRate()); });
+    gaugeIds[1] = registerStatGauge("ipk25_send_queue_control", "Control messages waiting in the send scheduler.",
+                                    [this]() { return static_cast<int64_t>(queueDepth(SendClass::CONTROL)); });
+    gaugeIds[2] = registerStatGauge("ipk25_send_queue_bulk", "Chat messages waiting in the send scheduler.",
+                                    [this]() { return static_cast<int64_t>(queueDepth(SendClass::BULK)); });
+    thread = std::thread(&SendScheduler::loop, this);
+}
+
+SendScheduler::~SendScheduler() {
+    stop();
+    for (int id : gaugeIds) unregisterStatGauge(id);
+}
+
+void SendScheduler::submit(SendClass sendClass, std::function<void()> send) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queues[static_cast<size_t>(sendClass)].push_back({std::move(send), std::chrono::steady_clock::now()});
+    }
+    wakeup.notify_one();
+}
+
+size_t SendScheduler::flush(std::chrono::steady_clock::time_point deadline) {
+    std::unique_lock<std::mutex> lock(mutex);
+    drained.wait_until(lock, deadline, [this]() { return queuedTotal() == 0 && !sending; });
+    return queuedTotal();
+}
+
+void SendScheduler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopped = true;
+        for (auto& queue : queues) queue.clear();
+    }
+    wakeup.notify_one();
+    if (thread.joinable()) thread.join();
+}
+
+size_t SendScheduler::queueDepth(SendClass sendClass) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return queues[static_cast<size_t>(sendClass)].size();
+}
+
+// Called with the mutex held
+size_t SendScheduler::queuedTotal() const {
+    size_t total = 0;
+    for (const auto& queue : queues) total += queue.size();
+    return total;
+}
+
+// Rate over windows of at least one second, updated on every chat message
+void SendScheduler::updateRate(std::chrono::steady_clock::time_point now) {
+    ++windowCount;
+    auto elapsed = now - windowStart;
+    if (elapsed >= std::chrono::seconds(1)) {
+        double seconds = std::chrono::duration<double>(elapsed).count();
+        measuredRate.store(static_cast<double>(windowCount) / seconds, std::memory_order_relaxed);
+        windowStart = now;
+        windowCount = 0;
+    }
+}
+
+// Runs the front item of a queue without holding the lock
+void SendScheduler::run(SendClass sendClass, Item& item, std::unique_lock<std::mutex>& lock) {
+    sending = true;
+    lock.unlock();
+
+    auto now = std::chrono::steady_clock::now();
+    LatencyMetrics& metrics = latencyMetrics();
+    if (sendClass == SendClass::CONTROL) {
+        metrics.controlQueueLatency.record(now - item.enqueued);
+        TRACE_SCOPE("send_control");
+        item.send();
+    } else {
+        metrics.bulkQueueLatency.record(now - item.enqueued);
+        TRACE_SCOPE("send_bulk");
+        item.send();
+        updateRate(now);
+    }
+
+    lock.lock();
+    sending = false;
+    if (queuedTotal() == 0) drained.notify_all();
+}
+
+void SendScheduler::loop() {
+    Trace::setThreadName("sender");
+    auto& control = queues[static_cast<size_t>(SendClass::CONTROL)];
+    auto& bulk = queues[static_cast<size_t>(SendClass::BULK)];
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wakeup.wait(lock, [this]() { return stopped || queuedTotal() > 0; });
+        if (stopped) break;
+
+        // The front chat message takes its token once, then waits for the token's time
+        auto now = std::chrono::steady_clock::now();
+        bool bulkDue = false;
+        if (!bulk.empty()) {
+            if (!bulkTokenTaken) {
+                bulkSendAt = bucket.acquire(now);
+                bulkTokenTaken = true;
+            }
+            bulkDue = now >= bulkSendAt;
+        }
+
+        if (!control.empty() && (!bulkDue || controlRun < CONTROL_RUN_LIMIT)) {
+            ++controlRun;
+            Item item = std::move(control.front());
+            control.pop_front();
+            run(SendClass::CONTROL, item, lock);
+        } else if (bulkDue) {
+            controlRun = 0;
+            bulkTokenTaken = false;
+            Item item = std::move(bulk.front());
+            bulk.pop_front();
+            run(SendClass::BULK, item, lock);
+        } else {
+            // Only chat messages whose token is not due yet. The condition variable waits on
+            // CLOCK_MONOTONIC with an absolute deadline (futex, no spinning) and a new control
+            // message or stop() interrupts the wait.
+            wakeup.wait_until(lock, bulkSendAt, [this, &control]() { return stopped || !control.empty(); });
+        }
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef SENDSCHEDULER_H
+#define SENDSCHEDULER_H
+
+#include "Pacer.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Traffic classes of the send scheduler.
+// CONTROL: CONFIRMs (also for PING and REPLY), ERR, BYE - never paced, always sent first.
+// BULK: user chat messages - paced by the token bucket.
+enum class SendClass : uint8_t { CONTROL, BULK, COUNT };
+
+constexpr size_t SEND_CLASS_COUNT = static_cast<size_t>(SendClass::COUNT);
+
+// Sends queued by the clients are run on one scheduler thread (--rate, --burst).
+// Control traffic is drained ahead of queued chat messages so that a CONFIRM never waits behind
+// bulk data (the server would retransmit). To keep bulk traffic from starving under a flood of
+// control messages, a bulk message whose token is due gets a turn after CONTROL_RUN_LIMIT control
+// messages in a row. Per-class queueing delay is recorded in the latency histograms
+// (send_queue[control], send_queue[bulk]), queue depths and the bulk rate are statistics gauges.
+class SendScheduler {
+public:
+    // Control messages sent in a row while a bulk message is due
+    static constexpr int CONTROL_RUN_LIMIT = 16;
+
+    SendScheduler(double bulkRatePerSecond, double bulkBurst);
+    ~SendScheduler();
+
+    SendScheduler(const SendScheduler&) = delete;
+    SendScheduler& operator=(const SendScheduler&) = delete;
+
+    // Queues a send of the given class, it runs on the scheduler thread
+    void submit(SendClass sendClass, std::function<void()> send);
+
+    // Waits until every queued send ran or the deadline passed, returns the number still queued
+    size_t flush(std::chrono::steady_clock::time_point deadline);
+
+    // Stops the scheduler thread, sends that are still queued are discarded
+    void stop();
+
+    size_t queueDepth(SendClass sendClass) const;
+
+    // Chat messages per second sent during the last measurement window (about one second)
+    double currentRate() const { return measuredRate.load(std::memory_order_relaxed); }
+
+private:
+    struct Item {
+        std::function<void()> send;
+        std::chrono::steady_clock::time_point enqueued;
+    };
+
+    void loop();
+    void run(SendClass sendClass, Item& item, std::unique_lock<std::mutex>& lock);
+    void updateRate(std::chrono::steady_clock::time_point now);
+    size_t queuedTotal() const;
+
+    TokenBucket bucket;
+    mutable std::mutex mutex;
+    std::condition_variable wakeup;   // New item or stop
+    std::condition_variable drained;  // All queues became empty
+    std::deque<Item> queues[SEND_CLASS_COUNT];
+    bool bulkTokenTaken = false;      // bulkSendAt belongs to the front bulk message
+    std::chrono::steady_clock::time_point bulkSendAt;
+    int controlRun = 0;               // Control messages sent since the last bulk one
+    bool sending = false;             // A send is running outside the lock
+    bool stopped = false;
+
+    std::atomic<double> measuredRate{0.0};
+    std::chrono::steady_clock::time_point windowStart;
+    uint64_t windowCount = 0;
+
+    int gaugeIds[3] = {-1, -1, -1};
+    std::thread thread;
+};
+
+#endif // SENDSCHEDULER_H
@@ -0,0 +1,20 @@
+#include "SessionMemory.h"
+#include <memory>
+
+std::pmr::memory_resource* sessionPool() {
+    static std::pmr::synchronized_pool_resource* pool = new std::pmr::synchronized_pool_resource(
+        std::pmr::pool_options{0, SESSION_POOL_LARGEST_BLOCK}, std::pmr::new_delete_resource());
+    return pool;
+}
+
+void installSessionMemory() {
+    std::pmr::set_default_resource(sessionPool());
+}
+
+// Allocated on the first message of each thread and kept for its lifetime
+static std::byte* scratchBuffer() {
+    thread_local std::unique_ptr<std::byte[]> buffer(new std::byte[SCRATCH_ARENA_SIZE]);
+    return buffer.get();
+}
+
+ScratchArena::ScratchArena() : arena(scratchBuffer(), SCRATCH_ARENA_SIZE, sessionPool()) {}
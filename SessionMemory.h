@@ -0,0 +1,40 @@
+#ifndef SESSIONMEMORY_H
+#define SESSIONMEMORY_H
+
+#include <cstddef>
+#include <memory_resource>
+
+// Largest block the session pool keeps in its size classes, any UDP datagram fits
+constexpr size_t SESSION_POOL_LARGEST_BLOCK = 64 * 1024;
+
+// Scratch space of one thread for per-message temporaries
+constexpr size_t SCRATCH_ARENA_SIZE = 128 * 1024;
+
+// Slab pool shared by all threads: blocks are carved from large chunks in fixed size classes
+// and freed blocks stay in their class, so message objects, payloads and container nodes are
+// recycled instead of going through malloc. Intentionally never destroyed, background threads
+// may still free into it while the process exits.
+std::pmr::memory_resource* sessionPool();
+
+// Makes sessionPool() the default resource of std::pmr containers. Must run before any client
+// object is created, pmr containers keep the resource they were constructed with.
+void installSessionMemory();
+
+// Monotonic arena for the temporaries of one message. Allocation bumps a pointer in a
+// thread-local buffer, deallocation is a no-op and everything is released at once when the
+// arena goes out of scope; larger needs spill into the session pool. Arenas must not nest
+// on one thread, an inner one would reuse the buffer of the outer one.
+class ScratchArena {
+public:
+    ScratchArena();
+
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+
+    std::pmr::memory_resource* resource() { return &arena; }
+
+private:
+    std::pmr::monotonic_buffer_resource arena;
+};
+
+#endif // SESSIONMEMORY_H
@@ -0,0 +1,175 @@
+#include "ShmInbox.h"
+#include "debug.h"
+#include <algorithm>
+#include <cstdio>
+#include <fcntl.h>
+#include <iostream>
+#include <new>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+
+namespace {
+
+uint32_t roundUpPowerOfTwo(uint32_t value) {
+    uint32_t size = 2;
+    while (size < value && size < ShmInbox::MAX_SLOTS) size <<= 1;
+    return size;
+}
+
+}  // namespace
+
+ShmInbox::ShmInbox(const std::string& socketPath, uint32_t slots, uint32_t slotSize)
+    : socketPath(socketPath),
+      slotCount(roundUpPowerOfTwo(slots)),
+      slotSize(std::max<uint32_t>(64, (std::min(slotSize, MAX_SLOT_SIZE) + 63) / 64 * 64)) {}
+
+ShmInbox::~ShmInbox() {
+    stop();
+}
+
+bool ShmInbox::start() {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "ERROR: Ring socket path is too long: " << socketPath << std::endl;
+        return false;
+    }
+    std::strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+    // The ring: header, then the slots on their own cache lines. Sealed against resizing, so a
+    // producer cannot truncate the memory under the client.
+    slotsOffset = (sizeof(ShmRingHeader) + 63) / 64 * 64;
+    mappedSize = slotsOffset + static_cast<size_t>(slotCount) * slotSize;
+    memFd = memfd_create("ipk25-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (memFd < 0 || ftruncate(memFd, static_cast<off_t>(mappedSize)) < 0) {
+        perror("ERROR: Unable to create the message ring");
+        stop();
+        return false;
+    }
+    if (fcntl(memFd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) perror("F_ADD_SEALS");
+    void* memory = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, memFd, 0);
+    if (memory == MAP_FAILED) {
+        perror("ERROR: Unable to map the message ring");
+        stop();
+        return false;
+    }
+    header = new (memory) ShmRingHeader();
+    header->magic = SHM_RING_MAGIC;
+    header->version = SHM_RING_VERSION;
+    header->slotCount = slotCount;
+    header->slotSize = slotSize;
+    header->slotsOffset = slotsOffset;
+    header->sleeping.store(1);  // Nothing to drain yet, the first post wakes the client
+    for (uint32_t i = 0; i < slotCount; ++i) {
+        new (slotAt(i)) ShmRingSlot();
+        slotAt(i)->sequence.store(i, std::memory_order_relaxed);
+    }
+
+    eventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (eventFd < 0 || listenFd < 0) {
+        perror("ERROR: Unable to create the ring socket");
+        stop();
+        return false;
+    }
+    // Remove a stale socket left by a previous run, but never anything else at the path
+    struct stat existing;
+    if (lstat(socketPath.c_str(), &existing) == 0) {
+        if (!S_ISSOCK(existing.st_mode)) {
+            std::cerr << "ERROR: Ring socket path exists and is not a socket: " << socketPath << std::endl;
+            stop();
+            return false;
+        }
+        unlink(socketPath.c_str());
+    }
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(listenFd, 16) < 0) {
+        perror("ERROR: Unable to bind the ring socket");
+        stop();
+        return false;
+    }
+
+    running = true;
+    acceptThread = std::thread(&ShmInbox::acceptLoop, this);
+    printf_debug("Message ring (%u slots of %u bytes) offered on %s", slotCount, slotSize, socketPath.c_str());
+    return true;
+}
+
+void ShmInbox::stop() {
+    bool wasRunning = running.exchange(false);
+    if (acceptThread.joinable()) acceptThread.join();
+    if (listenFd >= 0) {
+        close(listenFd);
+        if (wasRunning) unlink(socketPath.c_str());
+    }
+    if (header != nullptr) munmap(header, mappedSize);
+    if (memFd >= 0) close(memFd);
+    if (eventFd >= 0) close(eventFd);
+    header = nullptr;
+    listenFd = memFd = eventFd = -1;
+}
+
+bool ShmInbox::ready() const {
+    return slotAt(head)->sequence.load(std::memory_order_acquire) == head + 1;
+}
+
+size_t ShmInbox::drain(const std::function<bool(std::string_view text, uint32_t flags)>& handler, size_t budget) {
+    if (header == nullptr) return 0;
+    uint64_t wakeups;
+    ssize_t ignored = read(eventFd, &wakeups, sizeof(wakeups));  // Non-blocking, clears it
+    (void)ignored;
+
+    size_t handled = 0;
+    while (true) {
+        header->sleeping.store(0, std::memory_order_relaxed);  // Busy, producers need not wake us
+        while (handled < budget && ready()) {
+            ShmRingSlot* slot = slotAt(head);
+            // Geometry and lengths come from the client's side, never from shared memory
+            uint32_t length = std::min<uint32_t>(slot->length, static_cast<uint32_t>(capacity()));
+            bool more = handler(std::string_view(reinterpret_cast<const char*>(slot + 1), length), slot->flags);
+            slot->sequence.store(head + slotCount, std::memory_order_release);
+            head++;
+            handled++;
+            if (!more) return handled;
+        }
+        if (handled == budget) {
+            // Let stdin have its turn, the eventfd brings the input loop back
+            uint64_t one = 1;
+            ignored = write(eventFd, &one, sizeof(one));
+            return handled;
+        }
+        // Empty: arm the wakeup and check again, a record published meanwhile would be missed
+        header->sleeping.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!ready()) return handled;
+    }
+}
+
+// Hands the memfd and the eventfd to every connecting producer.
+// poll() with a short timeout lets the thread notice stop() without extra signalling.
+void ShmInbox::acceptLoop() {
+    while (running) {
+        pollfd pfd = {listenFd, POLLIN, 0};
+        if (poll(&pfd, 1, 200) <= 0) continue;
+
+        int clientFd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (clientFd < 0) continue;
+
+        char byte = 0;
+        iovec data{&byte, 1};
+        alignas(cmsghdr) char control[CMSG_SPACE(2 * sizeof(int))] = {};
+        msghdr message{};
+        message.msg_iov = &data;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        cmsghdr* rights = CMSG_FIRSTHDR(&message);
+        rights->cmsg_level = SOL_SOCKET;
+        rights->cmsg_type = SCM_RIGHTS;
+        rights->cmsg_len = CMSG_LEN(2 * sizeof(int));
+        int fds[2] = {memFd, eventFd};
+        std::memcpy(CMSG_DATA(rights), fds, sizeof(fds));
+        if (sendmsg(clientFd, &message, MSG_NOSIGNAL) != 1) perror("ERROR: Unable to hand over the ring");
+        close(clientFd);
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef SHMINBOX_H
+#define SHMINBOX_H
+
+#include "ShmRing.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// Client side of the shared-memory ring (--shm-ring PATH). Creates the ring in a sealed memfd
+// and an eventfd, and hands both to every producer that connects to the Unix socket at PATH
+// (background accept thread, like StatsServer). The client's input loop polls fd() next to
+// stdin and calls drain(), which passes the records to the send path straight from shared
+// memory. Producers are trusted local processes; the geometry is taken from the client's own
+// copy and lengths are clamped, so a misbehaving one can only garble or stall the ring.
+class ShmInbox {
+public:
+    // Largest accepted geometry (--shm-slots, --shm-slot-size)
+    static constexpr uint32_t MAX_SLOTS = 1u << 20;
+    static constexpr uint32_t MAX_SLOT_SIZE = 1u << 20;
+
+    // `slotSize` is rounded up to a multiple of 64 bytes, `slots` to a power of two; both are
+    // clamped to MAX_SLOTS and MAX_SLOT_SIZE
+    ShmInbox(const std::string& socketPath, uint32_t slots = 4096, uint32_t slotSize = 1024);
+    ~ShmInbox();
+
+    ShmInbox(const ShmInbox&) = delete;
+    ShmInbox& operator=(const ShmInbox&) = delete;
+
+    // Creates the ring and the socket and starts the accept thread, false after perror
+    bool start();
+
+    // Stops the accept thread, removes the socket file and unmaps the ring
+    void stop();
+
+    // The eventfd, readable when records may be waiting
+    int fd() const { return eventFd; }
+
+    // Passes at most `budget` records to `handler` (text, SHM_RECORD_* flags) in ring order.
+    // The text points into the slot and is only valid during the call. Stops early when the
+    // handler returns false. The eventfd stays readable while records are left, otherwise the
+    // ring is armed so the next post wakes it. Returns the number of records handled.
+    size_t drain(const std::function<bool(std::string_view text, uint32_t flags)>& handler, size_t budget = 256);
+
+    size_t capacity() const { return slotSize - sizeof(ShmRingSlot); }
+
+private:
+    ShmRingSlot* slotAt(uint64_t pos) const {
+        return reinterpret_cast<ShmRingSlot*>(reinterpret_cast<char*>(header) + slotsOffset + (pos & (slotCount - 1)) * slotSize);
+    }
+    bool ready() const;  // The record at `head` is published
+    void acceptLoop();
+
+    std::string socketPath;
+    uint32_t slotCount;
+    uint32_t slotSize;
+    size_t slotsOffset = 0;
+    int memFd = -1;
+    int eventFd = -1;
+    int listenFd = -1;
+    ShmRingHeader* header = nullptr;
+    size_t mappedSize = 0;
+    uint64_t head = 0;  // Next position to consume, only the draining thread touches it
+    std::atomic<bool> running{false};
+    std::thread acceptThread;
+};
+
+#endif // SHMINBOX_H
@@ -0,0 +1,190 @@
+#ifndef SHMRING_H
+#define SHMRING_H
+
+// Shared-memory message ring (--shm-ring): the memory layout and the producer side.
+// Header-only and independent of the rest of the client, a local service includes just this
+// file:
+//
+//     ShmRingProducer ring;
+//     if (!ring.attach("/tmp/ipk25.ring")) ...;
+//     ring.post("Build 1234 passed");             // A chat message, sent as it is
+//     ring.post("/join builds", SHM_RECORD_LINE);  // Handled like a typed line
+//
+// The client creates the ring in a memfd and hands the memfd and its eventfd to every process
+// that connects to the Unix socket. Records are fixed-size slots of a bounded multi-producer
+// queue (per-slot sequence numbers, one CAS per post), so a message costs one copy into shared
+// memory and no system call while the client is busy draining; the eventfd is written only when
+// the client sleeps.
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <sched.h>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+constexpr uint32_t SHM_RING_MAGIC = 0x49504b52;  // "IPKR"
+constexpr uint32_t SHM_RING_VERSION = 1;
+
+// Record flags
+constexpr uint32_t SHM_RECORD_CHAT = 0;  // Chat message, never parsed as a command
+constexpr uint32_t SHM_RECORD_LINE = 1;  // Input line: /commands work like on stdin
+
+// At the start of the memfd, the slots follow at `slotsOffset`
+struct ShmRingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotCount;  // Power of two
+    uint32_t slotSize;   // Bytes per slot including ShmRingSlot
+    uint64_t slotsOffset;
+    alignas(64) std::atomic<uint64_t> tail;      // Next position a producer claims
+    alignas(64) std::atomic<uint32_t> sleeping;  // The consumer waits on the eventfd
+};
+
+// Slot `pos % slotCount` is free for position `pos` while sequence == pos and holds its record
+// once sequence == pos + 1; the consumer frees it for the next lap with pos + slotCount.
+struct ShmRingSlot {
+    std::atomic<uint64_t> sequence;
+    uint32_t length;
+    uint32_t flags;
+    // `length` bytes of text follow
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the ring needs address-free atomics");
+
+inline ShmRingSlot* shmRingSlot(ShmRingHeader* header, uint64_t pos) {
+    char* base = reinterpret_cast<char*>(header) + header->slotsOffset;
+    return reinterpret_cast<ShmRingSlot*>(base + (pos & (header->slotCount - 1)) * header->slotSize);
+}
+
+class ShmRingProducer {
+public:
+    enum class Status { OK, FULL, TOO_LONG, DETACHED };
+
+    ShmRingProducer() = default;
+    ~ShmRingProducer() { detach(); }
+
+    ShmRingProducer(const ShmRingProducer&) = delete;
+    ShmRingProducer& operator=(const ShmRingProducer&) = delete;
+
+    // Connects to the client's socket and maps the ring it hands over
+    bool attach(const char* socketPath) {
+        detach();
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (std::strlen(socketPath) >= sizeof(addr.sun_path)) return false;
+        std::strncpy(addr.sun_path, socketPath, sizeof(addr.sun_path) - 1);
+        int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (sock < 0) return false;
+        int fds[2] = {-1, -1};
+        bool received = connect(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0 && receiveFds(sock, fds);
+        ::close(sock);
+        if (!received) return false;
+
+        struct stat info {};
+        if (fstat(fds[0], &info) == 0 && static_cast<size_t>(info.st_size) >= sizeof(ShmRingHeader)) {
+            void* memory = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+            if (memory != MAP_FAILED) {
+                header = static_cast<ShmRingHeader*>(memory);
+                mappedSize = static_cast<size_t>(info.st_size);
+            }
+        }
+        ::close(fds[0]);
+        eventFd = fds[1];
+        if (header == nullptr || header->magic != SHM_RING_MAGIC || header->version != SHM_RING_VERSION ||
+            header->slotCount == 0 || (header->slotCount & (header->slotCount - 1)) != 0 ||
+            header->slotSize <= sizeof(ShmRingSlot) ||
+            header->slotsOffset + static_cast<uint64_t>(header->slotCount) * header->slotSize > mappedSize) {
+            detach();
+            return false;
+        }
+        return true;
+    }
+
+    void detach() {
+        if (header != nullptr) munmap(header, mappedSize);
+        if (eventFd >= 0) ::close(eventFd);
+        header = nullptr;
+        eventFd = -1;
+    }
+
+    // Longest text a record holds
+    size_t capacity() const { return header ? header->slotSize - sizeof(ShmRingSlot) : 0; }
+
+    // Posts one record without waiting, FULL while the client is behind
+    Status tryPost(std::string_view text, uint32_t flags = SHM_RECORD_CHAT) {
+        if (header == nullptr) return Status::DETACHED;
+        if (text.size() > capacity()) return Status::TOO_LONG;
+        uint64_t pos = header->tail.load(std::memory_order_relaxed);
+        ShmRingSlot* slot;
+        while (true) {
+            slot = shmRingSlot(header, pos);
+            uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+            int64_t lag = static_cast<int64_t>(sequence - pos);
+            if (lag == 0) {
+                if (header->tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (lag < 0) {
+                return Status::FULL;  // The consumer has not freed this slot of the last lap
+            } else {
+                pos = header->tail.load(std::memory_order_relaxed);  // Another producer took it
+            }
+        }
+        slot->length = static_cast<uint32_t>(text.size());
+        slot->flags = flags;
+        std::memcpy(reinterpret_cast<char*>(slot + 1), text.data(), text.size());
+        slot->sequence.store(pos + 1, std::memory_order_release);
+
+        // Pairs with the consumer's fence between setting `sleeping` and checking the ring
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (header->sleeping.load(std::memory_order_relaxed) != 0 && header->sleeping.exchange(0) != 0) {
+            uint64_t one = 1;
+            ssize_t ignored = ::write(eventFd, &one, sizeof(one));
+            (void)ignored;
+        }
+        return Status::OK;
+    }
+
+    // Posts one record, yielding while the ring is full for at most `timeout`
+    Status post(std::string_view text, uint32_t flags = SHM_RECORD_CHAT,
+                std::chrono::milliseconds timeout = std::chrono::milliseconds(1000)) {
+        Status status = tryPost(text, flags);
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (status == Status::FULL && std::chrono::steady_clock::now() < deadline) {
+            sched_yield();
+            status = tryPost(text, flags);
+        }
+        return status;
+    }
+
+private:
+    // The client sends one byte with the memfd and the eventfd attached
+    static bool receiveFds(int sock, int fds[2]) {
+        char byte;
+        iovec data{&byte, 1};
+        alignas(cmsghdr) char control[CMSG_SPACE(2 * sizeof(int))];
+        msghdr message{};
+        message.msg_iov = &data;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        if (recvmsg(sock, &message, MSG_CMSG_CLOEXEC) != 1) return false;
+        cmsghdr* header = CMSG_FIRSTHDR(&message);
+        if (header == nullptr || header->cmsg_type != SCM_RIGHTS || header->cmsg_len != CMSG_LEN(2 * sizeof(int))) {
+            return false;
+        }
+        std::memcpy(fds, CMSG_DATA(header), 2 * sizeof(int));
+        return true;
+    }
+
+    ShmRingHeader* header = nullptr;
+    size_t mappedSize = 0;
+    int eventFd = -1;
+};
+
+#endif // SHMRING_H
@@ -0,0 +1,122 @@
+#include "Shutdown.h"
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
+
+int ShutdownSignals::signalFd = -1;
+
+bool ShutdownSignals::install() {
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGTERM);
+    if (pthread_sigmask(SIG_BLOCK, &set, nullptr) != 0) {
+        perror("pthread_sigmask");
+        return false;
+    }
+    signalFd = signalfd(-1, &set, SFD_CLOEXEC | SFD_NONBLOCK);
+    if (signalFd == -1) {
+        perror("signalfd");
+        return false;
+    }
+    return true;
+}
+
+int ShutdownSignals::read() {
+    signalfd_siginfo info;
+    if (signalFd == -1 || ::read(signalFd, &info, sizeof(info)) != sizeof(info)) return 0;
+    return static_cast<int>(info.ssi_signo);
+}
+
+bool ShutdownSignals::pending() {
+    if (signalFd == -1) return false;
+    pollfd pfd{signalFd, POLLIN, 0};
+    return poll(&pfd, 1, 0) > 0;
+}
+
+Wakeup::Wakeup() : eventFd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) {
+    if (eventFd == -1) perror("eventfd");
+}
+
+Wakeup::~Wakeup() {
+    if (eventFd != -1) close(eventFd);
+}
+
+// The counter is never read back, so the descriptor stays readable for every poller
+void Wakeup::notify() {
+    uint64_t one = 1;
+    if (write(eventFd, &one, sizeof(one)) == -1 && errno != EAGAIN) perror("eventfd write");
+}
+
+void Wakeup::reset() {
+    uint64_t count;
+    if (read(eventFd, &count, sizeof(count)) == -1 && errno != EAGAIN) perror("eventfd read");
+}
+
+bool Wakeup::notified() const {
+    return waitFor(std::chrono::milliseconds(0));
+}
+
+bool Wakeup::waitFor(std::chrono::milliseconds timeout) const {
+    pollfd pfd{eventFd, POLLIN, 0};
+    int rc;
+    do {
+        rc = poll(&pfd, 1, static_cast<int>(timeout.count()));
+    } while (rc == -1 && errno == EINTR);
+    return rc > 0;
+}
+
+InputLoop::Event InputLoop::next(std::string& line) {
+    while (true) {
+        // A complete line is already buffered
+        size_t newline = pending.find('\n');
+        if (newline != std::string::npos) {
+            line.assign(pending, 0, newline);  // Reuses the capacity of `line`
+            pending.erase(0, newline + 1);
+            return Event::LINE;
+        }
+        if (endOfInput) {
+            if (pending.empty()) return Event::END_OF_INPUT;
+            line.swap(pending);  // Last line without a newline
+            pending.clear();
+            return Event::LINE;
+        }
+
+        pollfd fds[5] = {
+            {wakeup.fd(), POLLIN, 0},
+            {ShutdownSignals::fd(), POLLIN, 0},
+            {inputFd, POLLIN, 0},
+            {ready ? ready->fd() : -1, POLLIN, 0},  // Negative descriptors are ignored by poll()
+            {sourceFd, POLLIN, 0},
+        };
+        if (poll(fds, 5, -1) == -1) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            return Event::END_OF_INPUT;
+        }
+        if (fds[0].revents & POLLIN) return Event::WAKEUP;
+        if (fds[3].revents & POLLIN) {
+            ready->reset();
+            return Event::READY;
+        }
+        if (fds[1].revents & POLLIN) {
+            signal = ShutdownSignals::read();
+            if (signal != 0) return Event::SIGNAL;
+        }
+        if (fds[2].revents & (POLLIN | POLLHUP | POLLERR)) {
+            char buffer[4096];
+            ssize_t n = ::read(inputFd, buffer, sizeof(buffer));
+            if (n > 0) {
+                pending.append(buffer, static_cast<size_t>(n));
+            } else if (n == 0 || errno != EINTR) {
+                endOfInput = true;
+            }
+        }
+        // After reading stdin, so a busy source cannot starve it; the lines read are returned next
+        if (fds[4].revents & POLLIN) return Event::SOURCE;
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef SHUTDOWN_H
+#define SHUTDOWN_H
+
+#include <chrono>
+#include <string>
+#include <unistd.h>
+
+// Termination signals (SIGINT, SIGTERM) are blocked and read from a signalfd, so the clients
+// handle them in their poll loop instead of inside an asynchronous signal handler.
+class ShutdownSignals {
+public:
+    // Blocks the signals in the calling thread and opens the signalfd.
+    // Threads created afterwards inherit the blocked mask.
+    static bool install();
+
+    // The signalfd descriptor, -1 if install() was not called
+    static int fd() { return signalFd; }
+
+    // Reads one pending signal, returns its number or 0 if there was none
+    static int read();
+
+    // True if a signal is waiting, without consuming it (long operations use it to bail out
+    // and let the input loop handle the signal)
+    static bool pending();
+
+private:
+    static int signalFd;
+};
+
+// eventfd that stays readable once notified. Threads blocked in poll() watch it as well,
+// so a stopping client can wake them without closing their sockets under them.
+class Wakeup {
+public:
+    Wakeup();
+    ~Wakeup();
+
+    Wakeup(const Wakeup&) = delete;
+    Wakeup& operator=(const Wakeup&) = delete;
+
+    int fd() const { return eventFd; }
+
+    void notify();
+    bool notified() const;
+
+    // Clears the notification, for wakeups that are used more than once (not the shutdown one)
+    void reset();
+
+    // Sleeps for the given time unless notified earlier, returns true if notified
+    bool waitFor(std::chrono::milliseconds timeout) const;
+
+private:
+    int eventFd;
+};
+
+// Reads user input lines from stdin (or another descriptor, e.g. a --batch script) while also
+// watching the termination signals and a wakeup. The input is read with read(2) into an own
+// buffer, std::getline on std::cin would hide already buffered lines from poll().
+// The optional `ready` wakeup reports work for the input thread (READY) and is reset by next().
+// The optional `sourceFd` is another input source (the --shm-ring eventfd): SOURCE means it is
+// readable, its owner consumes it. Without stdin (inputFd -1) there is no END_OF_INPUT.
+class InputLoop {
+public:
+    enum class Event { LINE, END_OF_INPUT, SIGNAL, WAKEUP, READY, SOURCE };
+
+    explicit InputLoop(const Wakeup& wakeup, int inputFd = STDIN_FILENO, Wakeup* ready = nullptr, int sourceFd = -1)
+        : wakeup(wakeup), inputFd(inputFd), ready(ready), sourceFd(sourceFd) {}
+
+    // Blocks until one of the events happens, a LINE is stored in `line` (without the newline)
+    Event next(std::string& line);
+
+    // Number of the signal reported by the last SIGNAL event
+    int lastSignal() const { return signal; }
+
+private:
+    const Wakeup& wakeup;
+    int inputFd;
+    Wakeup* ready;
+    int sourceFd;
+    std::string pending;
+    bool endOfInput = false;
+    int signal = 0;
+};
+
+#endif // SHUTDOWN_H
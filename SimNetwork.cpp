@@ -0,0 +1,167 @@
+#include "SimNetwork.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+
+// Datagram socket endpoint of the simulated network
+class SimDatagramSocket : public DatagramSocket {
+public:
+    SimDatagramSocket(SimNetwork& network, int endpoint) : network(network), endpoint(endpoint) {}
+
+    ssize_t sendTo(const void* data, size_t length, const sockaddr_in& to) override {
+        network.sendDatagram(endpoint, ntohs(to.sin_port), data, length);
+        return static_cast<ssize_t>(length);
+    }
+
+    ssize_t recvFrom(void* buffer, size_t capacity, sockaddr_in& from) override {
+        network.deliverDue();
+        auto& inbox = network.endpoints[endpoint].inbox;
+        if (inbox.empty()) {
+            errno = EAGAIN;
+            return -1;
+        }
+        SimNetwork::Packet packet = std::move(inbox.front());
+        inbox.pop_front();
+        from = SimNetwork::address(packet.fromPort);
+        size_t length = std::min(capacity, packet.data.size());  // Datagrams are truncated like recvfrom()
+        std::memcpy(buffer, packet.data.data(), length);
+        return static_cast<ssize_t>(length);
+    }
+
+    int fd() const override { return -1; }
+
+private:
+    SimNetwork& network;
+    int endpoint;
+};
+
+// Stream socket endpoint of the simulated network
+class SimStreamSocket : public StreamSocket {
+public:
+    SimStreamSocket(SimNetwork& network, int endpoint) : network(network), endpoint(endpoint) {}
+
+    ssize_t send(const void* data, size_t length) override {
+        network.sendStream(endpoint, data, length);
+        return static_cast<ssize_t>(length);
+    }
+
+    ssize_t read(void* buffer, size_t capacity) override {
+        network.deliverDue();
+        auto& inbox = network.endpoints[endpoint].inbox;
+        if (inbox.empty()) {
+            errno = EAGAIN;
+            return -1;
+        }
+        // A stream read may return part of a packet, the rest stays for the next read
+        SimNetwork::Packet& packet = inbox.front();
+        size_t length = std::min(capacity, packet.data.size());
+        std::memcpy(buffer, packet.data.data(), length);
+        if (length == packet.data.size()) {
+            inbox.pop_front();
+        } else {
+            packet.data.erase(packet.data.begin(), packet.data.begin() + length);
+        }
+        return static_cast<ssize_t>(length);
+    }
+
+    int fd() const override { return -1; }
+
+private:
+    SimNetwork& network;
+    int endpoint;
+};
+
+SimNetwork::SimNetwork(VirtualClock& clock, const SimConfig& config)
+    : clock(clock), config(config), random(config.seed) {}
+
+sockaddr_in SimNetwork::address(uint16_t port) {
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    return addr;
+}
+
+int SimNetwork::addEndpoint(uint16_t port) {
+    endpoints.emplace_back();
+    endpoints.back().port = port;
+    return static_cast<int>(endpoints.size() - 1);
+}
+
+std::unique_ptr<DatagramSocket> SimNetwork::bindDatagram(uint16_t port) {
+    int endpoint = addEndpoint(port);
+    portToEndpoint[port] = endpoint;
+    return std::make_unique<SimDatagramSocket>(*this, endpoint);
+}
+
+std::pair<std::unique_ptr<StreamSocket>, std::unique_ptr<StreamSocket>> SimNetwork::connectStream() {
+    int client = addEndpoint(0);
+    int server = addEndpoint(0);
+    endpoints[client].peer = server;
+    endpoints[server].peer = client;
+    return {std::make_unique<SimStreamSocket>(*this, client), std::make_unique<SimStreamSocket>(*this, server)};
+}
+
+void SimNetwork::setDropRule(SimDropRule rule) {
+    dropRule = std::move(rule);
+}
+
+bool SimNetwork::nextDelivery(Clock::time_point& when) const {
+    if (inFlight.empty()) return false;
+    when = inFlight.top().deliverAt;
+    return true;
+}
+
+Clock::time_point SimNetwork::randomDeliveryTime() {
+    auto delay = std::chrono::duration_cast<std::chrono::steady_clock::duration>(config.baseDelay);
+    if (config.jitter.count() > 0) {
+        std::uniform_int_distribution<int64_t> extra(0, config.jitter.count());
+        delay += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::microseconds(extra(random)));
+    }
+    return clock.now() + delay;
+}
+
+void SimNetwork::sendDatagram(int from, uint16_t toPort, const void* data, size_t length) {
+    sent++;
+    auto target = portToEndpoint.find(toPort);
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint16_t fromPort = endpoints[from].port;
+
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    if (target == portToEndpoint.end() ||
+        (dropRule && dropRule(fromPort, toPort, bytes, length)) ||
+        chance(random) < config.lossRate) {
+        dropped++;
+        return;
+    }
+
+    int copies = chance(random) < config.duplicateRate ? 2 : 1;
+    if (copies == 2) duplicated++;
+    for (int i = 0; i < copies; ++i) {
+        inFlight.push({randomDeliveryTime(), nextSequence++, target->second, fromPort,
+                       std::vector<uint8_t>(bytes, bytes + length)});
+    }
+}
+
+void SimNetwork::sendStream(int from, const void* data, size_t length) {
+    sent++;
+    int peer = endpoints[from].peer;
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+    // Stream data is never lost or reordered: it arrives no earlier than the previous chunk
+    Clock::time_point deliverAt = std::max(randomDeliveryTime(), endpoints[peer].lastStreamDelivery);
+    endpoints[peer].lastStreamDelivery = deliverAt;
+    inFlight.push({deliverAt, nextSequence++, peer, 0, std::vector<uint8_t>(bytes, bytes + length)});
+}
+
+// Moves every packet whose delivery time has passed into the receiver's inbox
+void SimNetwork::deliverDue() {
+    Clock::time_point now = clock.now();
+    while (!inFlight.empty() && inFlight.top().deliverAt <= now) {
+        Packet packet = inFlight.top();
+        inFlight.pop();
+        endpoints[packet.destination].inbox.push_back(std::move(packet));
+    }
+}
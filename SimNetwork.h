@@ -0,0 +1,99 @@
+#ifndef SIMNETWORK_H
+#define SIMNETWORK_H
+
+#include "Clock.h"
+#include "Socket.h"
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <queue>
+#include <random>
+#include <utility>
+#include <vector>
+
+// Impairments applied by the simulated network. All randomness comes from `seed`,
+// so a simulation with the same configuration and inputs always behaves the same.
+struct SimConfig {
+    uint64_t seed = 1;
+    double lossRate = 0.0;                          // Probability that a datagram is dropped
+    double duplicateRate = 0.0;                     // Probability that a datagram is delivered twice
+    std::chrono::microseconds baseDelay{500};       // One-way delay of every packet
+    std::chrono::microseconds jitter{0};            // Uniform extra delay, reorders datagrams
+};
+
+// Scripted loss rule: returns true if the datagram sent from `fromPort` to `toPort` must be dropped
+using SimDropRule = std::function<bool(uint16_t fromPort, uint16_t toPort, const uint8_t* data, size_t length)>;
+
+// In-memory network driven by a VirtualClock.
+// Datagram sockets are identified by their port on 127.0.0.1; stream sockets come in connected pairs.
+// Sending never blocks, receiving returns -1/EAGAIN until a packet's delivery time has been reached.
+class SimNetwork {
+public:
+    SimNetwork(VirtualClock& clock, const SimConfig& config);
+
+    // Creates a datagram socket bound to the given port
+    std::unique_ptr<DatagramSocket> bindDatagram(uint16_t port);
+
+    // Creates two connected stream sockets (client side first). Streams are delayed but lossless and ordered.
+    std::pair<std::unique_ptr<StreamSocket>, std::unique_ptr<StreamSocket>> connectStream();
+
+    // Installs a scripted loss rule checked before the random loss
+    void setDropRule(SimDropRule rule);
+
+    // Returns the delivery time of the next packet in flight, false if the network is idle
+    bool nextDelivery(Clock::time_point& when) const;
+
+    // Returns the address a datagram socket bound to `port` is reachable at
+    static sockaddr_in address(uint16_t port);
+
+    uint64_t packetsSent() const { return sent; }
+    uint64_t packetsDropped() const { return dropped; }
+    uint64_t packetsDuplicated() const { return duplicated; }
+
+private:
+    friend class SimDatagramSocket;
+    friend class SimStreamSocket;
+
+    struct Packet {
+        Clock::time_point deliverAt;
+        uint64_t sequence;          // Tie-breaker that keeps equal delivery times in send order
+        int destination;            // Index into endpoints
+        uint16_t fromPort;
+        std::vector<uint8_t> data;
+    };
+
+    struct LaterFirst {
+        bool operator()(const Packet& a, const Packet& b) const {
+            return a.deliverAt != b.deliverAt ? a.deliverAt > b.deliverAt : a.sequence > b.sequence;
+        }
+    };
+
+    struct Endpoint {
+        uint16_t port = 0;
+        int peer = -1;                          // Connected peer of a stream endpoint
+        Clock::time_point lastStreamDelivery;   // Keeps stream data in order
+        std::deque<Packet> inbox;
+    };
+
+    VirtualClock& clock;
+    SimConfig config;
+    std::mt19937_64 random;
+    SimDropRule dropRule;
+    std::vector<Endpoint> endpoints;
+    std::map<uint16_t, int> portToEndpoint;
+    std::priority_queue<Packet, std::vector<Packet>, LaterFirst> inFlight;
+    uint64_t nextSequence = 0;
+    uint64_t sent = 0;
+    uint64_t dropped = 0;
+    uint64_t duplicated = 0;
+
+    int addEndpoint(uint16_t port);
+    void sendDatagram(int from, uint16_t toPort, const void* data, size_t length);
+    void sendStream(int from, const void* data, size_t length);
+    void deliverDue();
+    Clock::time_point randomDeliveryTime();
+};
+
+#endif // SIMNETWORK_H
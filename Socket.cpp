@@ -0,0 +1,62 @@
+#include "Socket.h"
+#include "debug.h"
+#include <arpa/inet.h>
+#include <cstdio>
+#include <cstring>
+#include <sys/socket.h>
+#include <unistd.h>
+
+PosixDatagramSocket::PosixDatagramSocket(int sockfd) : sockfd(sockfd) {}
+
+PosixDatagramSocket::~PosixDatagramSocket() {
+    if (sockfd != -1) close(sockfd);
+}
+
+std::unique_ptr<PosixDatagramSocket> PosixDatagramSocket::bindAny() {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);  // Create the UDP socket
+    if (fd < 0) {
+        perror("ERROR: Unable to create UDP socket");
+        return nullptr;
+    }
+
+    struct sockaddr_in localAddr;
+    std::memset(&localAddr, 0, sizeof(localAddr));
+    localAddr.sin_family = AF_INET;          // IPv4 address family
+    localAddr.sin_addr.s_addr = INADDR_ANY;  // Accept messages from any address
+    localAddr.sin_port = htons(0);           // Bind to an available port
+
+    if (bind(fd, (struct sockaddr*)&localAddr, sizeof(localAddr)) < 0) {
+        perror("ERROR: Bind failed");
+        close(fd);
+        return nullptr;
+    }
+
+    socklen_t len = sizeof(localAddr);
+    if (getsockname(fd, (struct sockaddr*)&localAddr, &len) == 0) {
+        printf_debug("UDP client is using local port: %d", ntohs(localAddr.sin_port));
+    }
+    return std::unique_ptr<PosixDatagramSocket>(new PosixDatagramSocket(fd));
+}
+
+ssize_t PosixDatagramSocket::sendTo(const void* data, size_t length, const sockaddr_in& to) {
+    return sendto(sockfd, data, length, 0, (const struct sockaddr*)&to, sizeof(to));
+}
+
+ssize_t PosixDatagramSocket::recvFrom(void* buffer, size_t capacity, sockaddr_in& from) {
+    socklen_t addrLen = sizeof(from);
+    return recvfrom(sockfd, buffer, capacity, receiveFlags, (struct sockaddr*)&from, &addrLen);
+}
+
+PosixStreamSocket::PosixStreamSocket(int sockfd) : sockfd(sockfd) {}
+
+PosixStreamSocket::~PosixStreamSocket() {
+    if (sockfd != -1) close(sockfd);
+}
+
+ssize_t PosixStreamSocket::send(const void* data, size_t length) {
+    return ::send(sockfd, data, length, MSG_NOSIGNAL);
+}
+
+ssize_t PosixStreamSocket::read(void* buffer, size_t capacity) {
+    return ::recv(sockfd, buffer, capacity, receiveFlags);
+}
@@ -0,0 +1,77 @@
+#ifndef SOCKET_H
+#define SOCKET_H
+
+#include <cstddef>
+#include <memory>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+// Datagram socket used by UdpChatClient. Implemented by real sockets and by SimNetwork.
+// recvFrom() returns -1 with errno EAGAIN when a non-blocking socket has nothing to read.
+class DatagramSocket {
+public:
+    virtual ~DatagramSocket() {}
+
+    virtual ssize_t sendTo(const void* data, size_t length, const sockaddr_in& to) = 0;
+    virtual ssize_t recvFrom(void* buffer, size_t capacity, sockaddr_in& from) = 0;
+
+    // Underlying file descriptor, -1 for simulated sockets
+    virtual int fd() const = 0;
+
+    // Makes recvFrom() return EAGAIN instead of blocking, sends keep blocking
+    // (simulated sockets never block)
+    virtual void setNonBlockingReceive() {}
+};
+
+// Byte stream socket used by TcpChatClient. Same conventions as DatagramSocket.
+class StreamSocket {
+public:
+    virtual ~StreamSocket() {}
+
+    virtual ssize_t send(const void* data, size_t length) = 0;
+    virtual ssize_t read(void* buffer, size_t capacity) = 0;
+
+    // Underlying file descriptor, -1 for simulated sockets
+    virtual int fd() const = 0;
+
+    // Makes read() return EAGAIN instead of blocking, sends keep blocking
+    virtual void setNonBlockingReceive() {}
+};
+
+// UDP socket bound to an ephemeral local port
+class PosixDatagramSocket : public DatagramSocket {
+public:
+    ~PosixDatagramSocket();
+
+    // Creates the socket and binds it to INADDR_ANY:0, returns nullptr on failure
+    static std::unique_ptr<PosixDatagramSocket> bindAny();
+
+    ssize_t sendTo(const void* data, size_t length, const sockaddr_in& to) override;
+    ssize_t recvFrom(void* buffer, size_t capacity, sockaddr_in& from) override;
+    int fd() const override { return sockfd; }
+    void setNonBlockingReceive() override { receiveFlags = MSG_DONTWAIT; }
+
+private:
+    explicit PosixDatagramSocket(int sockfd);
+    int sockfd;
+    int receiveFlags = 0;
+};
+
+// Connected TCP socket, takes ownership of the descriptor
+class PosixStreamSocket : public StreamSocket {
+public:
+    explicit PosixStreamSocket(int sockfd);
+    ~PosixStreamSocket();
+
+    ssize_t send(const void* data, size_t length) override;
+    ssize_t read(void* buffer, size_t capacity) override;
+    int fd() const override { return sockfd; }
+    void setNonBlockingReceive() override { receiveFlags = MSG_DONTWAIT; }
+
+private:
+    int sockfd;
+    int receiveFlags = 0;
+};
+
+#endif // SOCKET_H
@@ -0,0 +1,107 @@
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread.
+// The capacity is rounded up to a power of two. Head and tail live on separate cache lines
+// and each side keeps a cached copy of the other side's index, so in steady state a push or
+// pop touches no cache line written by the other thread.
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity) : slots(roundUp(capacity)), mask(slots.size() - 1) {}
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Producer only. Returns false (and leaves `value` untouched) when the ring is full.
+    bool tryPush(T&& value) {
+        size_t tail = tailIndex.load(std::memory_order_relaxed);
+        if (tail - cachedHead == slots.size()) {
+            cachedHead = headIndex.load(std::memory_order_acquire);
+            if (tail - cachedHead == slots.size()) return false;
+        }
+        slots[tail & mask] = std::move(value);
+        tailIndex.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only. Returns false when the ring is empty.
+    bool tryPop(T& value) {
+        size_t head = headIndex.load(std::memory_order_relaxed);
+        if (head == cachedTail) {
+            cachedTail = tailIndex.load(std::memory_order_acquire);
+            if (head == cachedTail) return false;
+        }
+        value = std::move(slots[head & mask]);
+        headIndex.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate, safe to call from any thread
+    bool empty() const {
+        return headIndex.load(std::memory_order_acquire) == tailIndex.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const { return slots.size(); }
+
+private:
+    static size_t roundUp(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        return size;
+    }
+
+    std::vector<T> slots;
+    const size_t mask;
+    alignas(64) std::atomic<size_t> headIndex{0};  // Written by the consumer
+    size_t cachedTail = 0;                          // Consumer's copy of tailIndex
+    alignas(64) std::atomic<size_t> tailIndex{0};  // Written by the producer
+    size_t cachedHead = 0;                          // Producer's copy of headIndex
+};
+
+// Lets the consumer of an SpscRing sleep when there is nothing to do. The consumer spins
+// briefly before sleeping; the producer only takes the lock when the consumer is asleep,
+// so a busy pipeline never touches the mutex.
+class Doorbell {
+public:
+    // Consumer: returns once `ready()` is true or after `timeout`
+    template <typename Ready>
+    void wait(Ready ready, std::chrono::milliseconds timeout) {
+        for (int i = 0; i < SPIN_LIMIT; ++i) {
+            if (ready()) return;
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#endif
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        sleeping.store(true, std::memory_order_relaxed);
+        // Pairs with the fence in ring(): either the producer sees `sleeping` or we see its data
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        cv.wait_for(lock, timeout, ready);
+        sleeping.store(false, std::memory_order_relaxed);
+    }
+
+    // Producer: call after publishing new data
+    void ring() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(mutex);
+            cv.notify_one();
+        }
+    }
+
+private:
+    static constexpr int SPIN_LIMIT = 2000;
+    std::atomic<bool> sleeping{false};
+    std::mutex mutex;
+    std::condition_variable cv;
+};
+
+#endif // SPSCRING_H
@@ -0,0 +1,185 @@
+#include "Stats.h"
+#include <algorithm>
+#include <cctype>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+// Names of StatKind values used as the "type" label
+const char* const KIND_NAMES[STAT_KIND_COUNT] = {
+    "CONFIRM", "REPLY", "AUTH", "JOIN", "MSG", "PING", "ERR", "BYE", "UNKNOWN"
+};
+
+struct Gauge {
+    int id;
+    std::string name;
+    std::string help;
+    std::function<int64_t()> read;
+};
+
+// All counter blocks ever created and the registered gauges.
+// Blocks are never freed so a snapshot can still read counters of finished threads.
+struct Registry {
+    std::mutex mutex;
+    std::vector<ThreadCounters*> threads;
+    std::vector<Gauge> gauges;
+    int nextGaugeId = 0;
+};
+
+Registry& registry() {
+    static Registry* instance = new Registry();
+    return *instance;
+}
+
+ThreadCounters* createThreadCounters() {
+    ThreadCounters* counters = new ThreadCounters();
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.threads.push_back(counters);
+    return counters;
+}
+
+// Sums one counter over all thread blocks
+template <typename Getter>
+uint64_t sumCounters(const std::vector<ThreadCounters*>& threads, Getter get) {
+    uint64_t total = 0;
+    for (const ThreadCounters* counters : threads) {
+        total += get(*counters).load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void writeHeader(std::ostringstream& out, const char* name, const char* help, const char* type) {
+    out << "# HELP " << name << " " << help << "\n";
+    out << "# TYPE " << name << " " << type << "\n";
+}
+
+} // namespace
+
+ThreadCounters& threadCounters() {
+    thread_local ThreadCounters* counters = createThreadCounters();
+    return *counters;
+}
+
+void statMessageSent(StatKind kind, size_t bytes) {
+    ThreadCounters& counters = threadCounters();
+    size_t index = static_cast<size_t>(kind);
+    statAdd(counters.messagesSent[index]);
+    statAdd(counters.bytesSent[index], bytes);
+    if (kind == StatKind::CONFIRM) {
+        statAdd(counters.confirmsSent);
+    }
+}
+
+void statMessageReceived(StatKind kind, size_t bytes) {
+    ThreadCounters& counters = threadCounters();
+    size_t index = static_cast<size_t>(kind);
+    statAdd(counters.messagesReceived[index]);
+    statAdd(counters.bytesReceived[index], bytes);
+}
+
+StatKind statKindFromUdpType(uint8_t type) {
+    switch (type) {
+        case 0x00: return StatKind::CONFIRM;
+        case 0x01: return StatKind::REPLY;
+        case 0x02: return StatKind::AUTH;
+        case 0x03: return StatKind::JOIN;
+        case 0x04: return StatKind::MSG;
+        case 0xFD: return StatKind::PING;
+        case 0xFE: return StatKind::ERR;
+        case 0xFF: return StatKind::BYE;
+        default:   return StatKind::UNKNOWN;
+    }
+}
+
+StatKind statKindFromTcpLine(std::string_view line) {
+    // Compare the first word case-insensitively without building a copy of the line
+    auto startsWith = [&line](const char* word) {
+        size_t i = 0;
+        for (; word[i] != '\0'; ++i) {
+            if (i >= line.size() || std::toupper(static_cast<unsigned char>(line[i])) != word[i]) return false;
+        }
+        return i == line.size() || line[i] == ' ' || line[i] == '\r';
+    };
+    if (startsWith("MSG")) return StatKind::MSG;
+    if (startsWith("REPLY")) return StatKind::REPLY;
+    if (startsWith("AUTH")) return StatKind::AUTH;
+    if (startsWith("JOIN")) return StatKind::JOIN;
+    if (startsWith("ERR")) return StatKind::ERR;
+    if (startsWith("BYE")) return StatKind::BYE;
+    return StatKind::UNKNOWN;
+}
+
+int registerStatGauge(const std::string& name, const std::string& help, std::function<int64_t()> read) {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    int id = reg.nextGaugeId++;
+    reg.gauges.push_back({id, name, help, std::move(read)});
+    return id;
+}
+
+void unregisterStatGauge(int id) {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.gauges.erase(std::remove_if(reg.gauges.begin(), reg.gauges.end(),
+                                    [id](const Gauge& gauge) { return gauge.id == id; }),
+                     reg.gauges.end());
+}
+
+std::string renderStatsPrometheus() {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    const std::vector<ThreadCounters*>& threads = reg.threads;
+    std::ostringstream out;
+
+    // Per-type counters
+    struct PerKind {
+        const char* name;
+        const char* help;
+        std::atomic<uint64_t> (ThreadCounters::*field)[STAT_KIND_COUNT];
+    };
+    const PerKind perKind[] = {
+        {"ipk25_messages_sent_total", "Messages sent per type.", &ThreadCounters::messagesSent},
+        {"ipk25_bytes_sent_total", "Bytes sent per message type.", &ThreadCounters::bytesSent},
+        {"ipk25_messages_received_total", "Messages received per type.", &ThreadCounters::messagesReceived},
+        {"ipk25_bytes_received_total", "Bytes received per message type.", &ThreadCounters::bytesReceived},
+    };
+    for (const PerKind& metric : perKind) {
+        writeHeader(out, metric.name, metric.help, "counter");
+        for (size_t kind = 0; kind < STAT_KIND_COUNT; ++kind) {
+            uint64_t value = sumCounters(threads, [&](const ThreadCounters& c) -> const std::atomic<uint64_t>& {
+                return (c.*metric.field)[kind];
+            });
+            out << metric.name << "{type=\"" << KIND_NAMES[kind] << "\"} " << value << "\n";
+        }
+    }
+
+    // Plain counters
+    struct Single {
+        const char* name;
+        const char* help;
+        std::atomic<uint64_t> ThreadCounters::*field;
+    };
+    const Single singles[] = {
+        {"ipk25_confirms_sent_total", "CONFIRM messages sent.", &ThreadCounters::confirmsSent},
+        {"ipk25_retransmissions_total", "UDP retransmissions.", &ThreadCounters::retransmissions},
+        {"ipk25_duplicates_dropped_total", "Duplicate messages dropped.", &ThreadCounters::duplicatesDropped},
+        {"ipk25_receive_errors_total", "Socket receive errors.", &ThreadCounters::receiveErrors},
+    };
+    for (const Single& metric : singles) {
+        writeHeader(out, metric.name, metric.help, "counter");
+        uint64_t value = sumCounters(threads, [&](const ThreadCounters& c) -> const std::atomic<uint64_t>& {
+            return c.*metric.field;
+        });
+        out << metric.name << " " << value << "\n";
+    }
+
+    // Gauges registered by the clients
+    for (const Gauge& gauge : reg.gauges) {
+        writeHeader(out, gauge.name.c_str(), gauge.help.c_str(), "gauge");
+        out << gauge.name << " " << gauge.read() << "\n";
+    }
+    return out.str();
+}
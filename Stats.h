@@ -0,0 +1,56 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+// Message kinds counted by the statistics (shared by the TCP and UDP variant)
+enum class StatKind : uint8_t { CONFIRM, REPLY, AUTH, JOIN, MSG, PING, ERR, BYE, UNKNOWN, COUNT };
+
+constexpr size_t STAT_KIND_COUNT = static_cast<size_t>(StatKind::COUNT);
+
+// Counters owned by one thread. Every block is aligned to its own cache lines so that
+// threads never write to a shared line; only the owning thread writes, readers just load.
+struct alignas(64) ThreadCounters {
+    std::atomic<uint64_t> messagesSent[STAT_KIND_COUNT];
+    std::atomic<uint64_t> bytesSent[STAT_KIND_COUNT];
+    std::atomic<uint64_t> messagesReceived[STAT_KIND_COUNT];
+    std::atomic<uint64_t> bytesReceived[STAT_KIND_COUNT];
+    std::atomic<uint64_t> confirmsSent;
+    std::atomic<uint64_t> retransmissions;
+    std::atomic<uint64_t> duplicatesDropped;
+    std::atomic<uint64_t> receiveErrors;
+};
+
+// Returns the counter block of the calling thread (registered on first use)
+ThreadCounters& threadCounters();
+
+// Increments a counter owned by the calling thread. There is a single writer per block,
+// so a relaxed load + store is enough and avoids a locked read-modify-write.
+inline void statAdd(std::atomic<uint64_t>& counter, uint64_t value = 1) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+// Records one sent or received message of the given kind and size
+void statMessageSent(StatKind kind, size_t bytes);
+void statMessageReceived(StatKind kind, size_t bytes);
+
+// Maps the first byte of a UDP datagram to a statistics kind
+StatKind statKindFromUdpType(uint8_t type);
+
+// Maps the first word of a TCP line (case-insensitive) to a statistics kind
+StatKind statKindFromTcpLine(std::string_view line);
+
+// Registers a gauge that is evaluated every time a snapshot is taken (e.g. queue depth).
+// Returns an id that must be passed to unregisterStatGauge() before the read callback dies.
+int registerStatGauge(const std::string& name, const std::string& help, std::function<int64_t()> read);
+void unregisterStatGauge(int id);
+
+// Writes all counters summed over threads and all gauges in Prometheus text format
+std::string renderStatsPrometheus();
+
+#endif // STATS_H
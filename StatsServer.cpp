@@ -0,0 +1,90 @@
+#include "StatsServer.h"
+#include "Stats.h"
+#include "debug.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Constructor only stores the path, the socket is created in start()
+StatsServer::StatsServer(const std::string& socketPath)
+    : socketPath(socketPath), listenFd(-1) {}
+
+StatsServer::~StatsServer() {
+    stop();
+}
+
+bool StatsServer::start() {
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "ERROR: Stats socket path is too long: " << socketPath << std::endl;
+        return false;
+    }
+    std::strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd < 0) {
+        perror("ERROR: Unable to create stats socket");
+        return false;
+    }
+
+    // Remove a stale socket left by a previous run, but never anything else at the path
+    struct stat existing;
+    if (lstat(socketPath.c_str(), &existing) == 0) {
+        if (!S_ISSOCK(existing.st_mode)) {
+            std::cerr << "ERROR: Stats socket path exists and is not a socket: " << socketPath << std::endl;
+            close(listenFd);
+            listenFd = -1;
+            return false;
+        }
+        unlink(socketPath.c_str());
+    }
+    if (bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(listenFd, 8) < 0) {
+        perror("ERROR: Unable to bind stats socket");
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+
+    running = true;
+    acceptThread = std::thread(&StatsServer::acceptLoop, this);
+    printf_debug("Stats endpoint listening on %s", socketPath.c_str());
+    return true;
+}
+
+void StatsServer::stop() {
+    if (!running.exchange(false)) return;
+    if (acceptThread.joinable()) acceptThread.join();
+    close(listenFd);
+    listenFd = -1;
+    unlink(socketPath.c_str());
+}
+
+// Waits for scrapers and answers each one with the current snapshot.
+// poll() with a short timeout lets the thread notice stop() without extra signalling.
+void StatsServer::acceptLoop() {
+    while (running) {
+        struct pollfd pfd = {listenFd, POLLIN, 0};
+        int ready = poll(&pfd, 1, 200);
+        if (ready <= 0) continue;
+
+        int clientFd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (clientFd < 0) continue;
+
+        std::string snapshot = renderStatsPrometheus();
+        size_t written = 0;
+        while (written < snapshot.size()) {
+            ssize_t n = send(clientFd, snapshot.data() + written, snapshot.size() - written, MSG_NOSIGNAL);
+            if (n <= 0) break;
+            written += static_cast<size_t>(n);
+        }
+        close(clientFd);
+    }
+}
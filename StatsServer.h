@@ -0,0 +1,31 @@
+#ifndef STATSSERVER_H
+#define STATSSERVER_H
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+// Serves a snapshot of the statistics in Prometheus text format on a local Unix domain socket.
+// Every accepted connection receives one snapshot and is closed, e.g.:
+//   socat - UNIX-CONNECT:/tmp/ipk25.sock
+class StatsServer {
+public:
+    explicit StatsServer(const std::string& socketPath);
+    ~StatsServer();
+
+    // Creates the socket and starts the background accept thread
+    bool start();
+
+    // Stops the accept thread and removes the socket file
+    void stop();
+
+private:
+    std::string socketPath;
+    int listenFd;
+    std::atomic<bool> running{false};
+    std::thread acceptThread;
+
+    void acceptLoop();
+};
+
+#endif // STATSSERVER_H
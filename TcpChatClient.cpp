@@ -1,6 +1,15 @@
 #include "TcpChatClient.h"
+#include "FileTransfer.h"
+#include "Affinity.h"
+#include "LowLatency.h"
 #include "InputHandler.h"
 #include "debug.h"
+#include "LatencyHistogram.h"
+#include "Stats.h"
+#include "WireCapture.h"
+#include "Trace.h"
+#include "SessionMemory.h"
+#include <cerrno>
 #include <iostream>
 #include <string>
 #include <cstring>       // memset
@@ -15,17 +24,33 @@
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <sstream>   // for istringstream
-#include <cstdlib>   // for std::exit
+#include <cstdlib>
 #include <algorithm>
+#include <cstring>       // strsignal
+#include <poll.h>
 
 // Constructor that initializes the server address and port
 TcpChatClient::TcpChatClient(const std::string& host, int port)
-    : server(host), port(port != 0 ? port : DEFAULT_PORT), sockfd(-1), authenticated(false) {}
+    : server(host), port(port != 0 ? port : DEFAULT_PORT), clock(Clock::system()), authenticated(false) {}
 
+// Constructor used by the simulator with an already connected socket and an injected clock
+TcpChatClient::TcpChatClient(std::unique_ptr<StreamSocket> socket, Clock& clock)
+    : port(0), socket(std::move(socket)), clock(clock), authenticated(false) {}
 
-// Destructor that closes the socket if it's open
+// Destructor, the socket is closed by its owner object
 TcpChatClient::~TcpChatClient() {
-    if (sockfd != -1) close(sockfd);
+    unregisterStatGauge(rttGaugeId);
+}
+
+void TcpChatClient::setLiveness(const LivenessPolicy& policy) {
+    livenessPolicy = policy;
+    if (policy.enabled && rttGaugeId < 0) {
+        rttGaugeId = registerStatGauge("ipk25_server_rtt_us", "Smoothed round-trip time to the server in microseconds.",
+                                       [this]() {
+                                           std::lock_guard<std::mutex> lock(socketMutex);
+                                           return static_cast<int64_t>(socket ? tcpKernelRtt(socket->fd()).count() : 0);
+                                       });
+    }
 }
 
 // The connectToServer function is based on the example code “Simple Stream Client” from Beej’s Guide to Network Programming, section 6.2.
@@ -41,6 +66,7 @@ TcpChatClient::~TcpChatClient() {
 bool TcpChatClient::connectToServer() {
     struct addrinfo hints{}, *servinfo, *p;
     int rv;
+    int sockfd = -1;
 
     // Initialize the hints structure for getaddrinfo
     memset(&hints, 0, sizeof hints);
@@ -55,7 +81,7 @@ bool TcpChatClient::connectToServer() {
 
     // Loop through all the results and connect to the first available one
     for (p = servinfo; p != nullptr; p = p->ai_next) {
-        sockfd = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+        sockfd = ::socket(p->ai_family, p->ai_socktype, p->ai_protocol);
         if (sockfd == -1) { 
             perror("socket");
             continue;
@@ -81,8 +107,15 @@ bool TcpChatClient::connectToServer() {
     inet_ntop(AF_INET, &ipv4->sin_addr, ip4, sizeof(ip4));
     std::cerr << "client: connecting to " << ip4 << std::endl;
 
+    // Remember the address, reconnects must not depend on the resolver
+    resolvedAddr = *ipv4;
+    addressResolved = true;
+
     // Free the address info structure as we no longer need it
     freeaddrinfo(servinfo);
+    socket = std::make_unique<PosixStreamSocket>(sockfd);
+    if (lowLatency) socket->setNonBlockingReceive();
+    applyTcpLiveness(sockfd, livenessPolicy);
 
     // Print a success message
   printf_debug("TCP client connected successfully.");
@@ -115,178 +148,717 @@ std::string to_upper(const std::string& input) {
     return upper;
 }
 
+// Splits the next space separated word off `rest`, like operator>> on a stream but without copying
+static std::string_view nextWord(std::string_view& rest) {
+    size_t start = rest.find_first_not_of(' ');
+    if (start == std::string_view::npos) {
+        rest = std::string_view();
+        return rest;
+    }
+    size_t end = std::min(rest.find(' ', start), rest.size());
+    std::string_view word = rest.substr(start, end - start);
+    rest.remove_prefix(end);
+    return word;
+}
+
+// Receives server data in a loop until the connection is closed or the client is stopping.
+// In resilient mode a lost connection is re-established instead.
 void TcpChatClient::receiveServerResponse() {
-    char buffer[2048];   // Buffer to store incoming data
-    std::string leftover; // String to store leftover data if the message is not complete
+    Trace::setThreadName("receiver");
+    if (lowLatency) {
+        pinCurrentThread(spinCpu, "receiver");
+        prefaultStack();
+    }
+    while (waitForData()) {
+        if (receiveOnce()) continue;
+        if (!sessionEnded() && reconnectPolicy.enabled && addressResolved && !shuttingDown && reconnect()) continue;
+        markServerClosed();  // No data or error, let the input loop finish
+        return;
+    }
+}
 
+// Waits until the socket is readable. Returns false when the client is being stopped.
+// In low-latency mode it does not wait at all, receiveOnce() then spins on non-blocking reads.
+// Outstanding AUTH/JOIN requests are expired on the way.
+bool TcpChatClient::waitForData() {
+    if (lowLatency) {
+        cpuRelax();
+        if (requests.pending()) expireRequests();
+        return !receiverStop.load(std::memory_order_relaxed);
+    }
+    pollfd fds[3] = {
+        {wakeup.fd(), POLLIN, 0},
+        {socket->fd(), POLLIN, 0},
+        {requestAdded.fd(), POLLIN, 0},
+    };
     while (true) {
-        ssize_t n = read(sockfd, buffer, sizeof(buffer));  // Read data from the socket
-        if (n <= 0) std::exit(0); // If no data or error, exit
-
-        leftover.append(buffer, n);  // Append the data to leftover string
-
-        size_t pos;
-        // Process each line received from the server
-        while ((pos = leftover.find("\r\n")) != std::string::npos) {
-            std::string line = leftover.substr(0, pos); // Extract a complete line
-            leftover.erase(0, pos + 2);  // Remove processed line from leftover
-            std::string upperLine = to_upper(line);      // Make line case-insensitive
-
-            // If the server sends a message about joining the default channel
-            if (upperLine.find("MSG FROM SERVER IS") == 0 && upperLine.find("JOINED DEFAULT") != std::string::npos) {
-                std::cout << "Server: " << line << std::endl;
-                sendChannelJoinConfirmation();  // Send confirmation of joining the default channel
-                continue;
-            }
+        // Sleep until the next REPLY deadline at most
+        int timeoutMs = -1;
+        if (auto deadline = requests.nextDeadline()) {
+            auto left = std::chrono::ceil<std::chrono::milliseconds>(*deadline - clock.now());
+            timeoutMs = static_cast<int>(std::max<int64_t>(0, left.count()));
+        }
+        int rc = poll(fds, 3, timeoutMs);
+        if (rc == -1) {
+            if (errno != EINTR) return true;  // Let read() report the error
+            continue;
+        }
+        if (timeoutMs >= 0) expireRequests();
+        if (fds[2].revents & POLLIN) {
+            requestAdded.reset();
+            if (!(fds[0].revents & POLLIN) && !(fds[1].revents & POLLIN)) continue;
+        }
+        if (rc > 0) return !(fds[0].revents & POLLIN);
+    }
+}
 
-            // If the message is invalid (not matching any known type)
-            if (upperLine.rfind("AUTH", 0) != 0 && upperLine.rfind("JOIN", 0) != 0 && 
-                upperLine.rfind("REPLY", 0) != 0 && upperLine.rfind("MSG", 0) != 0 &&
-                upperLine.rfind("ERR", 0) != 0 && upperLine.rfind("BYE", 0) != 0) {
-                processInvalidMessage(line);  // Handle invalid message
-                continue;
-            }
+// Fails the requests whose REPLY is overdue and lets the input side handle them. Their REPLYs
+// are still awaited, a late one must not be taken for the answer to the next request.
+void TcpChatClient::expireRequests() {
+    if (requests.expire(clock.now(), true) > 0) {
+        inputReady.notify();
+    }
+}
 
-            // Process ERROR messages
-            else if (upperLine.rfind("ERR", 0) == 0) {
-                std::istringstream iss(line);
-                std::string tag, from, sender, is;
-                iss >> tag >> from >> sender >> is;
+// Records that the connection is gone and wakes the input loop and a waiting shutdown
+void TcpChatClient::markServerClosed() {
+    {
+        std::lock_guard<std::mutex> lock(closeMutex);
+        serverClosed = true;
+    }
+    closedCv.notify_all();
+    wakeup.notify();
+}
 
-                std::string content;
-                std::getline(iss, content);  // Extract message content
-                if (!content.empty() && content.front() == ' ') content.erase(0, 1);
+// Sends BYE and waits up to the drain timeout until the server closes the connection, which
+// means it has read everything sent before. Then the receiver thread is woken up.
+void TcpChatClient::shutdownGracefully() {
+    shuttingDown = true;
+    auto deadline = std::chrono::steady_clock::now() + drainTimeout;
+    if (scheduler) {
+        unsentPaced = scheduler->flush(deadline);  // Paced messages go out before BYE
+        scheduler->stop();
+    }
+    bool connected;
+    {
+        std::lock_guard<std::mutex> lock(sessionMutex);
+        connected = sessionReady;
+    }
+    std::unique_lock<std::mutex> lock(closeMutex);
+    if (connected && !serverClosed) {
+        lock.unlock();
+        sendByeMessage();
+        lock.lock();
+        if (!closedCv.wait_until(lock, deadline, [this]() { return serverClosed; })) {
+            std::cerr << "Server did not close the connection within the drain timeout." << std::endl;
+        }
+    }
+    lock.unlock();
+    receiverStop = true;
+    wakeup.notify();
+}
 
-                std::cout << "ERROR FROM " << sender << ": " << content << std::endl;
-                std::exit(1);
-            }
+void TcpChatClient::setReconnectPolicy(const ReconnectPolicy& policy) {
+    reconnectPolicy = policy;
+    backoff = Backoff(policy);
+    outageQueue.setCapacity(policy.queueLimit);
+}
 
-            // Process BYE messages
-            else if (upperLine.rfind("BYE", 0) == 0) {
-                std::exit(0);
-            }
+bool TcpChatClient::setBatchScript(const std::string& path) {
+    batch = std::make_unique<BatchScript>(path, requests, wakeup, inputReady, events);
+    return batch->open();
+}
+
+// Opens a new connection to the cached server address and swaps it in
+bool TcpChatClient::connectCached() {
+    int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (sockfd == -1) {
+        perror("socket");
+        return false;
+    }
+    if (connect(sockfd, reinterpret_cast<const sockaddr*>(&resolvedAddr), sizeof(resolvedAddr)) == -1) {
+        close(sockfd);
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(socketMutex);
+    socket = std::make_unique<PosixStreamSocket>(sockfd);
+    if (lowLatency) socket->setNonBlockingReceive();
+    applyTcpLiveness(sockfd, livenessPolicy);
+    return true;
+}
 
-            // Process REPLY messages
-            else if (upperLine.rfind("REPLY", 0) == 0) {
-    std::istringstream iss(line);
-    std::string tag, status, is;
-    iss >> tag >> status >> is;
+// Called by the receiver thread when the connection dropped. Retries with jittered exponential
+// backoff until a connection is made, then starts replaying the session.
+// Returns false if the client is shutting down meanwhile.
+bool TcpChatClient::reconnect() {
+    {
+        std::lock_guard<std::mutex> lock(sessionMutex);
+        sessionReady = false;
+    }
+    leftover.clear();
+    if (requests.cancelAll(clock.now()) > 0) inputReady.notify();
+    std::cerr << "Connection lost, reconnecting..." << std::endl;
+
+    while (!shuttingDown) {
+        auto delay = backoff.next();
+        if (wakeup.waitFor(delay) || shuttingDown) break;
+        if (connectCached()) {
+            std::cerr << "Reconnected after " << backoff.attempts() << " attempt(s)." << std::endl;
+            replayNextRequest();
+            return true;
+        }
+        printf_debug("Reconnect attempt %d failed, retrying in about %ld ms", backoff.attempts(),
+                     static_cast<long>(delay.count()));
+    }
+    return false;
+}
 
-    std::string content;
-    std::getline(iss, content);
-    if (!content.empty() && content.front() == ' ') content.erase(0, 1);
+// Sends the next request needed to restore the session (AUTH, then the last JOIN).
+// When there is nothing (left) to replay the queued messages are flushed.
+void TcpChatClient::replayNextRequest() {
+    std::string request;
+    {
+        std::lock_guard<std::mutex> lock(sessionMutex);
+        if (resyncState == Resync::NONE && !authUsername.empty()) {
+            resyncState = Resync::AUTH;
+            request = "AUTH " + authUsername + " AS " + displayName + " USING " + authSecret + "\r\n";
+        } else if (resyncState == Resync::AUTH && !joinedChannel.empty()) {
+            resyncState = Resync::JOIN;
+            request = "JOIN " + joinedChannel + " AS " + displayName + "\r\n";
+        }
+    }
+    if (request.empty()) {
+        finishResync();
+        return;
+    }
+    // A failed send shows up as a closed connection in the receiver loop
+    sendRaw(request);
+}
 
-    std::string fullContent = to_upper(status) + " " + content;
+// Handles the REPLY to a replayed request. Returns false if no replay is in progress.
+bool TcpChatClient::handleResyncReply(bool ok, const std::string& msg) {
+    if (resyncState == Resync::NONE) return false;
 
-    Message reply(Message::Type::REPLY, fullContent);
-    process_reply(reply);
+    if (resyncState == Resync::AUTH && !ok) {
+        events.reply(false, msg);
+        events.notice("ERROR: session could not be re-established");
+        endSession(1);
+        return true;
+    }
+    if (resyncState == Resync::JOIN && !ok) {
+        events.reply(false, msg);
+    }
+    if (resyncState == Resync::AUTH) {
+        authenticated = true;
+        replayNextRequest();
+    } else {
+        finishResync();
+    }
+    return true;
+}
+
+// Sends the messages held during the outage and reopens the session for the input thread
+void TcpChatClient::finishResync() {
+    std::lock_guard<std::mutex> lock(sessionMutex);
+    resyncState = Resync::NONE;
+    backoff.reset();
+
+    std::vector<std::string> queued = outageQueue.takeAll();
+    if (scheduler) {
+        // Paced like any other message, the scheduler thread waits for this lock to be released
+        sessionReady = true;
+        for (const std::string& message : queued) {
+            WireBuffer wire = WireBuffer::copyOf(message.data(), message.size());
+            scheduler->submit(SendClass::BULK, [this, wire]() { sendPaced(wire); });
+        }
+        std::cerr << "Session re-established, " << queued.size() << " queued message(s) handed to the scheduler." << std::endl;
+        return;
+    }
+    for (size_t i = 0; i < queued.size(); ++i) {
+        if (!sendRaw(queued[i])) {
+            // Lost again, keep the rest for the next session
+            outageQueue.pushFront(std::vector<std::string>(queued.begin() + i, queued.end()));
+            return;
+        }
+    }
+    sessionReady = true;
+    std::cerr << "Session re-established, " << queued.size() << " queued message(s) sent." << std::endl;
+}
+
+// Reads once from the socket and processes every complete line.
+// Returns false when the connection was closed or failed; returns true (without processing)
+// when a non-blocking socket had nothing to read.
+bool TcpChatClient::receiveOnce() {
+    char buffer[2048];   // Buffer to store incoming data
+
+    ssize_t n = socket->read(buffer, sizeof(buffer));  // Read data from the socket
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+    if (n < 0) statAdd(threadCounters().receiveErrors);
+    if (n < 0 && errno == ETIMEDOUT && livenessPolicy.enabled) {
+        // Keepalive probes or unacknowledged data timed out (--keepalive, --dead-after)
+        std::cerr << "Server stopped responding to keepalive probes, declaring it dead." << std::endl;
+        events.serverLost();
+        if (!reconnectPolicy.enabled) {
+            events.notice("ERROR: Server not responding");
+            endSession(1);
+        }
+        return false;
+    }
+    if (n <= 0) return false;
+    auto receiveTime = clock.now();
+    TRACE_INSTANT("receive");
+
+    leftover.append(buffer, n);  // Append the data to leftover string (incomplete line is kept for the next read)
+
+    // Line copies of this read live in the scratch arena and are released together
+    ScratchArena scratch;
+    std::pmr::string line(scratch.resource());
+    std::pmr::string upperLine(scratch.resource());
+
+    size_t pos;
+    // Process each line received from the server
+    while (!sessionEnded() && (pos = leftover.find("\r\n")) != std::string::npos) {
+        line.assign(leftover.data(), pos); // Extract a complete line
+        captureWire(CaptureDirection::INBOUND, CaptureTransport::TCP, leftover.data(), pos + 2);
+        leftover.erase(0, pos + 2);  // Remove processed line from leftover
+        statMessageReceived(statKindFromTcpLine(line), line.size() + 2);
+        TRACE_SCOPE("dispatch");
+        upperLine.assign(line);      // Make line case-insensitive
+        std::transform(upperLine.begin(), upperLine.end(), upperLine.begin(), ::toupper);
+
+        // If the server sends a message about joining the default channel
+        if (upperLine.find("MSG FROM SERVER IS") == 0 && upperLine.find("JOINED DEFAULT") != std::string::npos) {
+            events.notice(std::string("Server: ").append(line));
+            sendChannelJoinConfirmation();  // Send confirmation of joining the default channel
+            continue;
+        }
+
+        // If the message is invalid (not matching any known type)
+        if (upperLine.rfind("AUTH", 0) != 0 && upperLine.rfind("JOIN", 0) != 0 && 
+            upperLine.rfind("REPLY", 0) != 0 && upperLine.rfind("MSG", 0) != 0 &&
+            upperLine.rfind("ERR", 0) != 0 && upperLine.rfind("BYE", 0) != 0) {
+            processInvalidMessage(std::string(line));  // Handle invalid message
+            continue;
+        }
+
+        // Process ERROR messages
+        else if (upperLine.rfind("ERR", 0) == 0) {
+            std::istringstream iss{std::string(line)};
+            std::string tag, from, sender, is;
+            iss >> tag >> from >> sender >> is;
+
+            std::string content;
+            std::getline(iss, content);  // Extract message content
+            if (!content.empty() && content.front() == ' ') content.erase(0, 1);
+
+            events.error(sender, content, receiveTime);
+            endSession(1);
+        }
+
+        // Process BYE messages
+        else if (upperLine.rfind("BYE", 0) == 0) {
+            events.bye(receiveTime);
+            endSession(0);
+        }
+
+        // Process REPLY messages
+        else if (upperLine.rfind("REPLY", 0) == 0) {
+std::istringstream iss{std::string(line)};
+std::string tag, status, is;
+iss >> tag >> status >> is;
+
+std::string content;
+std::getline(iss, content);
+if (!content.empty() && content.front() == ' ') content.erase(0, 1);
+
+std::string fullContent = to_upper(status) + " " + content;
+
+Message reply(Message::Type::REPLY, fullContent);
+process_reply(reply);
 }
 
 
-            // Process MSG messages
-            else if (upperLine.rfind("MSG", 0) == 0) {
-                std::istringstream iss(line);
-                std::string tag, from, sender, is;
-                iss >> tag >> from >> sender >> is;
-                std::string content;
-                std::getline(iss, content);
-                if (!content.empty() && content.front() == ' ') content.erase(0, 1);
-                std::cout << sender << ": " << content << "\n";
+        // Process MSG messages
+        else if (upperLine.rfind("MSG", 0) == 0) {
+            // "MSG FROM {DisplayName} IS {MessageContent}", parsed in place
+            std::string_view content(line);
+            nextWord(content);  // MSG
+            nextWord(content);  // FROM
+            std::string_view sender = nextWord(content);
+            nextWord(content);  // IS
+            if (!content.empty() && content.front() == ' ') content.remove_prefix(1);
+            {
+                TRACE_SCOPE("output");
+                events.message(sender, content, receiveTime);
             }
+            history.record(sender, content, receiveTime);
+            latencyMetrics().deliveryLatency.record(clock.now() - receiveTime);
         }
     }
+    return !sessionEnded();  // After BYE or ERR the receiver stops like on a closed connection
 }
 
 //  Function 'run' is the main loop of the TcpChatClient class that handles user input, message processing, and communication with the server.
 void TcpChatClient::run() {
     std::string line;
-    std::string messageToSend;
 
     // Start a new thread to receive server responses
-    std::thread receiverThread(&TcpChatClient::receiveServerResponse, this);
-
-    // Loop to read commands and messages from user input
-    while (std::getline(std::cin, line)) {
-        std::string messageToSend;
+    start();
 
-        // Process the /help command to show usage instructions
-        if (line.rfind("/help", 0) == 0) {
-            printHelp();
+    // Loop to read commands and messages from user input until stdin ends, a termination
+    // signal arrives or the receiver reports a closed connection
+    Trace::setThreadName("input");
+    InputLoop input(wakeup, inputFd, &inputReady, inbox ? inbox->fd() : -1);
+    while (true) {
+        InputLoop::Event event = batch ? batch->next(line) : input.next(line);
+        if (event == InputLoop::Event::LINE) {
+            TRACE_INSTANT("stdin_read");
+            if (!submitLine(line)) break;
+            continue;
+        }
+        if (event == InputLoop::Event::READY) {
+            releaseHeldInput();  // A REPLY arrived or a request timed out
             continue;
         }
+        if (event == InputLoop::Event::SOURCE) {
+            if (!drainInbox()) break;
+            continue;
+        }
+        if (event == InputLoop::Event::END_OF_INPUT) awaitHeldInput(wakeup);
+        if (event == InputLoop::Event::SIGNAL) {
+            int signal = batch ? batch->lastSignal() : input.lastSignal();
+            std::cerr << strsignal(signal) << " received, shutting down." << std::endl;
+        }
+        break;
+    }
 
-        // If user tries to authenticate when already authenticated, show an error
-        if (line.rfind("/auth", 0) == 0) {
-            if (authenticated) {
-                std::cout << "ERROR: You are already authenticated!" << std::endl;
-                return;  // Do not authenticate again
-            }
+    finish();
+}
+
+void TcpChatClient::start() {
+    receiverThread = std::thread(&TcpChatClient::receiveServerResponse, this);
+}
 
-            // Process the /auth command if the user is not authenticated
-            auto cmd = InputHandler::parseAuthCommand(line);
-            if (cmd) {
-                messageToSend = "AUTH " + cmd->username + " AS " + cmd->displayName + " USING " + cmd->secret + "\r\n";
-                // After successful authentication, set displayName and authenticated to true
-                displayName = cmd->displayName;
+bool TcpChatClient::submitLine(const std::string& line) {
+    std::lock_guard<std::mutex> lock(inputMutex);
+    handleHeldLocked();
+    // Input entered while an AUTH/JOIN waits for its REPLY is handled after it
+    if (requests.holdIfPending(line)) return !sessionEnded();
+    return handleInputLine(line) && !sessionEnded();
+}
+
+// Chat messages never need the command parsing of handleInputLine()
+bool TcpChatClient::sendChat(std::string_view content) {
+    std::lock_guard<std::mutex> lock(inputMutex);
+    handleHeldLocked();
+    if (requests.holdIfPending(content, true)) return !sessionEnded();
+    if (displayName.empty()) {
+        events.notice("ERROR: not authenticated");
+        return !sessionEnded();
+    }
+    if (content.size() <= MAX_MESSAGE_CONTENT) return sendChatMessage(content) && !sessionEnded();
+    for (std::string_view piece : splitMessageContent(content)) {
+        if (!sendChatMessage(piece)) return false;
+    }
+    return !sessionEnded();
+}
+
+void TcpChatClient::releaseHeldInput() {
+    std::lock_guard<std::mutex> lock(inputMutex);
+    handleHeldLocked();
+}
+
+// Runs the handlers of finished requests and the input held behind them, until a held /auth or
+// /join opens the next request. inputMutex must be held.
+void TcpChatClient::handleHeldLocked() {
+    requests.runFinished();
+    HeldInput input;
+    while (!sessionEnded() && requests.nextHeld(input)) {
+        if (input.verbatim) {
+            if (displayName.empty()) {
+                events.notice("ERROR: not authenticated");
             } else {
-                  printf_debug("Invalid /auth command format.");
-                continue;
+                for (std::string_view piece : splitMessageContent(input.text)) {
+                    if (!sendChatMessage(piece)) break;
+                }
             }
+        } else {
+            handleInputLine(input.text);
         }
-        // If the user is not authenticated and tries to send a command other than /auth, show an error
-        else if (displayName.empty() && line.rfind("/auth", 0) != 0) {
-            std::cout << "ERROR: not authenticated\n";
-            continue;
+        requests.runFinished();
+    }
+}
+
+// Tracks an AUTH/JOIN before it is sent, the REPLY may arrive before send() returns
+void TcpChatClient::trackRequest(PendingRequest::Kind kind, const std::string& argument) {
+    PendingRequest request;
+    request.kind = kind;
+    request.argument = argument;
+    request.sentAt = clock.now();
+    request.onDone = [this, kind, argument](const RequestResult& result) { requestDone(kind, argument, result); };
+    requests.add(std::move(request));
+    if (!lowLatency) requestAdded.notify();
+}
+
+// Applies the outcome of an AUTH/JOIN to the session, on the input side
+void TcpChatClient::requestDone(PendingRequest::Kind kind, const std::string& argument, const RequestResult& result) {
+    bool auth = kind == PendingRequest::Kind::AUTH;
+    if (result.status == RequestStatus::TIMEOUT) {
+        events.notice(std::string("ERROR: No REPLY to ") + (auth ? "AUTH" : "JOIN") + " within " +
+                      std::to_string(requests.replyTimeout().count()) + " ms");
+    }
+    std::lock_guard<std::mutex> lock(sessionMutex);
+    if (auth) {
+        // A cancelled AUTH is replayed after the reconnect
+        authenticated = result.status == RequestStatus::OK || result.status == RequestStatus::CANCELLED;
+        if (!authenticated) {
+            displayName.clear();  // /auth may be tried again
+            authUsername.clear();
+            authSecret.clear();
         }
+        return;
+    }
+    // A JOIN cut off by a reconnect is joined when the session is replayed
+    if (result.status == RequestStatus::OK || result.status == RequestStatus::CANCELLED) {
+        joinedChannel = argument;
+        history.setChannel(joinedChannel);
+    }
+}
 
-        // Process the /join command to join a channel
-        else if (line.rfind("/join", 0) == 0) {
-            auto cmd = InputHandler::parseJoinCommand(line);
-            if (cmd) {
-                messageToSend = "JOIN " + cmd.value() + " AS " + displayName + "\r\n";
-            } else {
-                  printf_debug("Invalid /join command format.");
-                continue;
-            }
+int TcpChatClient::finish() {
+    shutdownGracefully();  // Send "BYE" and wait for the server to finish the session
+    if (receiverThread.joinable()) receiverThread.join();  // Wait for the receiver thread to finish
+
+    size_t undelivered = outageQueue.size() + unsentPaced;
+    if (undelivered > 0 && !sessionEnded()) {
+        events.notice("ERROR: " + std::to_string(undelivered) + " message(s) were not delivered");
+        if (batch) batch->fail("undelivered messages");
+    }
+    return exitStatus();
+}
+
+// Ends the session on BYE or ERR from the server or a fatal error. Called on the receiver
+// thread, which then stops as if the connection was closed, so shutdown sends no BYE.
+void TcpChatClient::endSession(int status) {
+    markSessionEnded(status);
+}
+
+// Handles one line of user input: a local command, a request for the server or a chat message.
+// Returns false if the connection failed and the input loop should stop.
+bool TcpChatClient::handleInputLine(const std::string& line) {
+    TRACE_SCOPE("handle_input");
+    WireBuffer messageToSend;
+    PendingRequest::Kind requestKind = PendingRequest::Kind::AUTH;
+    std::string requestArgument;
+
+    // Process the /help command to show usage instructions
+    if (line.rfind("/help", 0) == 0) {
+        printHelp();
+        return true;
+    }
+
+    // Process the local /history and /search commands
+    if (history.handleCommand(line, events)) {
+        return true;
+    }
+
+    // If user tries to authenticate when already authenticated, show an error
+    if (line.rfind("/auth", 0) == 0) {
+        if (authenticated) {
+            events.notice("ERROR: You are already authenticated!");
+            return true;  // Do not authenticate again
         }
 
-        // Process the /rename command to change the display name
-        else if (line.rfind("/rename", 0) == 0) {
-            std::string newDisplayName = line.substr(8);  // Trim the "/rename " part from the line
-            if (newDisplayName.empty()) {
-                printf_debug("Invalid /rename command format: Display name cannot be empty.");
+        // Process the /auth command if the user is not authenticated
+        auto cmd = InputHandler::parseAuthCommand(line);
+        if (cmd) {
+            std::string auth = "AUTH " + cmd->username + " AS " + cmd->displayName + " USING " + cmd->secret + "\r\n";
+            messageToSend = WireBuffer::copyOf(auth.data(), auth.size());
+            requestKind = PendingRequest::Kind::AUTH;
+            requestArgument = cmd->displayName;
+            // The REPLY decides whether the user stays authenticated
+            std::lock_guard<std::mutex> lock(sessionMutex);
+            displayName = cmd->displayName;
+            msgPrefix.rebuild(displayName);
+            authUsername = cmd->username;
+            authSecret = cmd->secret;
+        } else {
+              printf_debug("Invalid /auth command format.");
+            return true;
+        }
+    }
+    // If the user is not authenticated and tries to send a command other than /auth, show an error
+    else if (displayName.empty() && line.rfind("/auth", 0) != 0) {
+        events.notice("ERROR: not authenticated");
+        return true;
+    }
 
-                continue;
-            }
+    // Process the /join command to join a channel
+    else if (line.rfind("/join", 0) == 0) {
+        auto cmd = InputHandler::parseJoinCommand(line);
+        if (cmd) {
+            std::string join = "JOIN " + cmd.value() + " AS " + displayName + "\r\n";
+            messageToSend = WireBuffer::copyOf(join.data(), join.size());
+            requestKind = PendingRequest::Kind::JOIN;
+            requestArgument = cmd.value();
+        } else {
+              printf_debug("Invalid /join command format.");
+            return true;
+        }
+    }
+
+    // Process the /send command to stream a file as chat messages
+    else if (line.rfind("/send", 0) == 0) {
+        return sendFile(line);
+    }
+
+    // Process the /rename command to change the display name
+    else if (line.rfind("/rename", 0) == 0) {
+        std::string newDisplayName = line.substr(8);  // Trim the "/rename " part from the line
+        if (newDisplayName.empty()) {
+            printf_debug("Invalid /rename command format: Display name cannot be empty.");
+
+            return true;
+        }
+        {
+            std::lock_guard<std::mutex> lock(sessionMutex);
             displayName = newDisplayName;  // Change the display name
-            printf_debug("Display name changed to: %s", displayName.c_str());
-            continue;
+            msgPrefix.rebuild(displayName);
+        }
+        printf_debug("Display name changed to: %s", displayName.c_str());
+        return true;
+    }
+
+    // If the line is not a command, treat it as a message to be sent to the server.
+    // Content over the protocol limit is sent as several messages.
+    else {
+        if (line.size() <= MAX_MESSAGE_CONTENT) return sendChatMessage(line);
+        for (std::string_view piece : splitMessageContent(line)) {
+            if (!sendChatMessage(piece)) return false;
+        }
+        return true;
+    }
+
+    // In resilient mode nothing is sent while the session is being restored, the requests
+    // are replayed by the receiver thread
+    if (reconnectPolicy.enabled) {
+        std::lock_guard<std::mutex> lock(sessionMutex);
+        if (!sessionReady) {
+            if (requestKind == PendingRequest::Kind::JOIN) {
+                joinedChannel = requestArgument;
+                history.setChannel(joinedChannel);
+            }
+            return true;
         }
+    }
+
+    // AUTH and JOIN are answered by a REPLY
+    trackRequest(requestKind, requestArgument);
+
+    // Send the command to the server
+    std::cerr << "Sending: ";
+    std::cerr.write(reinterpret_cast<const char*>(messageToSend.data()), messageToSend.size()) << std::endl;
+    if (!sendRaw(messageToSend)) {
+        // In resilient mode the receiver notices the broken connection and reconnects
+        if (reconnectPolicy.enabled) return true;
+        std::perror("ERROR: send failed");  // If sending the message fails, print an error
+        return false;
+    }
+    return true;
+}
 
-        // If the line is not a command, treat it as a message to be sent to the server
-        else {
-            messageToSend = "MSG FROM " + displayName + " IS " + line + "\r\n";
+// Sends one chat message, through the scheduler when pacing is configured. While the session is
+// being restored the message waits in the outage queue.
+// Returns false if the connection failed.
+bool TcpChatClient::sendChatMessage(std::string_view content) {
+    // Only the input thread changes the name, so the prefix can be read without the lock
+    WireBuffer messageToSend = msgPrefix.encode(content);
+
+    if (reconnectPolicy.enabled) {
+        std::lock_guard<std::mutex> lock(sessionMutex);
+        if (!sessionReady) {
+            if (!outageQueue.push(messageToSend.toString())) {
+                events.notice("ERROR: outage queue full, message dropped");
+            }
+            return true;
         }
+    }
+
+    // Chat messages go through the send scheduler when one is configured
+    if (scheduler) {
+        scheduler->submit(SendClass::BULK, [this, messageToSend]() { sendPaced(messageToSend); });
+        return true;
+    }
 
-        // Send the message or command to the server
-        std::cerr << "Sending: " << messageToSend << std::endl;
-        if (send(sockfd, messageToSend.c_str(), messageToSend.size(), 0) == -1) {
-            std::perror("ERROR: send failed");  // If sending the message fails, print an error
-            break;
+    if (!lowLatency) {
+        std::cerr << "Sending: ";
+        std::cerr.write(reinterpret_cast<const char*>(messageToSend.data()), messageToSend.size()) << std::endl;
+    }
+    if (!sendRaw(messageToSend)) {
+        if (reconnectPolicy.enabled) {
+            // The receiver notices the broken connection and reconnects, keep the message
+            if (!outageQueue.push(messageToSend.toString())) {
+                events.notice("ERROR: outage queue full, message dropped");
+            }
+            return true;
         }
+        std::perror("ERROR: send failed");  // If sending the message fails, print an error
+        return false;
+    }
+    return true;
+}
+
+// Streams a file as numbered chat messages (/send). TCP has no per-message confirmation, the
+// socket applies flow control; with pacing at most a window of chunks waits in the scheduler.
+// Returns false if the connection failed.
+bool TcpChatClient::sendFile(const std::string& line) {
+    auto path = InputHandler::parseSendCommand(line);
+    if (!path) {
+        events.notice("ERROR: Invalid /send command. Correct format: /send {Path}");
+        return true;
+    }
+    FileTransfer transfer(*path);
+    if (!transfer.open()) {
+        events.notice(transfer.error());
+        return true;
     }
 
-    sendByeMessage();  // Call sendByeMessage to send a "BYE" message after communication ends
-    receiverThread.join();  // Wait for the receiver thread to finish
+    // Waits until at most `maxDepth` chunks are left in the scheduler, false when interrupted
+    auto waitForQueue = [this](size_t maxDepth) {
+        while (scheduler && scheduler->queueDepth(SendClass::BULK) > maxDepth) {
+            if (ShutdownSignals::pending() || wakeup.waitFor(std::chrono::milliseconds(5))) return false;
+        }
+        return !ShutdownSignals::pending();
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < transfer.chunkCount(); ++i) {
+        if (!waitForQueue(transfer.window() - 1)) {
+            events.notice("ERROR: /send interrupted after " + std::to_string(i) + " of " +
+                          std::to_string(transfer.chunkCount()) + " chunk(s)");
+            return true;
+        }
+        if (!sendChatMessage(transfer.chunk(i))) return false;
+    }
+    // Completion means every chunk was written to the socket
+    if (!waitForQueue(0)) {
+        events.notice("ERROR: /send interrupted before all chunks were sent");
+        return true;
+    }
+    transfer.report(std::chrono::steady_clock::now() - start);
+    return true;
 }
 
 
 // Function to display help message with available commands
 void TcpChatClient::printHelp() {
-    std::cout << "/auth {Username} {Secret} {DisplayName} - Authenticate user\n";  // Command to authenticate
-    std::cout << "/join {ChannelID} - Join a channel\n";  // Command to join a specified channel
-    std::cout << "/rename {DisplayName} - Change your display name\n";  // Command to change the user's display name
-    std::cout << "/help - Show this help message\n";  // Command to show help information
+    events.info("/auth {Username} {Secret} {DisplayName} - Authenticate user\n"  // Command to authenticate
+                "/join {ChannelID} - Join a channel\n"  // Command to join a specified channel
+                "/rename {DisplayName} - Change your display name\n"  // Command to change the user's display name
+                "/send {Path} - Send a file as a series of messages\n"  // Command to stream a file
+                "/history [N] - Show the last N messages of the channel\n"  // Local message history
+                "/search {Text} - Show the channel messages containing the text\n"  // Search the history
+                "/help - Show this help message");  // Command to show help information
 }
 
 // Function to send a "BYE" message to the server to indicate the end of the session
@@ -294,7 +866,9 @@ void TcpChatClient::sendByeMessage() {
     if (!displayName.empty()) {  // Check if the display name is set
         Message byeMessage = Message::createByeMessage(displayName);  // Create a BYE message
         std::cerr << "Sending BYE message: " << byeMessage.getContent() << "\r\n" << std::endl;  // Display the message content
-        byeMessage.sendMessage(sockfd);  // Send the BYE message to the server
+        if (!sendRaw(byeMessage.getContent() + "\r\n")) {  // Send the BYE message to the server
+            std::perror("ERROR: send failed");
+        }
     }
 }
 
@@ -310,36 +884,90 @@ void TcpChatClient::process_reply(const Message& reply) {
         std::string status = content.substr(0, pos);  // Extract the status ("OK" or "NOK")
         std::string msg = content.substr(pos + 1);     // Extract the message content
 
-        // Process the reply based on the status
-        if (status == "OK") {
-            std::cout << "Action Success: " << msg << std::endl;  // Success message
-            authenticated = true;  // Set authenticated to true
-        } else if (status == "NOK") {
-            std::cout << "Action Failure: " << msg << std::endl;  // Failure message
-            authenticated = false;  // Set authenticated to false
-        } else {
+        // Replies to requests replayed after a reconnect are handled separately
+        if (handleResyncReply(status == "OK", msg)) return;
+
+        if (status != "OK" && status != "NOK") {
             std::cerr << "ERROR: Unknown REPLY status: " << status << std::endl;  // Handle unexpected statuses
+            return;
+        }
+
+        // The server answers requests in order, the REPLY belongs to the oldest one
+        auto waited = requests.completeOldest(status == "OK", msg, clock.now());
+        if (!waited) {
+            std::cerr << "Ignoring REPLY to a timed-out or unknown request: " << content << std::endl;
+            return;
         }
+        latencyMetrics().replyLatency.record(*waited);
+        events.reply(status == "OK", msg, clock.now());
+        // The input side applies the result and sends what was held behind the request
+        inputReady.notify();
     }
 }
 
 // Function to process an invalid message and send an error message to the server
 void TcpChatClient::processInvalidMessage(const std::string& invalidMessage) {
-    std::cout << "ERROR: " << invalidMessage << std::endl;  // Print the invalid message error
+    events.notice("ERROR: " + invalidMessage);  // Report the invalid message error
 
     // Before sending the error message to the server, format it
     std::string errorMessage = "ERR FROM " + displayName + " IS " + invalidMessage + "\r\n";
-    send(sockfd, errorMessage.c_str(), errorMessage.size(), 0);  // Send the error message to the server
-    std::exit(1); 
+    sendRaw(errorMessage);  // Send the error message to the server
+    endSession(1);
 }
 
 // Function to send a confirmation message when the user joins the default channel
 void TcpChatClient::sendChannelJoinConfirmation() {
     // Create and send a confirmation message stating that the user joined the default channel
-    std::string msg = "MSG FROM " + displayName + " IS " + displayName + " joined default.\r\n";
-    printf_debug("Sending: %s", msg.c_str());
-    if (send(sockfd, msg.c_str(), msg.size(), 0) == -1) {  // Send the confirmation message
+    WireBuffer msg;
+    {
+        std::lock_guard<std::mutex> lock(sessionMutex);
+        msg = msgPrefix.encode(displayName + " joined default.");
+    }
+    printf_debug("Sending: %s", msg.toString().c_str());
+    if (!sendRaw(msg)) {  // Send the confirmation message
         std::perror("ERROR: send failed");  // If sending fails, display an error
-        std::exit(1);  // Exit the program if sending the message fails
+        endSession(1);  // End the session if sending the message fails
+    }
+}
+
+// Sends raw protocol data (one or more CRLF-terminated lines), accounts it in the statistics
+// and records it when capturing.
+// Returns false if the socket write failed.
+bool TcpChatClient::sendRaw(const char* data, size_t length) {
+    TRACE_SCOPE("send");
+    std::lock_guard<std::mutex> lock(socketMutex);
+    if (socket->send(data, length) == -1) {
+        return false;
+    }
+    statMessageSent(statKindFromTcpLine(std::string_view(data, length)), length);
+    captureWire(CaptureDirection::OUTBOUND, CaptureTransport::TCP, data, length);
+    return true;
+}
+
+bool TcpChatClient::sendRaw(const std::string& data) {
+    return sendRaw(data.data(), data.size());
+}
+
+bool TcpChatClient::sendRaw(const WireBuffer& data) {
+    return sendRaw(reinterpret_cast<const char*>(data.data()), data.size());
+}
+
+// Runs on the scheduler thread: sends one chat message, or keeps it for the next session when the
+// connection is being restored
+void TcpChatClient::sendPaced(const WireBuffer& data) {
+    std::lock_guard<std::mutex> lock(sessionMutex);
+    if (sessionReady && sendRaw(data)) return;
+    if (reconnectPolicy.enabled) {
+        if (!outageQueue.push(data.toString())) {
+            events.notice("ERROR: outage queue full, message dropped");
+        }
+        return;
     }
+    std::perror("ERROR: send failed");
+}
+
+// Processes available server data once, used by the simulator instead of the receiver thread.
+// Returns false when the connection was closed.
+bool TcpChatClient::pollNetwork() {
+    return receiveOnce();
 }
@@ -1,28 +1,145 @@
 #pragma once
 #include <string>
+#include <string_view>
+#include <atomic>
+#include <cstdint>
 #include "MessageTcp.h"
 #include "ChatClient.h"
+#include "Clock.h"
+#include "Socket.h"
+#include "Reconnect.h"
+#include "Shutdown.h"
+#include "SendScheduler.h"
+#include "MessagePrefix.h"
+#include "WireBuffer.h"
+#include "History.h"
+#include "BatchScript.h"
+#include "Liveness.h"
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <netinet/in.h>
+#include <thread>
 
 #define DEFAULT_PORT 4567
 // This class represents a TCP chat client that connects to a server and sends/receives messages.
 class TcpChatClient : public ChatClient {
 public:
     TcpChatClient(const std::string& host, int port);
+    TcpChatClient(std::unique_ptr<StreamSocket> socket, Clock& clock);
     ~TcpChatClient();
 
     bool connectToServer();
     void run();
+    void start();
+    bool submitLine(const std::string& line);
+    bool sendChat(std::string_view content);
+    void releaseHeldInput();
+    int finish();
+    bool handleInputLine(const std::string& line);
     void printHelp();
     void sendByeMessage();
     void process_reply(const Message& reply);
     void sendChannelJoinConfirmation();
    void processInvalidMessage(const std::string& invalidMessage);
+
+    // Single-threaded stepping used by the simulator instead of the receiver thread
+    bool pollNetwork();
+
+    // Enables automatic reconnect with session replay (--reconnect)
+    void setReconnectPolicy(const ReconnectPolicy& policy);
+
+    // How long shutdown waits for the server to close the connection after BYE
+    void setDrainTimeout(std::chrono::milliseconds timeout) { drainTimeout = timeout; }
+
+    // Paces chat messages to `rate` per second with bursts of up to `burst` (--rate, --burst)
+    void setPacing(double rate, double burst) { scheduler = std::make_unique<SendScheduler>(rate, burst); }
+
+    // Busy-polls the socket with non-blocking reads instead of sleeping in poll() (--low-latency),
+    // optionally pinning the receiver thread to `cpu` (-1 = unpinned)
+    void setLowLatency(int cpu) { lowLatency = true; spinCpu = cpu; }
+
+    // Enables TCP keepalive and TCP_USER_TIMEOUT so a silent server is declared dead after
+    // deadAfter (--keepalive, --dead-after). Must be called before connectToServer().
+    void setLiveness(const LivenessPolicy& policy);
+
+    // Keeps the newest received messages per channel for /history and /search (--history)
+    void setHistoryLimits(const HistoryLimits& limits) { history.configure(limits); }
+
+    // Reads the input from a script instead of stdin, waiting for each REPLY up to the reply
+    // timeout (--batch, call after setReplyTimeout)
+    bool setBatchScript(const std::string& path);
+    bool batchFailed() const { return batch && batch->failed(); }
 private:
     std::string server;
     std::string displayName; 
+    TcpMsgPrefix msgPrefix;  // "MSG FROM {displayName} IS ", rebuilt with displayName
     int port;
-    int sockfd;
-    bool authenticated; 
+    std::unique_ptr<StreamSocket> socket;
+    Clock& clock;
+    std::string leftover;  // Received data that does not form a complete line yet
+    std::atomic<bool> authenticated;  // Set by the input side and by the receiver during a resync
+
+    // Resilient mode: the connection is re-established to the cached address, AUTH and the
+    // last JOIN are replayed and user messages wait in outageQueue until the session is back
+    enum class Resync { NONE, AUTH, JOIN };
+    ReconnectPolicy reconnectPolicy;
+    Backoff backoff{reconnectPolicy};
+    OutageQueue outageQueue;
+    sockaddr_in resolvedAddr{};
+    bool addressResolved = false;
+    std::mutex socketMutex;      // Guards socket replacement against concurrent sends
+    std::mutex sessionMutex;     // Guards the session state below and the queue hand-over
+    bool sessionReady = true;    // False while the connection is down or being restored
+    Resync resyncState = Resync::NONE;  // Only used by the receiver thread
+    std::string authUsername;
+    std::string authSecret;
+    std::string joinedChannel;
+    MessageHistory history;
+    std::unique_ptr<BatchScript> batch;
+    std::atomic<bool> shuttingDown{false};
+
+    // Graceful shutdown: the receiver thread polls the socket together with `wakeup` and
+    // reports the closed connection through serverClosed/closedCv
+    Wakeup wakeup;
+    std::chrono::milliseconds drainTimeout{2000};
+    std::mutex closeMutex;
+    std::condition_variable closedCv;
+    bool serverClosed = false;
+    bool lowLatency = false;
+    int spinCpu = -1;
+    std::atomic<bool> receiverStop{false};  // Ends the spinning receiver, set with the final wakeup
+    bool waitForData();
+    void markServerClosed();
+    void shutdownGracefully();
+    void endSession(int status);
+    std::thread receiverThread;
+    LivenessPolicy livenessPolicy;
+    int rttGaugeId = -1;
+
+    std::unique_ptr<SendScheduler> scheduler;  // Only set when pacing is configured
+    size_t unsentPaced = 0;        // Messages still in the scheduler when the drain timeout expired
+    void sendPaced(const WireBuffer& data);
+    bool reconnect();
+    bool connectCached();
+    void replayNextRequest();
+    bool handleResyncReply(bool ok, const std::string& msg);
+    void finishResync();
+    // REPLYs complete the oldest request. Completion handlers and the input held meanwhile are
+    // processed on the input side, serialized by inputMutex.
+    std::mutex inputMutex;
+    void trackRequest(PendingRequest::Kind kind, const std::string& argument);
+    void requestDone(PendingRequest::Kind kind, const std::string& argument, const RequestResult& result);
+    void handleHeldLocked();
+    void expireRequests();
+    Wakeup requestAdded;  // Wakes the receiver to wait for the new REPLY deadline
     void receiveServerResponse();
+    bool receiveOnce();
+    bool sendChatMessage(std::string_view content);
+    bool sendFile(const std::string& line);
+    bool sendRaw(const std::string& data);
+    bool sendRaw(const WireBuffer& data);
+    bool sendRaw(const char* data, size_t length);
     Message parseMessage(const std::string& buffer); 
 };
@@ -0,0 +1,167 @@
+#include "Trace.h"
+#include <cstdio>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+std::atomic<bool> Trace::active{false};
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    uint64_t timestampNs;
+    uint64_t durationNs;
+    char phase;             // 'X' = complete span, 'i' = instant
+};
+
+// Ring buffer owned by one thread; only the owner writes, the exporter reads `head` with acquire
+struct ThreadBuffer {
+    explicit ThreadBuffer(size_t capacity) : events(capacity) {}
+
+    std::vector<TraceEvent> events;
+    std::atomic<uint64_t> head{0};  // Number of events ever written
+    long threadId = 0;
+    std::string threadName;
+};
+
+struct TraceRegistry {
+    std::mutex mutex;
+    std::vector<ThreadBuffer*> buffers;
+    std::string outputPath;
+    size_t eventsPerThread = 65536;
+};
+
+// Never destroyed: threads may still trace while the process exits
+TraceRegistry& registry() {
+    static TraceRegistry* instance = new TraceRegistry();
+    return *instance;
+}
+
+ThreadBuffer& threadBuffer() {
+    thread_local ThreadBuffer* buffer = []() {
+        TraceRegistry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        ThreadBuffer* created = new ThreadBuffer(reg.eventsPerThread);
+        created->threadId = static_cast<long>(syscall(SYS_gettid));
+        reg.buffers.push_back(created);
+        return created;
+    }();
+    return *buffer;
+}
+
+void push(const TraceEvent& event) {
+    ThreadBuffer& buffer = threadBuffer();
+    uint64_t head = buffer.head.load(std::memory_order_relaxed);
+    buffer.events[head % buffer.events.size()] = event;
+    buffer.head.store(head + 1, std::memory_order_release);
+}
+
+// Writes a string as a JSON string literal (trace point names are plain literals,
+// thread names are short, so only quotes, backslashes and control characters need care)
+void writeJsonString(FILE* out, const char* text) {
+    std::fputc('"', out);
+    for (const char* c = text; *c != '\0'; ++c) {
+        if (*c == '"' || *c == '\\') {
+            std::fputc('\\', out);
+            std::fputc(*c, out);
+        } else if (static_cast<unsigned char>(*c) < 0x20) {
+            std::fprintf(out, "\\u%04x", *c);
+        } else {
+            std::fputc(*c, out);
+        }
+    }
+    std::fputc('"', out);
+}
+
+} // namespace
+
+void Trace::enable(const std::string& outputPath, size_t eventsPerThread) {
+    TraceRegistry& reg = registry();
+    {
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.outputPath = outputPath;
+        reg.eventsPerThread = eventsPerThread > 0 ? eventsPerThread : 1;
+    }
+    active.store(true, std::memory_order_relaxed);
+}
+
+uint64_t Trace::nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+void Trace::setThreadName(const char* name) {
+    if (!enabled()) return;
+    ThreadBuffer& buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    buffer.threadName = name;
+}
+
+void Trace::instant(const char* name) {
+    push({name, nowNs(), 0, 'i'});
+}
+
+void Trace::complete(const char* name, uint64_t startNs) {
+    uint64_t endNs = nowNs();
+    push({name, startNs, endNs - startNs, 'X'});
+}
+
+bool Trace::writeFile() {
+    if (!enabled()) return true;
+    active.store(false, std::memory_order_relaxed);  // Stop recording while exporting
+
+    TraceRegistry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    FILE* out = std::fopen(reg.outputPath.c_str(), "w");
+    if (out == nullptr) {
+        perror("ERROR: Unable to write trace file");
+        return false;
+    }
+
+    long pid = static_cast<long>(getpid());
+    bool first = true;
+    auto separator = [&]() {
+        std::fputs(first ? "\n" : ",\n", out);
+        first = false;
+    };
+
+    std::fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", out);
+    for (const ThreadBuffer* buffer : reg.buffers) {
+        if (!buffer->threadName.empty()) {
+            separator();
+            std::fprintf(out, "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%ld,\"tid\":%ld,\"args\":{\"name\":",
+                         pid, buffer->threadId);
+            writeJsonString(out, buffer->threadName.c_str());
+            std::fputs("}}", out);
+        }
+
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t capacity = buffer->events.size();
+        uint64_t begin = head > capacity ? head - capacity : 0;
+        for (uint64_t i = begin; i < head; ++i) {
+            const TraceEvent& event = buffer->events[i % capacity];
+            separator();
+            std::fputs("{\"name\":", out);
+            writeJsonString(out, event.name);
+            // Chrome trace timestamps are microseconds, keep nanosecond precision as fractions
+            std::fprintf(out, ",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%ld,\"tid\":%ld",
+                         event.phase, event.timestampNs / 1000.0, pid, buffer->threadId);
+            if (event.phase == 'X') {
+                std::fprintf(out, ",\"dur\":%.3f", event.durationNs / 1000.0);
+            } else {
+                std::fputs(",\"s\":\"t\"", out);
+            }
+            std::fputc('}', out);
+        }
+    }
+    std::fputs("\n]}\n", out);
+    bool ok = std::fclose(out) == 0;
+    std::cerr << "Trace written to " << reg.outputPath << std::endl;
+    return ok;
+}
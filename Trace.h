@@ -0,0 +1,67 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Low-overhead event tracing.
+// Every thread records spans and instant events into its own fixed-size ring buffer
+// (oldest events are overwritten), timestamps come from CLOCK_MONOTONIC.
+// When tracing is disabled a trace point costs one relaxed atomic load.
+// The collected events are written as Chrome trace JSON (chrome://tracing, ui.perfetto.dev).
+class Trace {
+public:
+    // Enables tracing; writeFile() will later write the events to `outputPath`
+    static void enable(const std::string& outputPath, size_t eventsPerThread = 65536);
+
+    static bool enabled() { return active.load(std::memory_order_relaxed); }
+
+    // Names the calling thread in the trace viewer
+    static void setThreadName(const char* name);
+
+    // Records a point event
+    static void instant(const char* name);
+
+    // Records a span that started at `startNs` and ends now
+    static void complete(const char* name, uint64_t startNs);
+
+    // Current CLOCK_MONOTONIC time in nanoseconds
+    static uint64_t nowNs();
+
+    // Writes all recorded events as Chrome trace JSON, returns false on I/O error
+    static bool writeFile();
+
+private:
+    static std::atomic<bool> active;
+};
+
+// Records a span from construction to destruction (name must be a string literal)
+class TraceScope {
+public:
+    explicit TraceScope(const char* name) : name(name), startNs(Trace::enabled() ? Trace::nowNs() : 0) {}
+    ~TraceScope() {
+        if (startNs != 0) Trace::complete(name, startNs);
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name;
+    uint64_t startNs;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+// Traces the rest of the enclosing block as a span
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope_, __LINE__)(name)
+
+// Traces a point event
+#define TRACE_INSTANT(name) \
+do { \
+if (Trace::enabled()) Trace::instant(name); \
+} while (0)
+
+#endif // TRACE_H
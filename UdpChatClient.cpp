@@ -1,4 +1,7 @@
 #include "UdpChatClient.h"
+#include "FileTransfer.h"
+#include "Affinity.h"
+#include "LowLatency.h"
 #include "UdpCommandBuilder.h"
 #include "MessageUdp.h"
 #include "InputHandler.h"
@@ -10,63 +13,65 @@
 #include <unordered_set>
 #include <algorithm>
 #include "debug.h"
+#include "LatencyHistogram.h"
+#include "Stats.h"
+#include "WireCapture.h"
+#include "Trace.h"
+#include "SessionMemory.h"
+#include <cerrno>
 #include <netdb.h>
+#include <poll.h>
 // Constructor for initializing the UDP client with the server address and port
-// It also initializes the sockfd to -1, nextMessageId to 0, and displayName to an empty string
+// The socket is created later in connectToServer(), nextMessageId starts at 0 and displayName is empty
 UdpChatClient::UdpChatClient(const std::string& server, int port, int timeoutMs, int retries)
     : serverAddress(server),
       serverPort(port),
-      sockfd(-1),
+      clock(Clock::system()),
       nextMessageId(0),
       displayName(""),
       timeoutMs(timeoutMs),
       maxRetries(retries) {
+    inFlightGaugeId = registerStatGauge("ipk25_in_flight_messages", "Sent UDP messages waiting for CONFIRM.",
+                                        [this]() { return inFlightCount.load(std::memory_order_relaxed); });
 }
-int totalRetransmissions = 0;  
 
-// Destructor to clean up resources by closing the socket if it is open
+// Constructor used by the simulator: the socket, the server address and the clock are injected,
+// so connectToServer() must not be called
+UdpChatClient::UdpChatClient(std::unique_ptr<DatagramSocket> socket, const sockaddr_in& server,
+                             Clock& clock, int timeoutMs, int retries)
+    : serverPort(ntohs(server.sin_port)),
+      socket(std::move(socket)),
+      clock(clock),
+      nextMessageId(0),
+      displayName(""),
+      timeoutMs(timeoutMs),
+      maxRetries(retries),
+      resolvedAddr(server) {
+    setServerAddr(server);
+    inFlightGaugeId = registerStatGauge("ipk25_in_flight_messages", "Sent UDP messages waiting for CONFIRM.",
+                                        [this]() { return inFlightCount.load(std::memory_order_relaxed); });
+}
+std::atomic<int> totalRetransmissions{0};
+
+// Destructor, the socket is closed by its owner object
 UdpChatClient::~UdpChatClient() {
-    if (sockfd != -1) {
-        close(sockfd);  // Close the socket if it's open
-    }
+    unregisterStatGauge(inFlightGaugeId);
+    unregisterStatGauge(rttGaugeId);
 }
 
 // Binds the UDP socket to a local address and port
 // This allows the client to send and receive UDP messages
 bool UdpChatClient::bindSocket() {
-    sockfd = socket(AF_INET, SOCK_DGRAM, 0);  // Create the UDP socket
-    if (sockfd < 0) {
-        perror("ERROR: Unable to create UDP socket");  // If socket creation fails, print an error
-        return false;
-    }
-
-    struct sockaddr_in localAddr;
-    std::memset(&localAddr, 0, sizeof(localAddr));  // Initialize the structure to 0
-    localAddr.sin_family = AF_INET;  // IPv4 address family
-    localAddr.sin_addr.s_addr = INADDR_ANY;  // Accept messages from any address
-    localAddr.sin_port = htons(0);  // Bind to an available port
-
-    // Bind the socket to the local address
-    if (bind(sockfd, (struct sockaddr*)&localAddr, sizeof(localAddr)) < 0) {
-        perror("ERROR: Bind failed");  // If bind fails, print an error and close the socket
-        close(sockfd);
-        sockfd = -1;
-        return false;
-    }
-
-    socklen_t len = sizeof(localAddr);
-    if (getsockname(sockfd, (struct sockaddr*)&localAddr, &len) == 0) {
-       printf_debug("UDP client is using local port: %d", ntohs(localAddr.sin_port));
-     }
-    return true;
+    socket = PosixDatagramSocket::bindAny();
+    return socket != nullptr;
 }
 
 // Resolves the server address from the given string (e.g., IP address or hostname)
-// If the address is valid, it fills the serverAddr structure
+// If the address is valid, it becomes the destination of the datagrams
 bool UdpChatClient::resolveServerAddr() {
-    std::memset(&serverAddr, 0, sizeof(serverAddr));
-    serverAddr.sin_family = AF_INET;
-    serverAddr.sin_port = htons(serverPort);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(serverPort);
 
     struct addrinfo hints{}, *res;
     std::memset(&hints, 0, sizeof(hints));
@@ -80,12 +85,28 @@ bool UdpChatClient::resolveServerAddr() {
     }
 
     struct sockaddr_in* ipv4 = reinterpret_cast<struct sockaddr_in*>(res->ai_addr);
-    serverAddr.sin_addr = ipv4->sin_addr;
+    addr.sin_addr = ipv4->sin_addr;
+    setServerAddr(addr);
+    resolvedAddr = addr;  // Kept for re-establishing the session after an outage
 
     freeaddrinfo(res);  // Always free the result!
     return true;
 }
 
+// A copy of the current destination, valid even if another thread switches it meanwhile
+sockaddr_in UdpChatClient::serverAddr() const {
+    uint64_t endpoint = serverEndpoint.load(std::memory_order_acquire);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = static_cast<uint32_t>(endpoint);  // Both kept in network byte order
+    addr.sin_port = static_cast<uint16_t>(endpoint >> 32);
+    return addr;
+}
+
+void UdpChatClient::setServerAddr(const sockaddr_in& addr) {
+    serverEndpoint.store(static_cast<uint64_t>(addr.sin_port) << 32 | addr.sin_addr.s_addr, std::memory_order_release);
+}
+
 // Connects to the server by binding the socket and resolving the server address
 // It prints a message indicating that the client is ready to send messages
 bool UdpChatClient::connectToServer() {
@@ -105,62 +126,235 @@ bool UdpChatClient::connectToServer() {
 // and handles background threads for receiving and retransmitting.
 void UdpChatClient::run() {
     std::cerr << "UDP client started. Enter a command: " << std::endl;
+    start();
+    Trace::setThreadName("input");
+
+    std::string input;
+    InputLoop inputLoop(wakeup, inputFd, &inputReady, inbox ? inbox->fd() : -1);
+    while (true) {
+        // Read a line from standard input or the batch script (e.g., command or message) or a termination signal
+        InputLoop::Event event = batch ? batch->next(input) : inputLoop.next(input);
+        if (event == InputLoop::Event::END_OF_INPUT) {
+            std::cerr << (batch ? "Batch script ended." : "Stdin closed.") << " Sending BYE and exiting." << std::endl;
+            awaitHeldInput(wakeup);
+            break;
+        }
+        if (event == InputLoop::Event::SIGNAL) {
+            int signal = batch ? batch->lastSignal() : inputLoop.lastSignal();
+            std::cerr << strsignal(signal) << " received. Sending BYE and exiting." << std::endl;
+            break;
+        }
+        if (event == InputLoop::Event::WAKEUP) break;
+        if (event == InputLoop::Event::READY) {
+            releaseHeldInput();  // A REPLY arrived or a request timed out
+            continue;
+        }
+        if (event == InputLoop::Event::SOURCE) {
+            if (!drainInbox()) break;
+            continue;
+        }
+        TRACE_INSTANT("stdin_read");
+
+        if (!submitLine(input)) break;
+    }
 
+    finish();
+}
+
+// Starts the receiver, retransmission and (with --pipeline) the decode and render threads
+void UdpChatClient::start() {
     // Start the thread that continuously receives messages from the server
+    if (pipelined || lowLatency) {
+        socket->setNonBlockingReceive();  // Drained until EAGAIN, or busy-polled
+    }
+    if (pipelined) {
+        renderThread = std::thread(&UdpChatClient::renderLoop, this);
+        decodeThread = std::thread(&UdpChatClient::decodeLoop, this);
+    }
     receiverThread = std::thread(&UdpChatClient::backgroundReceiverLoop, this);
 
     // Start a thread that periodically checks and handles retransmissions
     retransmissionThread = std::thread([this]() {
-        while (running) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));  // Wait before next check
+        Trace::setThreadName("retransmit");
+        // Wait before next check, stop as soon as the client is shutting down
+        while (!wakeup.waitFor(std::chrono::milliseconds(100))) {
             checkRetransmissions();  // Check if any messages need to be resent
         }
     });
 
     running = true;  // Mark the client as running
+}
 
-    std::string input;
-    while (true) {
-        // Read a line from standard input (e.g., command or message)
-        if (!std::getline(std::cin, input)) {
-            std::cerr << "Stdin closed. Sending BYE and exiting." << std::endl;
-            sendByeMessage();
-            break;
-        }
+bool UdpChatClient::submitLine(const std::string& line) {
+    std::lock_guard<std::mutex> lock(inputMutex);
+    handleHeldLocked();
+    // Input entered while an AUTH/JOIN waits for its REPLY is handled after it
+    if (!requests.holdIfPending(line)) handleInputLine(line);
+    return !sessionEnded();
+}
 
-        if (input.empty()) continue;  // Ignore empty input
+bool UdpChatClient::sendChat(std::string_view content) {
+    if (content.empty()) return !sessionEnded();
+    std::lock_guard<std::mutex> lock(inputMutex);
+    handleHeldLocked();
+    std::string message(content);
+    if (!requests.holdIfPending(message, true)) sendMessage(message);
+    return !sessionEnded();
+}
 
-        if (input[0] == '/') {
-            handleCommand(input);
+void UdpChatClient::releaseHeldInput() {
+    std::lock_guard<std::mutex> lock(inputMutex);
+    handleHeldLocked();
+}
+
+// Runs the handlers of finished requests and the input held behind them, until a held /auth or
+// /join opens the next request. inputMutex must be held.
+void UdpChatClient::handleHeldLocked() {
+    requests.runFinished();
+    HeldInput input;
+    while (!sessionEnded() && requests.nextHeld(input)) {
+        if (input.verbatim) {
+            sendMessage(input.text);
         } else {
-            // Input is a regular message to be sent to the channel
-            sendMessage(input);
+            handleInputLine(input.text);
         }
+        requests.runFinished();
+    }
+}
+
+// Tracks an AUTH/JOIN before it is sent, the REPLY may arrive before sendto() returns
+void UdpChatClient::trackRequest(PendingRequest::Kind kind, uint16_t messageId, const std::string& argument) {
+    PendingRequest request;
+    request.kind = kind;
+    request.messageId = messageId;
+    request.argument = argument;
+    request.sentAt = clock.now();
+    request.onDone = [this, kind, argument](const RequestResult& result) { requestDone(kind, argument, result); };
+    requests.add(std::move(request));
+}
+
+// Applies the outcome of an AUTH/JOIN to the session, on the input side
+void UdpChatClient::requestDone(PendingRequest::Kind kind, const std::string& argument, const RequestResult& result) {
+    bool auth = kind == PendingRequest::Kind::AUTH;
+    if (result.status == RequestStatus::TIMEOUT) {
+        events.notice(std::string("ERROR: No REPLY to ") + (auth ? "AUTH" : "JOIN") + " within " +
+                      std::to_string(requests.replyTimeout().count()) + " ms");
+    }
+    if (auth) {
+        if (result.status == RequestStatus::NOK || result.status == RequestStatus::TIMEOUT) {
+            std::lock_guard<std::mutex> lock(sessionMutex);
+            displayName.clear();  // Authentication failed, /auth may be tried again
+            lastAuth.reset();
+        } else if (result.status == RequestStatus::OK) {
+            resendRecovered();
+        }
+        return;
+    }
+    // A JOIN cut off by an outage is joined when the session is replayed
+    if (result.status == RequestStatus::OK || result.status == RequestStatus::CANCELLED) {
+        std::lock_guard<std::mutex> lock(sessionMutex);
+        lastChannel = argument;
+        history.setChannel(lastChannel);
+    }
+}
+
+// Sends the messages the previous run left unconfirmed in the outbox, once authenticated
+void UdpChatClient::resendRecovered() {
+    if (!outbox) return;
+    std::vector<Outbox::Recovered> recovered = outbox->takeRecovered();
+    if (recovered.empty()) return;
+    std::cerr << "Resending " << recovered.size() << " unconfirmed message(s) from the outbox." << std::endl;
+    for (const Outbox::Recovered& entry : recovered) submitMessage(entry.content, entry.ticket);
+}
+
+int UdpChatClient::finish() {
+    shutdownGracefully();
+    return exitStatus();
+}
+
+// Ends the session on a server BYE/ERR or a fatal error: the threads stop and shutdown sends
+// nothing more. Safe from any thread.
+void UdpChatClient::endSession(int status) {
+    if (!markSessionEnded(status)) return;
+    running = false;
+    wakeup.notify();
+}
+
+// Stops accepting input, sends BYE and waits up to the drain timeout until every sent message
+// (BYE included) is confirmed or has given up. Then stops and joins the background threads and
+// reports what was not delivered.
+void UdpChatClient::shutdownGracefully() {
+    stopping = true;
+    bool ended = sessionEnded();  // The server is gone, nothing more to send or wait for
+    auto deadline = std::chrono::steady_clock::now() + (ended ? std::chrono::milliseconds(0) : drainTimeout);
+    size_t unsentPaced = 0;
+    if (scheduler) {
+        unsentPaced = scheduler->flush(deadline);  // Paced messages go out before BYE
+        scheduler->stop();
+    }
+    if (!ended) sendByeMessage();
+
+    size_t unconfirmed = 0;
+    if (!ended) {
+        std::unique_lock<std::mutex> lock(sentMessagesMutex);
+        drainedCv.wait_until(lock, deadline, [this]() { return sentMessages.empty(); });
+        for (const auto& entry : sentMessages) {
+            std::cerr << "Message ID " << entry.first << " (type " << static_cast<int>(entry.second.data[0])
+                      << ") was not confirmed." << std::endl;
+        }
+        unconfirmed = sentMessages.size();
     }
 
     // Cleanup after exit
     running = false;
+    wakeup.notify();
     if (receiverThread.joinable()) receiverThread.join();  // Wait for receiver thread to finish
+    if (decodeThread.joinable()) decodeThread.join();      // Pipeline stages drain their rings first
+    if (renderThread.joinable()) renderThread.join();
     if (retransmissionThread.joinable()) retransmissionThread.join();  // Wait for retransmission thread
+
+    size_t undelivered = unconfirmed + unsentPaced + lostMessages + outageQueue.size();
+    if (undelivered > 0 && !ended) {
+        events.notice("ERROR: " + std::to_string(undelivered) + " message(s) were not delivered");
+        if (batch) batch->fail("undelivered messages");
+    }
 }
 
 
+// Handles one line of user input: a command or a regular message
+void UdpChatClient::handleInputLine(const std::string& input) {
+    if (input.empty()) return;  // Ignore empty input
+
+    if (input[0] == '/') {
+        handleCommand(input);
+    } else {
+        // A script sends as fast as CONFIRMs come back, never more than the window unconfirmed
+        if (batch && !waitForSendWindow(SEND_WINDOW - 1)) return;
+        // Input is a regular message to be sent to the channel
+        sendMessage(input);
+    }
+}
+
 // Handles different commands based on user input
 // It processes commands like /help, /auth, /join, /rename, etc.
 void UdpChatClient::handleCommand(const std::string& input) {
     if (input == "/help") {
         printHelp();  // Show help information for available commands
+    } else if (history.handleCommand(input, events)) {
+        // Local /history or /search, nothing is sent
     } else if (input.rfind("/auth", 0) == 0) {
         handleAuthCommand(input);  // Handle authentication command
     } else if (displayName.empty()) {  // Check if the user is authenticated
-        std::cout << "ERROR: You must authenticate first (/auth) before sending messages." << std::endl;  // Show error if not authenticated
+        events.notice("ERROR: You must authenticate first (/auth) before sending messages.");  // Show error if not authenticated
     } else if (input.rfind("/join", 0) == 0) {
         handleJoinCommand(input);  // Handle join channel command
     } else if (input.rfind("/rename", 0) == 0) {
         handleRenameCommand(input); // Handle rename display name command
+    } else if (input.rfind("/send", 0) == 0) {
+        handleSendCommand(input);  // Stream a file as chat messages
     } else {
         std::cerr << "ERROR: Unknown command: " << input << std::endl;  // Show error for unknown commands
-          std::exit(1); 
+        endSession(EXIT_FAILURE);
     }
 }
 
@@ -168,35 +362,42 @@ void UdpChatClient::handleCommand(const std::string& input) {
 // Print available commands to the user
 // This function displays the list of supported commands for the UDP client
 void UdpChatClient::printHelp() {
-    std::cout << "Supported commands:" << std::endl;
-    std::cout << "  /auth {Username} {Secret} {DisplayName}  - Authenticate user" << std::endl;
-    std::cout << "  /join {ChannelID}                     - Join a channel" << std::endl;
-    std::cout << "  /rename {DisplayName}                  - Change your display name" << std::endl;
-    std::cout << "  /help                                  - Show this help message" << std::endl;
+    events.info("Supported commands:\n"
+                "  /auth {Username} {Secret} {DisplayName}  - Authenticate user\n"
+                "  /join {ChannelID}                     - Join a channel\n"
+                "  /rename {DisplayName}                  - Change your display name\n"
+                "  /send {Path}                           - Send a file as a series of messages\n"
+                "  /history [N]                           - Show the last N messages of the channel\n"
+                "  /search {Text}                         - Show the channel messages containing the text\n"
+                "  /help                                  - Show this help message");
 }
 
 // Handle the authentication command (/auth)
 // This function parses the input, validates it, and sends the authentication message to the server
 void UdpChatClient::handleAuthCommand(const std::string& input) {
     if (!displayName.empty()) {
-        std::cout << "ERROR: You are already authenticated!" << std::endl;
+        events.notice("ERROR: You are already authenticated!");
         return;  // Do not authenticate again
     }
 
     auto authOpt = InputHandler::parseAuthCommand(input);  // Parse the /auth command
     if (authOpt) {
-        this->displayName = authOpt->displayName;  // Set the display name after successful authentication
+        {
+            std::lock_guard<std::mutex> lock(sessionMutex);
+            displayName = authOpt->displayName;  // Cleared again if the AUTH fails
+            lastAuth = authOpt;
+            msgPrefix.rebuild(displayName);
+        }
 
         //  Build the AUTH message
         UdpMessage authMsg = buildAuthUdpMessage(*authOpt, nextMessageId++);
 
         // Send the AUTH message using the reliable sending mechanism
-        sendRawUdpMessage(authMsg);  
+        trackRequest(PendingRequest::Kind::AUTH, authMsg.messageId, authOpt->displayName);
+        sendRawUdpMessage(authMsg);
 
         printf_debug("UDP AUTH message sent.");
-
-        // Wait for the server's REPLY response 
-        receiveServerResponseUDP();
+        // The REPLY is handled by the receiver thread
     } else {
         printf_debug("Invalid /auth command. Correct format: /auth {Username} {Secret} {DisplayName}");
     }
@@ -210,19 +411,24 @@ void UdpChatClient::handleJoinCommand(const std::string& input) {
     auto joinOpt = InputHandler::parseJoinCommand(input);  // Parse the /join command
     if (joinOpt) {
         if (displayName.empty()) {  // Check if the user is authenticated
-            std::cout << "ERROR: You must authenticate first (/auth)." << std::endl;
+            events.notice("ERROR: You must authenticate first (/auth).");
             return;
         }
-        // Build the join message and send it to the server
-        UdpMessage joinMsg = buildJoinUdpMessage(joinOpt.value(), displayName, nextMessageId++);
-        std::vector<uint8_t> buffer = packUdpMessage(joinMsg);
-        ssize_t sentBytes = sendto(sockfd, buffer.data(), buffer.size(), 0, 
-                                   (struct sockaddr*)&serverAddr, sizeof(serverAddr));
-        if (sentBytes < 0) {
-            perror("ERROR: Sending UDP JOIN message failed");
-        } else {
-             printf_debug("UDP JOIN message sent.");
+        {
+            // During an outage the channel is joined when the session is replayed
+            std::lock_guard<std::mutex> lock(sessionMutex);
+            if (outage) {
+                lastChannel = joinOpt.value();
+                history.setChannel(lastChannel);
+                std::cerr << "Server unreachable, the channel will be joined after reconnecting." << std::endl;
+                return;
+            }
         }
+        // Build the join message and send it reliably, the channel is switched by its REPLY
+        UdpMessage joinMsg = buildJoinUdpMessage(joinOpt.value(), displayName, nextMessageId++);
+        trackRequest(PendingRequest::Kind::JOIN, joinMsg.messageId, joinOpt.value());
+        sendRawUdpMessage(joinMsg);
+        printf_debug("UDP JOIN message sent.");
     } else {
           printf_debug("ERROR: Invalid /join command. Correct format: /join {ChannelID}");
     }
@@ -241,73 +447,199 @@ void UdpChatClient::handleRenameCommand(const std::string& input) {
     }
 
     if (displayName.empty()) {
-        std::cout << "ERROR: You must authenticate first (/auth)." << std::endl;
+        events.notice("ERROR: You must authenticate first (/auth).");
         return;
     }
 
-    displayName = newDisplayName;  // Update the display name
+    {
+        std::lock_guard<std::mutex> lock(sessionMutex);
+        displayName = newDisplayName;  // Update the display name
+        msgPrefix.rebuild(displayName);
+    }
     std::cerr << "Display name changed to: " << displayName << std::endl;
     std::cerr << "[DEBUG] New displayName set: " << displayName << std::endl;  // Debugging output
 }
 
+// Handle the send command (/send)
+// The file is split into numbered chunks that are sent with up to a window of them
+// unconfirmed at a time. Returns after every chunk is confirmed or has given up.
+void UdpChatClient::handleSendCommand(const std::string& input) {
+    auto pathOpt = InputHandler::parseSendCommand(input);
+    if (!pathOpt) {
+        events.notice("ERROR: Invalid /send command. Correct format: /send {Path}");
+        return;
+    }
+    FileTransfer transfer(*pathOpt);
+    if (!transfer.open()) {
+        events.notice(transfer.error());
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    int lostBefore = lostMessages;
+    size_t sent = 0;
+    for (; sent < transfer.chunkCount(); ++sent) {
+        if (!waitForSendWindow(transfer.window() - 1)) break;
+        submitMessage(transfer.chunk(sent));
+    }
+    if (sent < transfer.chunkCount()) {
+        events.notice("ERROR: /send interrupted after " + std::to_string(sent) + " of " +
+                      std::to_string(transfer.chunkCount()) + " chunk(s)");
+        return;
+    }
+    // Completion means every chunk was confirmed (or gave up)
+    if (!waitForSendWindow(0)) {
+        events.notice("ERROR: /send interrupted before all chunks were confirmed");
+        return;
+    }
+    size_t failed = static_cast<size_t>(lostMessages - lostBefore);
+    transfer.report(std::chrono::steady_clock::now() - start);
+    if (failed > 0) {
+        events.notice("ERROR: " + std::to_string(failed) + " of " + std::to_string(transfer.chunkCount()) +
+                      " chunk(s) of " + *pathOpt + " were not delivered");
+    }
+}
+
+// Blocks until at most `maxPending` chat messages are queued or waiting for a CONFIRM.
+// Returns false if a termination signal arrived or the client is stopping meanwhile.
+bool UdpChatClient::waitForSendWindow(size_t maxPending) {
+    std::unique_lock<std::mutex> lock(sentMessagesMutex);
+    while (true) {
+        size_t pending = sentMessages.size() + outageQueue.size();
+        if (scheduler) pending += scheduler->queueDepth(SendClass::BULK);
+        if (pending <= maxPending) return true;
+        if (ShutdownSignals::pending() || wakeup.notified()) return false;
+        // Woken by every CONFIRM, the timeout covers the scheduler and outage queues
+        drainedCv.wait_for(lock, std::chrono::milliseconds(50));
+    }
+}
+
 // Send a message to the server
-// If the user is authenticated, this function sends the provided message
+// If the user is authenticated, this function sends the provided message.
+// Content over the protocol limit is sent as several messages.
 void UdpChatClient::sendMessage(const std::string& message) {
     if (displayName.empty()) {  // Check if the user is authenticated
-        std::cout << "ERROR: You must authenticate first (/auth) before sending a message." << std::endl;
+        events.notice("ERROR: You must authenticate first (/auth) before sending a message.");
+        return;
+    }
+    if (message.size() <= MAX_MESSAGE_CONTENT) {
+        submitMessage(message);
         return;
     }
+    for (std::string_view piece : splitMessageContent(message)) {
+        submitMessage(std::string(piece));
+    }
+}
+
+// Hands one chat message to the scheduler or sends it right away. With an outbox it is
+// journaled first, unless it already has a record (recovered from the previous run).
+void UdpChatClient::submitMessage(const std::string& message, uint64_t outboxTicket) {
+    if (outbox && outboxTicket == 0) outboxTicket = outbox->add(message);
+    // With pacing the message is sent later from the scheduler thread
+    if (scheduler) {
+        scheduler->submit(SendClass::BULK,
+                          [this, message, outboxTicket]() { queueOrTransmit(message, outboxTicket); });
+        return;
+    }
+    queueOrTransmit(message, outboxTicket);
+}
+
+// Sends a chat message, or keeps it for the restored session while the server is unreachable
+void UdpChatClient::queueOrTransmit(const std::string& message, uint64_t outboxTicket) {
+    std::lock_guard<std::mutex> lock(sessionMutex);
+    if (outage) {
+        if (!outageQueue.push(message, outboxTicket)) {
+            events.notice("ERROR: outage queue full, message dropped");
+        }
+        return;
+    }
+    transmitMessage(message, outboxTicket);
+}
 
+// Encodes a MSG with the next message ID and sends it reliably, sessionMutex must be held
+void UdpChatClient::transmitMessage(const std::string& message, uint64_t outboxTicket) {
     printf_debug("Sending message as '%s'", displayName.c_str());
-    // Build the message and send it to the server
-    UdpMessage msgMsg = buildMsgUdpMessage(displayName, message, nextMessageId++);
-    sendRawUdpMessage(msgMsg);
+    // Prefix copy plus content, the prefix is only rebuilt when the display name changes
+    uint16_t messageId = nextMessageId++;
+    sendReliable(messageId, msgPrefix.encode(messageId, message), outboxTicket);
 }
 
 
+std::string UdpChatClient::lockedDisplayName() {
+    std::lock_guard<std::mutex> lock(sessionMutex);
+    return displayName;
+}
+
 // Send a BYE message to the server
 // This function is used when the user wants to disconnect from the server
 void UdpChatClient::sendByeMessage() {
-    if (!displayName.empty()) {  // Check if the user is authenticated
+    std::string name = lockedDisplayName();
+    if (!name.empty()) {  // Check if the user is authenticated
         UdpMessage byeMsg;
         byeMsg.type = UdpMessageType::BYE;  // Set the message type to BYE
         byeMsg.messageId = nextMessageId++;  // Assign a unique message ID
-        byeMsg.payload = packString(displayName);  // Pack the display name as the payload
+        std::vector<uint8_t> packed = packString(name);  // Pack the display name as the payload
+        byeMsg.payload.assign(packed.begin(), packed.end());
 
-        std::vector<uint8_t> buffer = packUdpMessage(byeMsg);
         std::cerr << "DEBUG: Sending BYE message with MessageID " << byeMsg.messageId
                   << ", payload size = " << byeMsg.payload.size() << std::endl;
 
-        ssize_t sentBytes = sendto(sockfd, buffer.data(), buffer.size(), 0,
-                                   (struct sockaddr*)&serverAddr, sizeof(serverAddr));
-        if (sentBytes < 0) {
-            perror("ERROR: Sending UDP BYE message failed");
-        } else {
-            std::cerr << "UDP BYE message sent." << std::endl;
-        }
+        // Sent reliably, the shutdown waits for its CONFIRM
+        sendRawUdpMessage(byeMsg);
+        std::cerr << "UDP BYE message sent." << std::endl;
     }
 }
 
 // This function listens for incoming UDP messages and processes them based on their type
-void UdpChatClient::receiveServerResponseUDP() {
-    uint8_t recvBuffer[1024];
+// Returns false if no datagram was received (error, or nothing to read on a non-blocking socket)
+bool UdpChatClient::receiveServerResponseUDP() {
+    uint8_t recvBuffer[65536];  // Any UDP datagram fits, MSG content may be up to 60000 bytes
     struct sockaddr_in fromAddr;
-    socklen_t addrLen = sizeof(fromAddr);
     
     // Receive a message from the server
- ssize_t bytesReceived = recvfrom(sockfd, recvBuffer, sizeof(recvBuffer), 0,
-                                     (struct sockaddr*)&fromAddr, &addrLen);
+    ssize_t bytesReceived = socket->recvFrom(recvBuffer, sizeof(recvBuffer), fromAddr);
     if (bytesReceived <= 0) {
+        if (bytesReceived < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return false;  // Nothing to read yet
+        }
+        statAdd(threadCounters().receiveErrors);
         std::cerr << "Error receiving message!" << std::endl;
-        return;
+        return false;
+    }
+    auto receivedAt = clock.now();
+    TRACE_INSTANT("receive");
+    statMessageReceived(statKindFromUdpType(recvBuffer[0]), static_cast<size_t>(bytesReceived));
+    captureWire(CaptureDirection::INBOUND, CaptureTransport::UDP, recvBuffer, static_cast<size_t>(bytesReceived));
+
+    if (pipelined) {
+        // Confirm right away, the protocol logic runs on the decode thread
+        confirmInReceiveStage(recvBuffer, static_cast<size_t>(bytesReceived), fromAddr);
+        InboundDatagram datagram{WireBuffer::copyOf(recvBuffer, static_cast<size_t>(bytesReceived)), fromAddr, receivedAt};
+        while (!decodeRing->tryPush(std::move(datagram))) {
+            std::this_thread::yield();  // Decode stage is behind, the socket buffer absorbs the rest
+        }
+        decodeBell.ring();
+        return true;
     }
 
-    std::vector<uint8_t> data(recvBuffer, recvBuffer + bytesReceived);
-    UdpMessage receivedMsg;
+    lastReceiveTime = receivedAt;
+    dispatchDatagram(recvBuffer, static_cast<size_t>(bytesReceived), fromAddr);
+    return true;
+}
+
+// Unpacks one datagram and runs the handler for its type
+void UdpChatClient::dispatchDatagram(const uint8_t* bytes, size_t length, const sockaddr_in& fromAddr) {
+    if (sessionEnded()) return;  // Nothing is processed after BYE or ERR from the server
+
+    // The payload lives in the scratch arena and is dropped with it when the datagram is done
+    ScratchArena scratch;
+    UdpMessage receivedMsg{UdpMessageType::CONFIRM, 0, std::pmr::vector<uint8_t>(scratch.resource())};
 
     // Unpack the received UDP message
-    if (unpackUdpMessage(data, receivedMsg)) {
+    if (unpackUdpMessage(bytes, length, receivedMsg)) {
+        liveness.heard(lastReceiveTime);
         // Process the message based on its type
+        TRACE_SCOPE("dispatch");
         switch (receivedMsg.type) {
             case UdpMessageType::REPLY:
                 processReplyMessage(receivedMsg, fromAddr);  // Handle REPLY message
@@ -331,10 +663,11 @@ void UdpChatClient::receiveServerResponseUDP() {
                  processPingMessage(receivedMsg);  
                  break;
 
-   default:
-    std::cout << "ERROR: Unknown message type: " << static_cast<int>(receivedMsg.type) << std::endl;
+   default: {
+    emitOutput({OutputEvent::Kind::TEXT, "", std::pmr::string("ERROR: Unknown message type: " + std::to_string(static_cast<int>(receivedMsg.type))), lastReceiveTime});
 
     // Send CONFIRM for unknown message type
+    if (!pipelined) {
     UdpMessage confirmMsg;
     confirmMsg.type = UdpMessageType::CONFIRM;
     confirmMsg.messageId = 0;
@@ -344,16 +677,17 @@ void UdpChatClient::receiveServerResponseUDP() {
     std::memcpy(confirmMsg.payload.data(), &netId, sizeof(uint16_t));
 
     std::vector<uint8_t> confirmBuf = packUdpMessage(confirmMsg);
-    sendto(sockfd, confirmBuf.data(), confirmBuf.size(), 0,
-           (struct sockaddr*)&fromAddr, sizeof(fromAddr));
+    sendControl(confirmBuf, fromAddr);
     std::cerr << "UDP CONFIRM message sent for unknown message type." << std::endl;
+    }
 
     // Build and send ERR message
     UdpMessage errMsg;
     errMsg.type = UdpMessageType::ERR;
     errMsg.messageId = nextMessageId++;
 
-    std::string errSender = displayName.empty() ? "client" : displayName;
+    std::string errSender = lockedDisplayName();
+    if (errSender.empty()) errSender = "client";
     std::string errorMsg = "Unknown message type: " + std::to_string(static_cast<int>(receivedMsg.type));
 
     errMsg.payload.insert(errMsg.payload.end(), errSender.begin(), errSender.end());
@@ -362,17 +696,11 @@ void UdpChatClient::receiveServerResponseUDP() {
     errMsg.payload.push_back('\0');
 
     std::vector<uint8_t> errBuf = packUdpMessage(errMsg);
-    ssize_t errSent = sendto(sockfd, errBuf.data(), errBuf.size(), 0,
-                             (struct sockaddr*)&serverAddr, sizeof(serverAddr));
-
-    if (errSent < 0) {
-        perror("ERROR: Sending ERR message for unknown type failed");
-    } else {
-        std::cerr << "ERR message sent for unknown message type." << std::endl;
-    }
+    sendControl(errBuf, serverAddr());
+    std::cerr << "ERR message sent for unknown message type." << std::endl;
 
     break;
-
+   }
 
         }
     }
@@ -388,17 +716,17 @@ void UdpChatClient::processErrMessage(const UdpMessage& errMsg) {
     }
 
     // Convert payload to a string
-    std::string errorContent(errMsg.payload.begin(), errMsg.payload.end());
+    std::pmr::string errorContent(errMsg.payload.begin(), errMsg.payload.end());
 
     // Extract the first null byte position
     size_t firstNullPos = errorContent.find('\0');
     if (firstNullPos != std::string::npos) {
-        std::cout << "ERROR FROM " << errorContent.substr(0, firstNullPos) << ": ";
-        
         // Extract the second null byte position and print error message
         size_t secondNullPos = errorContent.find('\0', firstNullPos + 1);
         if (secondNullPos != std::string::npos) {
-            std::cout << errorContent.substr(firstNullPos + 1, secondNullPos - firstNullPos - 1) << std::endl;
+            emitOutput({OutputEvent::Kind::ERR, errorContent.substr(0, firstNullPos),
+                        errorContent.substr(firstNullPos + 1, secondNullPos - firstNullPos - 1), lastReceiveTime,
+                        errMsg.messageId});
         } else {
             std::cerr << "Error: Could not find the second null byte!" << std::endl;
         }
@@ -415,25 +743,26 @@ void UdpChatClient::processErrMessage(const UdpMessage& errMsg) {
     }
     std::cerr << std::dec << std::endl; // Switch back to decimal output
 
-    // Send a dynamic CONFIRM message with the message ID
-    UdpMessage confirmMsg;
-    confirmMsg.type = UdpMessageType::CONFIRM;
-    confirmMsg.messageId = 0;  
-    confirmMsg.payload.resize(sizeof(uint16_t));
-    uint16_t netRefId = htons(errMsg.messageId);  // Network byte order
-    std::memcpy(confirmMsg.payload.data(), &netRefId, sizeof(uint16_t));
-
-    std::vector<uint8_t> buffer = packUdpMessage(confirmMsg);
-    ssize_t sentBytes = sendto(sockfd, buffer.data(), buffer.size(), 0,
-                               (struct sockaddr*)&serverAddr, sizeof(serverAddr));
-    if (sentBytes < 0) {
-        perror("ERROR: Sending UDP CONFIRM message failed");
-    } else {
-        std::cerr << "UDP CONFIRM message sent." << std::endl;
+    // Send a dynamic CONFIRM message with the message ID (the receive stage already did in pipeline mode)
+    if (!pipelined) {
+        UdpMessage confirmMsg;
+        confirmMsg.type = UdpMessageType::CONFIRM;
+        confirmMsg.messageId = 0;
+        confirmMsg.payload.resize(sizeof(uint16_t));
+        uint16_t netRefId = htons(errMsg.messageId);  // Network byte order
+        std::memcpy(confirmMsg.payload.data(), &netRefId, sizeof(uint16_t));
+
+        std::vector<uint8_t> buffer = packUdpMessage(confirmMsg);
+        ssize_t sentBytes = sendDatagram(buffer, serverAddr());
+        if (sentBytes < 0) {
+            perror("ERROR: Sending UDP CONFIRM message failed");
+        } else {
+            std::cerr << "UDP CONFIRM message sent." << std::endl;
+        }
     }
 
-    // Exit the application after processing the error
-    std::exit(EXIT_FAILURE);
+    // The session ends after processing the error
+    endSession(EXIT_FAILURE);
 }
 
 // Process the reply message (REPLY)
@@ -445,21 +774,35 @@ void UdpChatClient::processReplyMessage(const UdpMessage& replyMsg, const sockad
     }
 
     uint8_t result = replyMsg.payload[0];  // Result: 1 for success, 0 for failure
+    uint16_t refId = static_cast<uint16_t>((replyMsg.payload[1] << 8) | replyMsg.payload[2]);
     std::string content(replyMsg.payload.begin() + 3, replyMsg.payload.end());  // Message content
+    if (!content.empty() && content.back() == '\0') content.pop_back();      // Without the terminator
 
-    serverAddr = fromAddr;
+    setServerAddr(fromAddr);
 
-    // Handle success or failure based on the result
-    if (result == 1) {
-        std::cout << "Action Success: " << content << std::endl;
+    // Handle success or failure based on the result (replies to replayed requests are handled separately)
+    if (reconnectPolicy.enabled && handleResyncReply(refId, result == 1, content)) {
+        // Session replay in progress, nothing to show to the user
+    } else if (auto waited = requests.completeById(refId, result == 1, content, clock.now())) {
+        latencyMetrics().replyLatency.record(*waited);
+        if (result == 1) {
+            emitOutput({OutputEvent::Kind::REPLY_SUCCESS, "", std::pmr::string(content), lastReceiveTime,
+                        replyMsg.messageId, refId});
 
-        if (content == "Joined default.") {
-            std::cerr << "Authentication successful. Joining default channel..." << std::endl;
+            if (content == "Joined default.") {
+                std::cerr << "Authentication successful. Joining default channel..." << std::endl;
+            }
+        } else {
+            emitOutput({OutputEvent::Kind::REPLY_FAILURE, "", std::pmr::string(content), lastReceiveTime,
+                        replyMsg.messageId, refId});
         }
+        // The input side applies the result and sends what was held behind the request
+        inputReady.notify();
     } else {
-        std::cout << "Action Failure: " << content << std::endl;
-        displayName.clear();  // Authentication failed, clear display name
+        std::cerr << "Ignoring REPLY to unknown request " << refId << std::endl;
     }
+    if (pipelined) return;  // Confirmed by the receive stage
+
     // Debugging: Print the message ID and prepare the CONFIRM message
     std::cerr << "[DEBUG] Sending CONFIRM for REPLY (messageId: " << replyMsg.messageId << ")" << std::endl;
 
@@ -472,7 +815,7 @@ void UdpChatClient::processReplyMessage(const UdpMessage& replyMsg, const sockad
     }
     std::cerr << std::dec << std::endl;
 
-    sendto(sockfd, buffer.data(), buffer.size(), 0, (struct sockaddr*)&serverAddr, sizeof(serverAddr));
+    sendControl(buffer, serverAddr());
 }
 
 // Process the message (MSG) received from the server
@@ -480,141 +823,521 @@ void UdpChatClient::processMsgMessage(const UdpMessage& msgMsg) {
     if (msgMsg.payload.empty()) return;
 
     // Duplikáty
-    if (receivedMsgIds.count(msgMsg.messageId)) {
-        printf_debug("Duplicate MSG message received (ID %d), sending CONFIRM only", msgMsg.messageId);
+    if (receivedMsgIds.test(msgMsg.messageId)) {
+        if (!lowLatency) printf_debug("Duplicate MSG message received (ID %d), sending CONFIRM only", msgMsg.messageId);
+        statAdd(threadCounters().duplicatesDropped);
     } else {
-        receivedMsgIds.insert(msgMsg.messageId);
+        receivedMsgIds.set(msgMsg.messageId);
 
         auto it = std::find(msgMsg.payload.begin(), msgMsg.payload.end(), '\0');
         if (it == msgMsg.payload.end()) return; // není odděleno
 
-        std::string displayName(msgMsg.payload.begin(), it);
-        std::string content(it + 1, msgMsg.payload.end());
+        std::pmr::string displayName(msgMsg.payload.begin(), it);
+        auto end = std::find(it + 1, msgMsg.payload.end(), '\0');  // Content is null-terminated
+        std::pmr::string content(it + 1, end);
 
-        std::cout << displayName << ": " << content << std::endl;
-        printf_debug("Received MSG message: %s", content.c_str());
+        if (!lowLatency) printf_debug("Received MSG message: %s", content.c_str());
+        history.record(displayName, content, lastReceiveTime);
+        emitOutput({OutputEvent::Kind::MSG, std::move(displayName), std::move(content), lastReceiveTime,
+                    msgMsg.messageId});
     }
+    if (pipelined) return;  // Confirmed by the receive stage
 
-    // Prepare the CONFIRM message and send it back
-    UdpMessage confirmMsg = buildConfirmUdpMessage(msgMsg.messageId);
-    std::vector<uint8_t> buffer = packUdpMessage(confirmMsg);
-    sendto(sockfd, buffer.data(), buffer.size(), 0, (struct sockaddr*)&serverAddr, sizeof(serverAddr));
-    std::cerr << "UDP CONFIRM message sent." << std::endl;
+    // Send the CONFIRM back
+    sendConfirm(msgMsg.messageId, serverAddr());
+    if (!lowLatency) std::cerr << "UDP CONFIRM message sent." << std::endl;
 }
 
 // Process the CONFIRM message received from the server
 void UdpChatClient::processConfirmMessage(const UdpMessage& confirmMsg) {
-    std::cerr << "Received CONFIRM message from server (RefID: " << confirmMsg.messageId << ")." << std::endl;
-    sentMessages.erase(confirmMsg.messageId);
+    TRACE_SCOPE("confirm_match");
+    if (!lowLatency) {
+        std::cerr << "Received CONFIRM message from server (RefID: " << confirmMsg.messageId << ")." << std::endl;
+    }
+    liveness.confirmed(confirmMsg.messageId, lastReceiveTime);
+
+    std::chrono::steady_clock::duration rtt;
+    uint64_t outboxTicket;
+    {
+        std::lock_guard<std::mutex> lock(sentMessagesMutex);
+        auto it = sentMessages.find(confirmMsg.messageId);
+        if (it == sentMessages.end()) return;
+        outboxTicket = it->second.outboxTicket;
+        // Tag the RTT sample with the number of retransmissions the message needed
+        int attempt = std::min(it->second.retryCount, CONFIRM_RTT_ATTEMPTS - 1);
+        rtt = lastReceiveTime - it->second.firstSentTime;
+        latencyMetrics().confirmRtt[attempt].record(rtt);
+        if (it->second.retryCount == 0) liveness.rttSample(rtt);
+        sentMessages.erase(it);
+        inFlightCount.fetch_sub(1, std::memory_order_relaxed);
+        drainedCv.notify_all();
+    }
+    if (outbox) outbox->done(outboxTicket);
+    events.confirmed(confirmMsg.messageId, lastReceiveTime, rtt);
 }
 
-// Send a PING message to the server
-void UdpChatClient::sendPingMessage() {
-    UdpMessage pingMsg;
-    pingMsg.type = UdpMessageType::PING;  // Set message type to PING
-    pingMsg.messageId = nextMessageId++;  // Assign a new message ID
-    pingMsg.payload.clear();  // PING message has no payload
-
-    std::vector<uint8_t> buffer = packUdpMessage(pingMsg);
-    ssize_t sentBytes = sendto(sockfd, buffer.data(), buffer.size(), 0, 
-                               (struct sockaddr*)&serverAddr, sizeof(serverAddr));
-    if (sentBytes < 0) {
-        perror("ERROR: Sending UDP PING message failed");
-    } else {
-        std::cerr << "UDP PING message sent." << std::endl;
-    }
+// Sends a PING probe to the server (--keepalive) ahead of queued chat messages. It is not
+// retransmitted, checkLiveness() sends the next probe while the server stays silent.
+void UdpChatClient::sendPingMessage(uint16_t messageId) {
+    uint8_t ping[3] = {static_cast<uint8_t>(UdpMessageType::PING), static_cast<uint8_t>(messageId >> 8),
+                       static_cast<uint8_t>(messageId & 0xFF)};
+    sendControl(ping, sizeof(ping), serverAddr());
+    printf_debug("PING probe sent with MessageID %d", messageId);
 }
 
 // Handles a PING message from the server and sends a CONFIRM response.
 void UdpChatClient::processPingMessage(const UdpMessage& pingMsg) {
     printf_debug("Received PING message from server.");
+    if (pipelined) return;  // Confirmed by the receive stage
 
-    // Build a CONFIRM message referencing the received PING's message ID
-    UdpMessage confirmMsg;
-    confirmMsg.type = UdpMessageType::CONFIRM;
-    confirmMsg.messageId = 0;  // CONFIRM messages do not carry their own IDs
-    confirmMsg.payload.resize(sizeof(uint16_t));
-
-    // Insert the received message ID (in network byte order) into the payload
-    uint16_t netRefId = htons(pingMsg.messageId);
-    std::memcpy(confirmMsg.payload.data(), &netRefId, sizeof(uint16_t));
-
-    // Pack and send the CONFIRM message to the server
-    std::vector<uint8_t> buffer = packUdpMessage(confirmMsg);
-    ssize_t sentBytes = sendto(sockfd, buffer.data(), buffer.size(), 0,
-                               (struct sockaddr*)&serverAddr, sizeof(serverAddr));
-    if (sentBytes < 0) {
-        perror("ERROR: Sending CONFIRM message for PING failed");
-    } else {
-        printf_debug("CONFIRM message for PING sent.");
-    }
+    // Send a CONFIRM referencing the received PING's message ID
+    sendConfirm(pingMsg.messageId, serverAddr());
+    printf_debug("CONFIRM message for PING sent.");
 }
 
 // Handles a BYE message from the server and shuts down the client gracefully.
 void UdpChatClient::processByeMessage(const UdpMessage& byeMsg) {
     std::cerr << "Received BYE message from server. Terminating client." << std::endl;
+    if (events.onRecord) emitOutput({OutputEvent::Kind::BYE, "", "", lastReceiveTime, byeMsg.messageId});
 
-    // Build and send CONFIRM message in response to BYE
-    UdpMessage confirmMsg = buildConfirmUdpMessage(byeMsg.messageId);
-    std::vector<uint8_t> buffer = packUdpMessage(confirmMsg);
-    sendto(sockfd, buffer.data(), buffer.size(), 0, (struct sockaddr*)&serverAddr, sizeof(serverAddr));
+    // Build and send CONFIRM message in response to BYE (the receive stage already did in pipeline mode)
+    if (!pipelined) {
+        UdpMessage confirmMsg = buildConfirmUdpMessage(byeMsg.messageId);
+        std::vector<uint8_t> buffer = packUdpMessage(confirmMsg);
+        sendDatagram(buffer, serverAddr());
+    }
 
-    std::exit(EXIT_SUCCESS);  // Exit the application cleanly
+    endSession(EXIT_SUCCESS);  // Shut down cleanly
 }
 
 // Continuously receives and processes UDP messages in a background thread while running is true.
 void UdpChatClient::backgroundReceiverLoop() {
-    while (running) {
-        receiveServerResponseUDP();  // Listen for and handle incoming server messages
+    Trace::setThreadName("receiver");
+    if (pipelined) pinCurrentThread(stageCpu(0), "receive");
+    if (lowLatency) {
+        // Spin on the non-blocking socket, the thread never sleeps in the kernel and a datagram
+        // is picked up as soon as it lands. Shutdown clears `running` before the wakeup.
+        if (!pipelined || stageCpu(0) < 0) pinCurrentThread(spinCpu, "receiver");
+        prefaultStack();
+        while (running) {
+            if (!receiveServerResponseUDP()) cpuRelax();
+        }
+    }
+    pollfd fds[2] = {
+        {wakeup.fd(), POLLIN, 0},
+        {socket->fd(), POLLIN, 0},
+    };
+    while (running && !lowLatency) {
+        // Wait for a datagram or for the shutdown wakeup
+        if (poll(fds, 2, -1) == -1 && errno != EINTR) break;
+        if (fds[0].revents & POLLIN) break;
+        if (fds[1].revents & POLLIN) {
+            if (pipelined) {
+                // Drain everything queued in the socket before polling again
+                while (running && receiveServerResponseUDP()) {
+                }
+            } else {
+                receiveServerResponseUDP();  // Listen for and handle incoming server messages
+            }
+        }
+    }
+    if (pipelined) {
+        receiveStageDone.store(true, std::memory_order_release);
+        decodeBell.ring();
     }
 }
 
+// Receive stage: sends the CONFIRM for every datagram except CONFIRM itself (duplicates are
+// confirmed again, exactly like the inline path does)
+void UdpChatClient::confirmInReceiveStage(const uint8_t* data, size_t length, const sockaddr_in& fromAddr) {
+    if (length < 3 || data[0] == static_cast<uint8_t>(UdpMessageType::CONFIRM)) return;
+    uint8_t confirm[3] = {static_cast<uint8_t>(UdpMessageType::CONFIRM), data[1], data[2]};
+    sendControl(confirm, sizeof(confirm), fromAddr);
+}
+
+// Decode stage: runs the protocol logic for the datagrams handed over by the receive stage
+void UdpChatClient::decodeLoop() {
+    Trace::setThreadName("decode");
+    pinCurrentThread(stageCpu(1), "decode");
+    InboundDatagram datagram;
+    while (true) {
+        if (decodeRing->tryPop(datagram)) {
+            lastReceiveTime = datagram.receivedAt;
+            dispatchDatagram(datagram.bytes.data(), datagram.bytes.size(), datagram.from);
+            datagram.bytes = WireBuffer();  // Back to the pool right away
+            continue;
+        }
+        // The receive stage pushes nothing after setting the flag, so an empty ring is final
+        if (receiveStageDone.load(std::memory_order_acquire) && decodeRing->empty()) break;
+        decodeBell.wait([this]() { return !decodeRing->empty() || receiveStageDone.load(std::memory_order_acquire); },
+                        std::chrono::milliseconds(100));
+    }
+    decodeStageDone.store(true, std::memory_order_release);
+    renderBell.ring();
+}
+
+// Render stage: formats and writes the output lines
+void UdpChatClient::renderLoop() {
+    Trace::setThreadName("render");
+    pinCurrentThread(stageCpu(2), "render");
+    OutputEvent event;
+    while (true) {
+        if (renderRing->tryPop(event)) {
+            renderOutput(event);
+            continue;
+        }
+        if (decodeStageDone.load(std::memory_order_acquire) && renderRing->empty()) break;
+        renderBell.wait([this]() { return !renderRing->empty() || decodeStageDone.load(std::memory_order_acquire); },
+                        std::chrono::milliseconds(100));
+    }
+}
+
+// Hands an output line to the render stage, or writes it directly without the pipeline
+void UdpChatClient::emitOutput(OutputEvent&& event) {
+    if (!pipelined) {
+        renderOutput(event);
+        return;
+    }
+    while (!renderRing->tryPush(std::move(event))) {
+        std::this_thread::yield();  // Terminal is slower than the network
+    }
+    renderBell.ring();
+}
+
+void UdpChatClient::renderOutput(const OutputEvent& event) {
+    TRACE_SCOPE("output");
+    switch (event.kind) {
+        case OutputEvent::Kind::MSG:
+            events.message(event.from, event.content, event.receivedAt, event.messageId);
+            latencyMetrics().deliveryLatency.record(clock.now() - event.receivedAt);
+            break;
+        case OutputEvent::Kind::REPLY_SUCCESS:
+            events.reply(true, event.content, event.receivedAt, event.messageId, event.refId);
+            break;
+        case OutputEvent::Kind::REPLY_FAILURE:
+            events.reply(false, event.content, event.receivedAt, event.messageId, event.refId);
+            break;
+        case OutputEvent::Kind::ERR:
+            events.error(event.from, event.content, event.receivedAt, event.messageId);
+            break;
+        case OutputEvent::Kind::BYE:
+            events.bye(event.receivedAt, event.messageId);
+            break;
+        case OutputEvent::Kind::TEXT:
+            events.notice(event.content);
+            break;
+    }
+}
+
+void UdpChatClient::setPipeline(const std::vector<int>& cpus) {
+    pipelined = true;
+    stageCpus = cpus;
+    decodeRing = std::make_unique<SpscRing<InboundDatagram>>(4096);
+    renderRing = std::make_unique<SpscRing<OutputEvent>>(4096);
+}
+
 // Checks all unconfirmed messages and retransmits them if the timeout has expired.
 void UdpChatClient::checkRetransmissions() {
-    auto now = std::chrono::steady_clock::now();
+    auto now = clock.now();
+    bool serverLost = false;
+    std::unique_lock<std::mutex> lock(sentMessagesMutex);
 
     for (auto it = sentMessages.begin(); it != sentMessages.end(); ) {
         auto& msg = it->second;
         auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - msg.timestamp);
 
-        printf_debug("Checking message ID %d: elapsed = %ld ms", msg.messageId, elapsed.count());
+        if (!lowLatency) printf_debug("Checking message ID %d: elapsed = %ld ms", msg.messageId, elapsed.count());
 
         if (elapsed.count() >= timeoutMs) {
+            if (msg.retryCount >= maxRetries && reconnectPolicy.enabled && !stopping) {
+                serverLost = true;  // Keep the message, beginOutage() requeues it
+                break;
+            }
             if (msg.retryCount >= maxRetries) {
-                std::cout << "ERROR: Confirmation not received for message ID " << msg.messageId << std::endl;
+                // Its outbox record stays pending, the next run sends it again
+                events.notice("ERROR: Confirmation not received for message ID " + std::to_string(msg.messageId));
                 it = sentMessages.erase(it);  // Drop the message if max retries exceeded
+                inFlightCount.fetch_sub(1, std::memory_order_relaxed);
+                lostMessages++;
+                drainedCv.notify_all();
                 continue;
             }
 
             // Retransmit the message
             printf_debug("[RETRANS] Resending message ID %d", msg.messageId);
-            sendto(sockfd, msg.data.data(), msg.data.size(), 0,
-                   (struct sockaddr*)&serverAddr, sizeof(serverAddr));
+            sendDatagram(msg.data, serverAddr());
             msg.timestamp = now;
             totalRetransmissions++;
+            statAdd(threadCounters().retransmissions);
             msg.retryCount++;
+            events.retransmitted(msg.messageId, msg.retryCount, now);
         }
 
         ++it;
     }
+    lock.unlock();
+
+    if (reconnectPolicy.enabled && !stopping) {
+        if (serverLost) beginOutage();
+        tryResync();
+    }
+    if (requests.pending() && requests.expire(clock.now()) > 0) {
+        inputReady.notify();
+    }
+    checkLiveness();
+}
+
+void UdpChatClient::setLiveness(const LivenessPolicy& policy) {
+    liveness.configure(policy, std::chrono::milliseconds(timeoutMs));
+    if (policy.enabled && rttGaugeId < 0) {
+        rttGaugeId = registerStatGauge("ipk25_server_rtt_us", "Smoothed round-trip time to the server in microseconds.",
+                                       [this]() { return static_cast<int64_t>(liveness.srtt().count()); });
+    }
+}
+
+// Probes an idle server and handles a dead one: with --reconnect the session is replayed,
+// otherwise it ends with an error. Runs on the retransmission thread.
+void UdpChatClient::checkLiveness() {
+    if (!liveness.enabled() || stopping || sessionEnded()) return;
+    {
+        std::lock_guard<std::mutex> lock(sessionMutex);
+        if (outage) return;  // The resync has its own backoff
+    }
+    auto now = clock.now();
+    if (liveness.dead(now)) {
+        liveness.restart();
+        std::cerr << "No message from the server for " << liveness.deadAfter().count()
+                  << " ms, declaring it dead." << std::endl;
+        events.serverLost();
+        if (reconnectPolicy.enabled) {
+            beginOutage();
+            return;
+        }
+        events.notice("ERROR: Server not responding");
+        endSession(EXIT_FAILURE);
+        return;
+    }
+    if (liveness.probeDue(now)) {
+        uint16_t probeId = nextMessageId++;
+        liveness.probed(now, probeId);  // Before sending, the CONFIRM may come back at once
+        sendPingMessage(probeId);
+    }
+}
+
+void UdpChatClient::setReconnectPolicy(const ReconnectPolicy& policy) {
+    reconnectPolicy = policy;
+    backoff = Backoff(policy);
+    outageQueue.setCapacity(policy.queueLimit);
+}
+
+bool UdpChatClient::setBatchScript(const std::string& path) {
+    batch = std::make_unique<BatchScript>(path, requests, wakeup, inputReady, events);
+    return batch->open();
+}
+
+// Extracts the user text from a packed MSG datagram, empty for other message types
+static std::string msgContentOf(const WireBuffer& buffer) {
+    std::vector<uint8_t> data(buffer.data(), buffer.data() + buffer.size());
+    UdpMessage msg;
+    if (!unpackUdpMessage(data, msg) || msg.type != UdpMessageType::MSG) return "";
+    auto separator = std::find(msg.payload.begin(), msg.payload.end(), '\0');
+    if (separator == msg.payload.end()) return "";
+    auto end = std::find(separator + 1, msg.payload.end(), '\0');
+    return std::string(separator + 1, end);
+}
+
+// Called when a message exhausted its retries: stops tracking everything in flight, moves the
+// unconfirmed user messages (in send order) to the outage queue and schedules a session replay
+void UdpChatClient::beginOutage() {
+    std::vector<std::tuple<std::chrono::steady_clock::time_point, std::string, uint64_t>> unconfirmed;
+    {
+        std::lock_guard<std::mutex> lock(sentMessagesMutex);
+        for (const auto& entry : sentMessages) {
+            std::string content = msgContentOf(entry.second.data);
+            if (!content.empty()) {
+                unconfirmed.emplace_back(entry.second.firstSentTime, content, entry.second.outboxTicket);
+            }
+        }
+        sentMessages.clear();
+        inFlightCount.store(0, std::memory_order_relaxed);
+        drainedCv.notify_all();
+    }
+    std::sort(unconfirmed.begin(), unconfirmed.end(),
+              [](const auto& a, const auto& b) { return std::get<0>(a) < std::get<0>(b); });
+    std::vector<std::string> requeue;
+    std::vector<uint64_t> tickets;
+    for (auto& entry : unconfirmed) {
+        requeue.push_back(std::move(std::get<1>(entry)));
+        tickets.push_back(std::get<2>(entry));
+    }
+    outageQueue.pushFront(requeue, tickets);
+
+    std::lock_guard<std::mutex> lock(sessionMutex);
+    if (!outage) {
+        std::cerr << "Server not responding, holding messages until the session is restored." << std::endl;
+    }
+    outage = true;
+    resyncState = Resync::NONE;
+    if (requests.cancelAll(clock.now()) > 0) inputReady.notify();
+    nextResyncAttempt = clock.now() + backoff.next();
+}
+
+// Starts a session replay when the backoff delay of an outage has passed
+void UdpChatClient::tryResync() {
+    std::lock_guard<std::mutex> lock(sessionMutex);
+    if (!outage || resyncState != Resync::NONE || clock.now() < nextResyncAttempt) return;
+
+    // The server may have restarted, begin again at the well-known port
+    setServerAddr(resolvedAddr);
+    if (!lastAuth) {
+        finishResyncLocked();  // Never authenticated, nothing to replay
+        return;
+    }
+    printf_debug("Replaying AUTH, attempt %d", backoff.attempts());
+    AuthCommand auth = *lastAuth;
+    auth.displayName = displayName;
+    UdpMessage authMsg = buildAuthUdpMessage(auth, nextMessageId++);
+    resyncRequestId = authMsg.messageId;
+    resyncState = Resync::AUTH;
+    sendRawUdpMessage(authMsg);
+}
+
+// Handles the REPLY to a replayed AUTH or JOIN. Returns false if it answers something else.
+bool UdpChatClient::handleResyncReply(uint16_t refId, bool ok, const std::string& content) {
+    std::lock_guard<std::mutex> lock(sessionMutex);
+    if (resyncState == Resync::NONE || refId != resyncRequestId) return false;
+
+    if (resyncState == Resync::AUTH) {
+        if (!ok) {
+            events.reply(false, content);
+            events.notice("ERROR: session could not be re-established");
+            endSession(EXIT_FAILURE);
+            return true;
+        }
+        // A new session numbers its messages from scratch, forget the old ids
+        // (this runs on the receiver thread, the only user of receivedMsgIds)
+        receivedMsgIds.reset();
+        if (!lastChannel.empty()) {
+            UdpMessage joinMsg = buildJoinUdpMessage(lastChannel, displayName, nextMessageId++);
+            resyncRequestId = joinMsg.messageId;
+            resyncState = Resync::JOIN;
+            sendRawUdpMessage(joinMsg);
+            return true;
+        }
+    } else if (!ok) {
+        events.reply(false, content);
+    }
+    finishResyncLocked();
+    return true;
+}
+
+// Sends the held messages and leaves the outage state, sessionMutex must be held
+void UdpChatClient::finishResyncLocked() {
+    std::vector<uint64_t> tickets;
+    std::vector<std::string> queued = outageQueue.takeAll(&tickets);
+    resyncState = Resync::NONE;
+    outage = false;
+    backoff.reset();
+    for (size_t i = 0; i < queued.size(); ++i) {
+        const std::string& message = queued[i];
+        uint64_t outboxTicket = tickets[i];
+        if (scheduler) {
+            scheduler->submit(SendClass::BULK,
+                              [this, message, outboxTicket]() { queueOrTransmit(message, outboxTicket); });
+        } else {
+            transmitMessage(message, outboxTicket);
+        }
+    }
+    std::cerr << "Session re-established, " << queued.size() << " queued message(s) sent." << std::endl;
 }
 
 // Sends a UDP message to the server and stores it for potential retransmission.
 void UdpChatClient::sendRawUdpMessage(const UdpMessage& msg) {
-    std::vector<uint8_t> buffer = packUdpMessage(msg);
-    ssize_t sentBytes = sendto(sockfd, buffer.data(), buffer.size(), 0, 
-                               (struct sockaddr*)&serverAddr, sizeof(serverAddr));
+    std::vector<uint8_t> packed = packUdpMessage(msg);
+    sendReliable(msg.messageId, WireBuffer::copyOf(packed.data(), packed.size()));
+}
+
+// Stores an encoded message for tracking and retransmission and sends it. The buffer is shared
+// with the retransmission store, not copied.
+void UdpChatClient::sendReliable(uint16_t messageId, const WireBuffer& buffer, uint64_t outboxTicket) {
+    // Store before sending, the receiver thread may process the CONFIRM before sendto() returns
+    auto now = clock.now();
+    {
+        std::lock_guard<std::mutex> lock(sentMessagesMutex);
+        if (sentMessages.find(messageId) == sentMessages.end()) {
+            inFlightCount.fetch_add(1, std::memory_order_relaxed);
+        }
+        sentMessages[messageId] = {
+            buffer,
+            messageId,
+            now,
+            0,
+            now,
+            outboxTicket
+        };
+    }
+
+    ssize_t sentBytes = sendDatagram(buffer, serverAddr());
     if (sentBytes < 0) {
         perror("ERROR: Sending UDP message failed");
+        return;  // Left for the retransmission thread
+    }
+
+    if (!lowLatency) {
+        printf_debug("Sent message with ID %d (type %d, size %zu)", messageId, static_cast<int>(buffer[0]), buffer.size());
+    }
+}
+
+// Sends a CONFIRM or ERR. With a send scheduler the datagram is queued in the control class,
+// ahead of any queued chat message; without one it is sent right away.
+void UdpChatClient::sendControl(const std::vector<uint8_t>& buffer, const sockaddr_in& addr) {
+    sendControl(buffer.data(), buffer.size(), addr);
+}
+
+void UdpChatClient::sendControl(const uint8_t* data, size_t length, const sockaddr_in& addr) {
+    if (scheduler && !stopping) {
+        std::vector<uint8_t> buffer(data, data + length);  // Kept by the queued task
+        scheduler->submit(SendClass::CONTROL, [this, buffer, addr]() {
+            if (sendDatagram(buffer, addr) < 0) perror("ERROR: Sending UDP control message failed");
+        });
         return;
     }
+    if (sendDatagram(data, length, addr) < 0) perror("ERROR: Sending UDP control message failed");
+}
 
-    printf_debug("Sent message with ID %d (type %d, size %zu)", msg.messageId, static_cast<int>(msg.type), buffer.size());
+// Sends the CONFIRM of a received message, encoded on the stack
+void UdpChatClient::sendConfirm(uint16_t refId, const sockaddr_in& addr) {
+    uint8_t confirm[3] = {static_cast<uint8_t>(UdpMessageType::CONFIRM), static_cast<uint8_t>(refId >> 8),
+                          static_cast<uint8_t>(refId & 0xFF)};
+    sendControl(confirm, sizeof(confirm), addr);
+}
 
-    // Store the message for tracking and retransmission
-    sentMessages[msg.messageId] = {
-        buffer,
-        msg.messageId,
-        std::chrono::steady_clock::now()
-    };
+// Sends one datagram, accounts it in the statistics and records it when capturing.
+// All outgoing UDP traffic of the client goes through this function.
+ssize_t UdpChatClient::sendDatagram(const uint8_t* data, size_t length, const sockaddr_in& addr) {
+    TRACE_SCOPE("send");
+    ssize_t sentBytes = socket->sendTo(data, length, addr);
+    if (sentBytes > 0) {
+        statMessageSent(statKindFromUdpType(data[0]), static_cast<size_t>(sentBytes));
+        captureWire(CaptureDirection::OUTBOUND, CaptureTransport::UDP, data, length);
+    }
+    return sentBytes;
+}
+
+ssize_t UdpChatClient::sendDatagram(const std::vector<uint8_t>& buffer, const sockaddr_in& addr) {
+    return sendDatagram(buffer.data(), buffer.size(), addr);
+}
+
+ssize_t UdpChatClient::sendDatagram(const WireBuffer& buffer, const sockaddr_in& addr) {
+    return sendDatagram(buffer.data(), buffer.size(), addr);
+}
+
+// Processes one received datagram if there is one, used by the simulator instead of the receiver thread
+bool UdpChatClient::pollNetwork() {
+    return receiveServerResponseUDP();
+}
+
+// Runs one retransmission check, used by the simulator instead of the retransmission thread
+void UdpChatClient::pollRetransmissions() {
+    checkRetransmissions();
 }
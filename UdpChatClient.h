@@ -3,65 +3,245 @@
 
 #include "MessageUdp.h"
 #include "ChatClient.h"  
+#include "Clock.h"
+#include "Socket.h"
+#include "Reconnect.h"
+#include "Shutdown.h"
+#include "SendScheduler.h"
+#include "MessagePrefix.h"
+#include "WireBuffer.h"
+#include "SpscRing.h"
+#include "History.h"
+#include "BatchScript.h"
+#include "Liveness.h"
+#include "Outbox.h"
+#include <condition_variable>
+#include "InputHandler.h"
 #include <string>
+#include <string_view>
 #include <netinet/in.h>
 #include <unordered_set>
 #include <thread>
 #include <atomic>
+#include <mutex>
 #include <unordered_map>
+#include <bitset>
+#include <memory_resource>
 #include <cstdint>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <vector>
 struct SentMessageInfo {
-    std::vector<uint8_t> data;
+    WireBuffer data;  // Shared with the send queue, never copied
     uint16_t messageId;
     std::chrono::steady_clock::time_point timestamp;
     int retryCount = 0; 
+    std::chrono::steady_clock::time_point firstSentTime;  // First transmission, used for CONFIRM RTT
+    uint64_t outboxTicket = 0;  // Journal record marked done by the CONFIRM (--outbox)
 };
-extern int totalRetransmissions;
+// A line for the user produced by the protocol logic, formatted when it is written to stdout
+struct OutputEvent {
+    enum class Kind { MSG, REPLY_SUCCESS, REPLY_FAILURE, ERR, BYE, TEXT };
+    Kind kind = Kind::TEXT;
+    std::pmr::string from;     // Sender display name (MSG, ERR)
+    std::pmr::string content;
+    std::chrono::steady_clock::time_point receivedAt;  // When the datagram arrived
+    int messageId = -1;        // Of the datagram, for ChatEvents::onRecord
+    int refId = -1;            // REPLY
+};
+extern std::atomic<int> totalRetransmissions;
 // Class to handle UDP chat client functionalities.
 class UdpChatClient : public ChatClient {
 public:
 UdpChatClient(const std::string& server, int port, int timeoutMs, int retries);
+    UdpChatClient(std::unique_ptr<DatagramSocket> socket, const sockaddr_in& server,
+                  Clock& clock, int timeoutMs, int retries);
     ~UdpChatClient();
 
     bool connectToServer();
     void run();
+    void start();
+    bool submitLine(const std::string& line);
+    bool sendChat(std::string_view content);
+    void releaseHeldInput();
+    int finish();
 
     // Functions for handling commands    
     void printHelp(); 
+    void handleInputLine(const std::string& input);
     void handleCommand(const std::string& input);
     void handleAuthCommand(const std::string& input);
     void handleJoinCommand(const std::string& input);
     void handleRenameCommand(const std::string& input);
+    void handleSendCommand(const std::string& input);
     void sendMessage(const std::string& message);
     void processByeMessage(const UdpMessage& byeMsg);
     
     void sendByeMessage();
+
+    // Single-threaded stepping used by the simulator instead of the background threads
+    bool pollNetwork();
+    void pollRetransmissions();
+
+    // Number of sent messages still waiting for a CONFIRM
+    int64_t inFlightMessages() const { return inFlightCount.load(std::memory_order_relaxed); }
+
+    // Enables outage handling with session replay (--reconnect)
+    void setReconnectPolicy(const ReconnectPolicy& policy);
+
+    // How long shutdown waits for outstanding CONFIRMs (including the one for BYE)
+    void setDrainTimeout(std::chrono::milliseconds timeout) { drainTimeout = timeout; }
+
+    // Paces chat messages to `rate` per second with bursts of up to `burst` (--rate, --burst)
+    void setPacing(double rate, double burst) { scheduler = std::make_unique<SendScheduler>(rate, burst); }
+
+    // Splits receiving into receive, decode and render threads (--pipeline). `cpus` optionally
+    // pins them in that order, -1 leaves a stage unpinned (--pin-stages)
+    void setPipeline(const std::vector<int>& cpus);
+
+    // Busy-polls the non-blocking socket instead of sleeping in poll() (--low-latency),
+    // optionally pinning the receiver thread to `cpu` (-1 = unpinned)
+    void setLowLatency(int cpu) { lowLatency = true; spinCpu = cpu; }
+
+    // Probes the server with PING after `idle` of silence and declares it dead after deadAfter
+    // (--keepalive, --dead-after)
+    void setLiveness(const LivenessPolicy& policy);
+
+    // Keeps the newest received messages per channel for /history and /search (--history)
+    void setHistoryLimits(const HistoryLimits& limits) { history.configure(limits); }
+
+    // Reads the input from a script instead of stdin, waiting for each REPLY up to the reply
+    // timeout (--batch, call after setReplyTimeout)
+    bool setBatchScript(const std::string& path);
+    bool batchFailed() const { return batch && batch->failed(); }
+
+    // Journals every chat message until its CONFIRM and resends what the previous run left
+    // unconfirmed after the first successful AUTH (--outbox). The outbox must be open.
+    void setOutbox(Outbox* journal) { outbox = journal; }
   
 private:
     std::string serverAddress;
     int serverPort;
-    int sockfd;
+    std::unique_ptr<DatagramSocket> socket;
+    Clock& clock;
     void processReplyMessage(const UdpMessage& replyMsg, const sockaddr_in& fromAddr);
     void processErrMessage(const UdpMessage& errMsg);
-    void receiveServerResponseUDP();
+    bool receiveServerResponseUDP();
     void processConfirmMessage(const UdpMessage& confirmMsg); 
     void processMsgMessage(const UdpMessage& msgMsg);
-    void sendPingMessage();
+    void sendPingMessage(uint16_t messageId);
     void processPingMessage(const UdpMessage& pingMsg);
     void checkRetransmissions();
     void sendRawUdpMessage(const UdpMessage& msg); 
-    struct sockaddr_in serverAddr;
-    uint16_t nextMessageId;
-    std::string displayName;
+    void sendReliable(uint16_t messageId, const WireBuffer& buffer, uint64_t outboxTicket = 0);
+    ssize_t sendDatagram(const uint8_t* data, size_t length, const sockaddr_in& addr);
+    ssize_t sendDatagram(const std::vector<uint8_t>& buffer, const sockaddr_in& addr);
+    ssize_t sendDatagram(const WireBuffer& buffer, const sockaddr_in& addr);
+    void sendControl(const std::vector<uint8_t>& buffer, const sockaddr_in& addr);
+    void sendControl(const uint8_t* data, size_t length, const sockaddr_in& addr);
+    void sendConfirm(uint16_t refId, const sockaddr_in& addr);
+    // Where datagrams go, IPv4 address and port packed into one word: the receiver (dynamic
+    // port from the REPLY) and the retransmission thread (back to the well-known port during an
+    // outage) switch it while the other threads send
+    std::atomic<uint64_t> serverEndpoint{0};
+    sockaddr_in serverAddr() const;
+    void setServerAddr(const sockaddr_in& addr);
+    std::atomic<uint16_t> nextMessageId;  // Used by the input, receiver and retransmission threads
+    std::string displayName;  // Written by the input thread under sessionMutex
+    std::string lockedDisplayName();  // Copy for the other threads
+    UdpMsgPrefix msgPrefix;  // Encoded MSG start for displayName, guarded by sessionMutex
     std::unordered_set<uint16_t> confirmedMessageIds;
     std::thread receiverThread;
     std::atomic<bool> running = true;
     std::thread retransmissionThread;
-    std::unordered_set<uint16_t> receivedMsgIds;
-    std::unordered_map<uint16_t, SentMessageInfo> sentMessages;
+    std::bitset<65536> receivedMsgIds;  // Indexed by MessageID, no allocation per message
+    std::pmr::unordered_map<uint16_t, SentMessageInfo> sentMessages;  // Nodes come from the session pool
+    std::mutex sentMessagesMutex;  // sentMessages is shared by the input, receiver and retransmission threads
+    std::condition_variable drainedCv;     // Notified whenever sentMessages shrinks
+    std::atomic<int64_t> inFlightCount{0};  // Size of sentMessages, readable from the stats thread
+    int inFlightGaugeId = -1;
     int timeoutMs;
     int maxRetries;
+
+    // Resilient mode: a message that exhausts its retries marks an outage. Unconfirmed and new
+    // user messages wait in outageQueue, AUTH and the last JOIN are replayed with backoff
+    // against the originally resolved address (the dynamic port may be gone).
+    enum class Resync { NONE, AUTH, JOIN };
+    ReconnectPolicy reconnectPolicy;
+    Backoff backoff{reconnectPolicy};
+    OutageQueue outageQueue;
+    struct sockaddr_in resolvedAddr;
+    std::mutex sessionMutex;  // Guards the session state below
+    bool outage = false;
+    Resync resyncState = Resync::NONE;
+    uint16_t resyncRequestId = 0;
+    std::chrono::steady_clock::time_point nextResyncAttempt;
+    std::optional<AuthCommand> lastAuth;
+    std::string lastChannel;
+    void beginOutage();
+    void tryResync();
+    bool handleResyncReply(uint16_t refId, bool ok, const std::string& content);
+    void finishResyncLocked();
+
+    // Graceful shutdown: the background threads wait on `wakeup` besides their normal work
+    Wakeup wakeup;
+    std::chrono::milliseconds drainTimeout{2000};
+    std::atomic<bool> stopping{false};
+    std::atomic<int> lostMessages{0};  // Messages dropped after exhausting their retries
+    void shutdownGracefully();
+    void endSession(int status);
+
+    LivenessMonitor liveness;
+    int rttGaugeId = -1;
+    void checkLiveness();
+
+    std::unique_ptr<SendScheduler> scheduler;  // Only set when pacing is configured
+    void submitMessage(const std::string& message, uint64_t outboxTicket = 0);
+    bool waitForSendWindow(size_t maxPending);
+    void queueOrTransmit(const std::string& message, uint64_t outboxTicket);
+    void transmitMessage(const std::string& message, uint64_t outboxTicket);
+    Outbox* outbox = nullptr;
+    void resendRecovered();
+    // REPLYs are matched by RefMessageID. Completion handlers and the input held meanwhile are
+    // processed on the input side, serialized by inputMutex.
+    std::mutex inputMutex;
+    void trackRequest(PendingRequest::Kind kind, uint16_t messageId, const std::string& argument);
+    void requestDone(PendingRequest::Kind kind, const std::string& argument, const RequestResult& result);
+    void handleHeldLocked();
+    // Time when the datagram currently being processed was received
+    std::chrono::steady_clock::time_point lastReceiveTime;
+    MessageHistory history;
+    std::unique_ptr<BatchScript> batch;
     void backgroundReceiverLoop();
+    void dispatchDatagram(const uint8_t* data, size_t length, const sockaddr_in& fromAddr);
+    void emitOutput(OutputEvent&& event);
+    void renderOutput(const OutputEvent& event);
+
+    // Receive pipeline: the receiver thread only drains the socket and sends the CONFIRMs, the
+    // decode thread runs the protocol logic and the render thread writes to stdout. The stages
+    // are connected by SPSC rings, so a CONFIRM never waits for parsing or terminal output.
+    struct InboundDatagram {
+        WireBuffer bytes;
+        sockaddr_in from;
+        std::chrono::steady_clock::time_point receivedAt;
+    };
+    bool pipelined = false;
+    bool lowLatency = false;
+    int spinCpu = -1;
+    std::vector<int> stageCpus;  // receive, decode, render
+    std::unique_ptr<SpscRing<InboundDatagram>> decodeRing;
+    std::unique_ptr<SpscRing<OutputEvent>> renderRing;
+    Doorbell decodeBell;
+    Doorbell renderBell;
+    std::atomic<bool> receiveStageDone{false};
+    std::atomic<bool> decodeStageDone{false};
+    std::thread decodeThread;
+    std::thread renderThread;
+    int stageCpu(size_t stage) const { return stage < stageCpus.size() ? stageCpus[stage] : -1; }
+    void confirmInReceiveStage(const uint8_t* data, size_t length, const sockaddr_in& fromAddr);
+    void decodeLoop();
+    void renderLoop();
     // Helper methods
     bool bindSocket();
     bool resolveServerAddr();
@@ -34,7 +34,7 @@ UdpMessage buildAuthUdpMessage(const AuthCommand& cmd, uint16_t messageId) {
     std::vector<uint8_t> secretBytes = packString(cmd.secret);
     payload.insert(payload.end(), secretBytes.begin(), secretBytes.end());
 
-    msg.payload = payload;
+    msg.payload.assign(payload.begin(), payload.end());
     return msg;
 }
 
@@ -54,7 +54,7 @@ UdpMessage buildJoinUdpMessage(const std::string& channel, const std::string& di
     std::vector<uint8_t> displayNameBytes = packString(displayName);
     payload.insert(payload.end(), displayNameBytes.begin(), displayNameBytes.end());
     
-    msg.payload = payload;
+    msg.payload.assign(payload.begin(), payload.end());
     return msg;
 }
 
@@ -74,7 +74,7 @@ UdpMessage buildMsgUdpMessage(const std::string& displayName, const std::string&
     std::vector<uint8_t> contentBytes = packString(messageContent);
     payload.insert(payload.end(), contentBytes.begin(), contentBytes.end());
     
-    msg.payload = payload;
+    msg.payload.assign(payload.begin(), payload.end());
     return msg;
 }
 
@@ -113,6 +113,6 @@ UdpMessage buildReplyUdpMessage(const std::string& messageContent, uint16_t mess
     std::vector<uint8_t> messageBytes = packString(messageContent);
     payload.insert(payload.end(), messageBytes.begin(), messageBytes.end());
     
-    msg.payload = payload;
+    msg.payload.assign(payload.begin(), payload.end());
     return msg;
 }
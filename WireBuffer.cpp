@@ -0,0 +1,83 @@
+#include "WireBuffer.h"
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+namespace {
+
+// Blocks kept for reuse. Bounded, and buffers that grew large are not kept at all,
+// so one huge message does not pin its memory for the rest of the session.
+constexpr size_t POOL_LIMIT = 1024;
+constexpr size_t POOLED_CAPACITY_LIMIT = 64 * 1024;
+
+struct Pool {
+    std::mutex mutex;
+    std::vector<void*> blocks;
+};
+
+// Intentionally never destroyed, buffers may be released from background threads during exit
+Pool& pool() {
+    static Pool* instance = new Pool();
+    return *instance;
+}
+
+} // namespace
+
+WireBuffer::WireBuffer(const WireBuffer& other) : block(other.block) {
+    if (block) block->references.fetch_add(1, std::memory_order_relaxed);
+}
+
+WireBuffer& WireBuffer::operator=(WireBuffer other) noexcept {
+    std::swap(block, other.block);
+    return *this;
+}
+
+WireBuffer WireBuffer::acquire() {
+    Pool& p = pool();
+    {
+        std::lock_guard<std::mutex> lock(p.mutex);
+        if (!p.blocks.empty()) {
+            Block* reused = static_cast<Block*>(p.blocks.back());
+            p.blocks.pop_back();
+            reused->references.store(1, std::memory_order_relaxed);
+            return WireBuffer(reused);
+        }
+    }
+    return WireBuffer(new Block());
+}
+
+WireBuffer WireBuffer::copyOf(const void* data, size_t length) {
+    WireBuffer buffer = acquire();
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    buffer.bytes().assign(bytes, bytes + length);
+    return buffer;
+}
+
+void WireBuffer::prewarm(size_t count, size_t capacity) {
+    Pool& p = pool();
+    std::lock_guard<std::mutex> lock(p.mutex);
+    p.blocks.reserve(POOL_LIMIT);
+    capacity = std::min(capacity, POOLED_CAPACITY_LIMIT);
+    while (count-- > 0 && p.blocks.size() < POOL_LIMIT) {
+        Block* block = new Block();
+        block->bytes.resize(capacity);  // Faults the pages in
+        block->bytes.clear();
+        p.blocks.push_back(block);
+    }
+}
+
+void WireBuffer::release() {
+    if (!block) return;
+    if (block->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        block->bytes.clear();
+        bool keep = block->bytes.capacity() <= POOLED_CAPACITY_LIMIT;
+        if (keep) {
+            Pool& p = pool();
+            std::lock_guard<std::mutex> lock(p.mutex);
+            keep = p.blocks.size() < POOL_LIMIT;
+            if (keep) p.blocks.push_back(block);
+        }
+        if (!keep) delete block;
+    }
+    block = nullptr;
+}
@@ -0,0 +1,55 @@
+#ifndef WIREBUFFER_H
+#define WIREBUFFER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Reference-counted byte buffer recycled through a process-wide pool.
+// Copying a WireBuffer only bumps the reference count, so one encoded message can sit in the
+// send queue and in the retransmission store at the same time. When the last reference goes
+// away the storage returns to the pool and keeps its capacity for the next message, so
+// steady-state sending does not allocate.
+class WireBuffer {
+public:
+    WireBuffer() = default;  // Empty handle without storage
+    WireBuffer(const WireBuffer& other);
+    WireBuffer(WireBuffer&& other) noexcept : block(other.block) { other.block = nullptr; }
+    WireBuffer& operator=(WireBuffer other) noexcept;
+    ~WireBuffer() { release(); }
+
+    // Takes an empty buffer from the pool
+    static WireBuffer acquire();
+
+    // Pooled buffer holding a copy of the given bytes
+    static WireBuffer copyOf(const void* data, size_t length);
+
+    // Fills the pool with `count` buffers of the given capacity, touching their memory
+    // (--low-latency allocates everything before the session starts)
+    static void prewarm(size_t count, size_t capacity);
+
+    // Storage for encoding; must only be modified before the buffer is shared
+    std::vector<uint8_t>& bytes() { return block->bytes; }
+
+    const uint8_t* data() const { return block ? block->bytes.data() : nullptr; }
+    size_t size() const { return block ? block->bytes.size() : 0; }
+    bool empty() const { return size() == 0; }
+    uint8_t operator[](size_t index) const { return block->bytes[index]; }
+
+    std::string toString() const { return std::string(reinterpret_cast<const char*>(data()), size()); }
+
+private:
+    struct Block {
+        std::vector<uint8_t> bytes;
+        std::atomic<uint32_t> references{1};
+    };
+
+    explicit WireBuffer(Block* block) : block(block) {}
+    void release();
+
+    Block* block = nullptr;
+};
+
+#endif // WIREBUFFER_H
@@ -0,0 +1,147 @@
+#include "WireCapture.h"
+#include "debug.h"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static std::atomic<WireCapture*> activeCapture{nullptr};
+
+// Returns the CLOCK_MONOTONIC time in nanoseconds
+static uint64_t monotonicNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+WireCapture::WireCapture(const std::string& path)
+    : path(path), fd(-1), chunk(nullptr), chunkOffset(0), chunkUsed(0), stopping(false) {}
+
+WireCapture::~WireCapture() {
+    close();
+}
+
+void WireCapture::setActive(WireCapture* capture) {
+    activeCapture.store(capture, std::memory_order_release);
+}
+
+WireCapture* WireCapture::active() {
+    return activeCapture.load(std::memory_order_acquire);
+}
+
+bool WireCapture::open() {
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        perror("ERROR: Unable to open capture file");
+        return false;
+    }
+    if (!mapChunk(0)) {
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+
+    CaptureFileHeader header;
+    std::memcpy(header.magic, CAPTURE_MAGIC, sizeof(header.magic));
+    header.version = CAPTURE_VERSION;
+    header.reserved = 0;
+    writeToFile(reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+
+    writerThread = std::thread(&WireCapture::writerLoop, this);
+    printf_debug("Capturing wire traffic to %s", path.c_str());
+    return true;
+}
+
+void WireCapture::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (fd < 0 || stopping) return;
+        stopping = true;
+    }
+    wakeup.notify_one();
+    if (writerThread.joinable()) writerThread.join();
+
+    // Cut off the unused tail of the last chunk
+    uint64_t fileSize = chunkOffset + chunkUsed;
+    munmap(chunk, CHUNK_SIZE);
+    chunk = nullptr;
+    if (ftruncate(fd, static_cast<off_t>(fileSize)) < 0) {
+        perror("ERROR: Unable to truncate capture file");
+    }
+    ::close(fd);
+    fd = -1;
+}
+
+void WireCapture::record(CaptureDirection direction, CaptureTransport transport, const void* data, size_t length) {
+    CaptureRecordHeader header;
+    header.length = static_cast<uint32_t>(length);
+    header.direction = static_cast<uint8_t>(direction);
+    header.transport = static_cast<uint8_t>(transport);
+    header.reserved = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) return;
+        // Stamped under the lock, so the records of all threads are in time order in the file
+        header.timestampNs = monotonicNs();
+        const uint8_t* headerBytes = reinterpret_cast<const uint8_t*>(&header);
+        const uint8_t* dataBytes = static_cast<const uint8_t*>(data);
+        staging.insert(staging.end(), headerBytes, headerBytes + sizeof(header));
+        staging.insert(staging.end(), dataBytes, dataBytes + length);
+    }
+    wakeup.notify_one();
+}
+
+// Maps the chunk starting at the given file offset, extending the file if needed
+bool WireCapture::mapChunk(uint64_t offset) {
+    if (chunk != nullptr) {
+        munmap(chunk, CHUNK_SIZE);
+        chunk = nullptr;
+    }
+    if (ftruncate(fd, static_cast<off_t>(offset + CHUNK_SIZE)) < 0) {
+        perror("ERROR: Unable to extend capture file");
+        return false;
+    }
+    void* mapped = mmap(nullptr, CHUNK_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, static_cast<off_t>(offset));
+    if (mapped == MAP_FAILED) {
+        perror("ERROR: Unable to map capture file");
+        return false;
+    }
+    chunk = static_cast<uint8_t*>(mapped);
+    chunkOffset = offset;
+    chunkUsed = 0;
+    return true;
+}
+
+// Copies data into the mapping, moving on to the next chunk when the current one is full
+void WireCapture::writeToFile(const uint8_t* data, size_t length) {
+    while (length > 0 && chunk != nullptr) {
+        if (chunkUsed == CHUNK_SIZE && !mapChunk(chunkOffset + CHUNK_SIZE)) {
+            return;
+        }
+        size_t part = std::min(length, CHUNK_SIZE - chunkUsed);
+        std::memcpy(chunk + chunkUsed, data, part);
+        chunkUsed += part;
+        data += part;
+        length -= part;
+    }
+}
+
+// Background thread: takes everything staged so far and writes it without holding the lock
+void WireCapture::writerLoop() {
+    std::vector<uint8_t> batch;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeup.wait(lock, [this]() { return stopping || !staging.empty(); });
+            if (staging.empty() && stopping) break;
+            batch.swap(staging);
+        }
+        writeToFile(batch.data(), batch.size());
+        batch.clear();
+    }
+}
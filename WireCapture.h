@@ -0,0 +1,87 @@
+#ifndef WIRECAPTURE_H
+#define WIRECAPTURE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Direction of a captured record
+enum class CaptureDirection : uint8_t { OUTBOUND = 0, INBOUND = 1 };
+
+// Transport of a captured record
+enum class CaptureTransport : uint8_t { TCP = 0, UDP = 1 };
+
+// On-disk format (host byte order, append-only):
+//   file header:  "IPK25CAP" magic (8 B), uint32 version, uint32 reserved
+//   every record: CaptureRecordHeader followed by `length` bytes of wire data
+// A TCP record holds one CRLF-terminated line, a UDP record one whole datagram.
+struct CaptureFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+struct CaptureRecordHeader {
+    uint64_t timestampNs;   // CLOCK_MONOTONIC time of the send/receive
+    uint32_t length;        // Number of data bytes following the header
+    uint8_t direction;      // CaptureDirection
+    uint8_t transport;      // CaptureTransport
+    uint16_t reserved;
+};
+
+constexpr char CAPTURE_MAGIC[8] = {'I', 'P', 'K', '2', '5', 'C', 'A', 'P'};
+constexpr uint32_t CAPTURE_VERSION = 1;
+
+// Records wire traffic into a capture file.
+// Producers only copy the record into a staging buffer; a background thread writes the
+// staged data into the file through a memory mapping that grows in fixed-size chunks.
+class WireCapture {
+public:
+    explicit WireCapture(const std::string& path);
+    ~WireCapture();
+
+    // Creates the file and starts the writer thread
+    bool open();
+
+    // Flushes all staged records and truncates the file to its real size
+    void close();
+
+    // Appends one record, timestamped now (thread-safe)
+    void record(CaptureDirection direction, CaptureTransport transport, const void* data, size_t length);
+
+    // Installs/returns the process-wide capture used by the clients (nullptr = capture disabled)
+    static void setActive(WireCapture* capture);
+    static WireCapture* active();
+
+private:
+    static constexpr size_t CHUNK_SIZE = 4 * 1024 * 1024;
+
+    std::string path;
+    int fd;
+    uint8_t* chunk;          // Currently mapped chunk of the file
+    uint64_t chunkOffset;    // File offset of the mapped chunk
+    size_t chunkUsed;        // Bytes written into the mapped chunk
+
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::vector<uint8_t> staging;
+    bool stopping;
+    std::thread writerThread;
+
+    void writerLoop();
+    bool mapChunk(uint64_t offset);
+    void writeToFile(const uint8_t* data, size_t length);
+};
+
+// Records a wire event if capture is enabled
+inline void captureWire(CaptureDirection direction, CaptureTransport transport, const void* data, size_t length) {
+    if (WireCapture* capture = WireCapture::active()) {
+        capture->record(direction, transport, data, length);
+    }
+}
+
+#endif // WIRECAPTURE_H
@@ -0,0 +1,197 @@
+#include "WireReplay.h"
+#include "WireCapture.h"
+#include "UdpCommandBuilder.h"
+#include "debug.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <iostream>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+WireReplay::WireReplay(const std::string& capturePath, const std::string& transport,
+                       const std::string& server, int port, double speed)
+    : capturePath(capturePath), transport(transport), server(server), port(port),
+      speed(speed > 0 ? speed : 1.0), sockfd(-1) {
+    std::memset(&serverAddr, 0, sizeof(serverAddr));
+}
+
+// Resolves the server and opens a TCP connection or an unconnected UDP socket
+bool WireReplay::connectToServer() {
+    struct addrinfo hints{}, *res;
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = transport == "tcp" ? SOCK_STREAM : SOCK_DGRAM;
+
+    int status = getaddrinfo(server.c_str(), std::to_string(port).c_str(), &hints, &res);
+    if (status != 0 || res == nullptr) {
+        std::cerr << "ERROR: getaddrinfo failed for " << server << ": " << gai_strerror(status) << std::endl;
+        return false;
+    }
+    std::memcpy(&serverAddr, res->ai_addr, sizeof(serverAddr));
+    freeaddrinfo(res);
+
+    sockfd = socket(AF_INET, hints.ai_socktype, 0);
+    if (sockfd < 0) {
+        perror("ERROR: Unable to create replay socket");
+        return false;
+    }
+    if (transport == "tcp" && connect(sockfd, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) < 0) {
+        perror("ERROR: Replay connect failed");
+        close(sockfd);
+        sockfd = -1;
+        return false;
+    }
+    return true;
+}
+
+// Reads and discards server traffic so the server never blocks on us.
+// UDP: switches to the port the server answers from and confirms every non-CONFIRM message.
+void WireReplay::drainInbound() {
+    uint8_t buffer[65536];
+    while (running) {
+        struct pollfd pfd = {sockfd, POLLIN, 0};
+        if (poll(&pfd, 1, 100) <= 0) continue;
+
+        struct sockaddr_in fromAddr;
+        socklen_t addrLen = sizeof(fromAddr);
+        ssize_t n = recvfrom(sockfd, buffer, sizeof(buffer), 0, (struct sockaddr*)&fromAddr, &addrLen);
+        if (n <= 0) {
+            if (transport == "tcp") break;  // Server closed the connection
+            continue;
+        }
+
+        if (transport == "udp" && n >= 3 && buffer[0] != static_cast<uint8_t>(UdpMessageType::CONFIRM)) {
+            {
+                std::lock_guard<std::mutex> lock(addrMutex);
+                serverAddr = fromAddr;
+            }
+            uint16_t netId;
+            std::memcpy(&netId, buffer + 1, sizeof(netId));
+            std::vector<uint8_t> confirm = packUdpMessage(buildConfirmUdpMessage(ntohs(netId)));
+            sendto(sockfd, confirm.data(), confirm.size(), 0, (struct sockaddr*)&fromAddr, sizeof(fromAddr));
+        }
+    }
+}
+
+bool WireReplay::run() {
+    int fd = open(capturePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        perror("ERROR: Unable to open capture file");
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(CaptureFileHeader)) {
+        std::cerr << "ERROR: Capture file is empty or unreadable: " << capturePath << std::endl;
+        close(fd);
+        return false;
+    }
+    size_t fileSize = static_cast<size_t>(st.st_size);
+    void* mapped = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        perror("ERROR: Unable to map capture file");
+        return false;
+    }
+    const uint8_t* data = static_cast<const uint8_t*>(mapped);
+
+    CaptureFileHeader fileHeader;
+    std::memcpy(&fileHeader, data, sizeof(fileHeader));
+    if (std::memcmp(fileHeader.magic, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) != 0 ||
+        fileHeader.version != CAPTURE_VERSION) {
+        std::cerr << "ERROR: Not an IPK25 capture file: " << capturePath << std::endl;
+        munmap(mapped, fileSize);
+        return false;
+    }
+
+    if (!connectToServer()) {
+        munmap(mapped, fileSize);
+        return false;
+    }
+    CaptureTransport wanted = transport == "tcp" ? CaptureTransport::TCP : CaptureTransport::UDP;
+
+    running = true;
+    std::thread drainThread(&WireReplay::drainInbound, this);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    uint64_t firstTimestamp = 0;
+    bool haveFirst = false;
+    size_t sentRecords = 0, sentBytes = 0, skipped = 0;
+
+    size_t offset = sizeof(CaptureFileHeader);
+    while (offset + sizeof(CaptureRecordHeader) <= fileSize) {
+        CaptureRecordHeader header;
+        std::memcpy(&header, data + offset, sizeof(header));
+        offset += sizeof(header);
+        if (offset + header.length > fileSize) break;  // Truncated last record
+        const uint8_t* payload = data + offset;
+        offset += header.length;
+
+        if (header.direction != static_cast<uint8_t>(CaptureDirection::OUTBOUND) ||
+            header.transport != static_cast<uint8_t>(wanted)) {
+            continue;
+        }
+        if (wanted == CaptureTransport::UDP && header.length > 0 &&
+            payload[0] == static_cast<uint8_t>(UdpMessageType::CONFIRM)) {
+            skipped++;
+            continue;
+        }
+
+        // Sleep until the scaled original send time (absolute, so errors do not accumulate)
+        if (!haveFirst) {
+            firstTimestamp = header.timestampNs;
+            haveFirst = true;
+        }
+        // Records older than the first one are sent at once; the scaled delay is capped (about
+        // 31 years) so a tiny --speed cannot overflow the conversion
+        double scaledNs = static_cast<double>(static_cast<int64_t>(header.timestampNs - firstTimestamp)) / speed;
+        uint64_t delayNs = static_cast<uint64_t>(std::clamp(scaledNs, 0.0, 1e18));
+        struct timespec due = start;
+        due.tv_sec += static_cast<time_t>(delayNs / 1000000000ull);
+        due.tv_nsec += static_cast<long>(delayNs % 1000000000ull);
+        if (due.tv_nsec >= 1000000000L) {
+            due.tv_sec++;
+            due.tv_nsec -= 1000000000L;
+        }
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, nullptr) == EINTR) {
+        }
+
+        ssize_t n;
+        if (wanted == CaptureTransport::TCP) {
+            n = send(sockfd, payload, header.length, MSG_NOSIGNAL);
+        } else {
+            std::lock_guard<std::mutex> lock(addrMutex);
+            n = sendto(sockfd, payload, header.length, 0, (struct sockaddr*)&serverAddr, sizeof(serverAddr));
+        }
+        if (n < 0) {
+            perror("ERROR: Replay send failed");
+            break;
+        }
+        sentRecords++;
+        sentBytes += header.length;
+    }
+
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    // Give the server a moment to answer the last messages before closing
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    running = false;
+    drainThread.join();
+    close(sockfd);
+    sockfd = -1;
+    munmap(mapped, fileSize);
+
+    std::cerr << "Replay finished: " << sentRecords << " records, " << sentBytes << " bytes in "
+              << elapsed << " s (speed x" << speed << ", " << skipped << " recorded CONFIRMs skipped)" << std::endl;
+    return true;
+}
@@ -0,0 +1,36 @@
+#ifndef WIREREPLAY_H
+#define WIREREPLAY_H
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <netinet/in.h>
+
+// Re-drives the outbound side of a capture file (see WireCapture) against a server.
+// Outbound records are sent with their original pacing divided by `speed`.
+// For UDP the replay follows the server's dynamic port and confirms inbound messages itself,
+// recorded CONFIRMs are skipped because they reference message IDs of the original session.
+class WireReplay {
+public:
+    WireReplay(const std::string& capturePath, const std::string& transport,
+               const std::string& server, int port, double speed);
+
+    // Runs the replay, returns false if the file or the connection could not be opened
+    bool run();
+
+private:
+    std::string capturePath;
+    std::string transport;
+    std::string server;
+    int port;
+    double speed;
+    int sockfd;
+    struct sockaddr_in serverAddr;  // UDP destination, switched to the server's dynamic port
+    std::mutex addrMutex;
+    std::atomic<bool> running{false};
+
+    bool connectToServer();
+    void drainInbound();
+};
+
+#endif // WIREREPLAY_H
@@ -8,41 +8,125 @@
 #include <csignal>
 #include <cstdlib>
 #include "debug.h"
+#include "LatencyHistogram.h"
+#include "StatsServer.h"
+#include "WireCapture.h"
+#include "WireReplay.h"
+#include "Trace.h"
+#include "Shutdown.h"
+#include "Affinity.h"
+#include "LowLatency.h"
+#include "History.h"
+#include "SessionMemory.h"
+#include "Outbox.h"
+#include <memory>
+#include <thread>
+#include <vector>
+#include <pthread.h>
 
-// Global pointer to ChatClient (common interface for TCP and UDP clients)
-ChatClient* globalClient = nullptr;
+// Prints the latency histograms when the process exits, registered once the client connected
+// (help, argument errors and failed connects have nothing to show)
+void dumpLatencyAtExit() {
+    dumpLatencyMetrics(std::cerr);
+}
 
-// Signal handler to catch Ctrl+C (SIGINT) and send BYE message before exiting
-void signalHandler(int signal) {
-    (void)signal; 
-    std::cerr << "SIGINT received!" << std::endl;
-    if (globalClient) {
-        std::cerr << "Sending BYE message...\n";
-        globalClient->sendByeMessage();
-    }
-printf_debug("Total retransmissions: %d", totalRetransmissions);
-    std::exit(0);
+// Blocks SIGUSR1 and starts a thread that waits for it and dumps the latency histograms.
+// Must be called before any other thread is created so that they inherit the blocked mask.
+void startLatencyDumpThread() {
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &set, nullptr);
+
+    std::thread([set]() {
+        // Termination signals are read from the signalfd of the client, never here
+        sigset_t termination;
+        sigemptyset(&termination);
+        sigaddset(&termination, SIGINT);
+        sigaddset(&termination, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &termination, nullptr);
+
+        int sig;
+        while (sigwait(&set, &sig) == 0) {
+            dumpLatencyMetrics(std::cerr);
+        }
+    }).detach();
 }
 
 // Prints usage help to the console
 void printHelp() {
-    std::cout << "Usage: ./ipk25chat-client -t <tcp|udp> -s <server> [-p port] [-d timeout_ms] [-r retries] [-h]\n";
+    std::cout << "Usage: ./ipk25chat-client -t <tcp|udp> -s <server> [-p port] [-d timeout_ms] [-r retries] [options] [-h]\n";
     std::cout << "  -t      Transport protocol: tcp or udp (REQUIRED)\n";
     std::cout << "  -s      Server hostname or IP (REQUIRED)\n";
     std::cout << "  -p      Server port (REQUIRED)\n";  
     std::cout << "  -d      UDP confirmation timeout in ms (default: 250)\n";
     std::cout << "  -r      UDP retries (default: 3)\n";
     std::cout << "  -h      Show this help message\n";
+    std::cout << "  --stats-socket PATH  Serve live statistics (Prometheus text) on a Unix socket\n";
+    std::cout << "  --capture FILE       Record all wire traffic with timestamps into FILE\n";
+    std::cout << "  --replay FILE        Re-send the outbound traffic of FILE to the server instead of chatting\n";
+    std::cout << "  --speed X            Replay pacing multiplier (default: 1.0 = original pacing)\n";
+    std::cout << "  --trace FILE         Record trace events and write them as Chrome trace JSON on exit\n";
+    std::cout << "  --reconnect          Reconnect after a lost connection and restore the session\n";
+    std::cout << "  --reconnect-max MS   Maximum reconnect backoff in ms (default: 10000)\n";
+    std::cout << "  --outage-queue N     Messages held while disconnected (default: 1000)\n";
+    std::cout << "  --drain-timeout MS   Time to wait for outstanding confirmations on exit (default: 2000)\n";
+    std::cout << "  --rate N             Send at most N chat messages per second (default: unlimited)\n";
+    std::cout << "  --burst N            Messages that may be sent back to back with --rate (default: 1)\n";
+    std::cout << "  --pipeline           UDP: receive, decode and render on separate threads\n";
+    std::cout << "  --pin-stages R,D,O   Pin the pipeline threads to CPUs ('-' = unpinned), implies --pipeline\n";
+    std::cout << "  --low-latency        Busy-poll the socket and lock pre-faulted memory (uses a whole core)\n";
+    std::cout << "  --spin-cpu N         Pin the busy-polling receiver thread to CPU N (with --low-latency)\n";
+    std::cout << "  --history N          Keep the last N received messages per channel (/history, /search)\n";
+    std::cout << "  --history-bytes N    Content memory per channel in bytes (default 1048576)\n";
+    std::cout << "  --history-channels N Channels kept in the history (default 16)\n";
+    std::cout << "  --batch FILE         Run the commands of FILE instead of stdin, each REPLY is awaited\n";
+    std::cout << "  --reply-timeout MS   How long /auth and /join wait for their REPLY, also in --batch (default 5000)\n";
+    std::cout << "  --batch-timeout MS   Alias of --reply-timeout\n";
+    std::cout << "  --keepalive MS       Probe the server after MS of silence (UDP PING, TCP keepalive)\n";
+    std::cout << "  --dead-after MS      Declare a silent server dead after MS (default 3x --keepalive)\n";
+    std::cout << "  --output FORMAT      text (default) or jsonl: one JSON object per event on stdout\n";
+    std::cout << "  --shm-ring PATH      Accept messages from local producers through a shared-memory ring (ShmRing.h)\n";
+    std::cout << "  --shm-slots N        Records the ring holds (default 4096)\n";
+    std::cout << "  --shm-slot-size N    Bytes per ring record (default 1024)\n";
+    std::cout << "  --no-stdin           Do not read stdin, run until a signal or the server ends the session\n";
+    std::cout << "  --outbox FILE        UDP: journal messages until confirmed, resend leftovers after /auth\n";
+    std::cout << "  --outbox-sync MS     How often the outbox is synced to disk (default 100)\n";
 }
 
 int main(int argc, char* argv[]) {
-    std::signal(SIGINT, signalHandler); // Set up signal handling for Ctrl+C
+    startLatencyDumpThread();            // SIGUSR1 prints latency histograms
     int timeoutMs = 250;     // Default: 250 ms
     int retries = 3; 
     std::string transport;  // Protocol type: tcp or udp
     std::string server;     // Server address
     int port = DEFAULT_PORT;        // Port number
     bool portSet = false;   // Flag to check if port is provided
+    std::string statsSocket; // Optional Unix socket for the statistics endpoint
+    std::string captureFile; // Optional wire capture output
+    std::string replayFile;  // Capture file to replay instead of running the client
+    double replaySpeed = 1.0;
+    std::string traceFile;   // Chrome trace JSON output
+    ReconnectPolicy reconnectPolicy;  // Resilient mode, off by default
+    std::chrono::milliseconds drainTimeout(2000);
+    double sendRate = 0;     // Messages per second, 0 = no pacing
+    double sendBurst = 1;
+    bool pipeline = false;   // UDP receive pipeline
+    std::vector<int> stageCpus;
+    bool lowLatency = false;  // Busy-polling receiver, locked memory
+    int spinCpu = -1;
+    HistoryLimits historyLimits;  // Disabled unless --history is given
+    std::string batchFile;   // Script read instead of stdin
+    std::chrono::milliseconds replyTimeout(5000);
+    LivenessPolicy liveness;  // Probing is off unless --keepalive is given
+    bool deadAfterSet = false;
+    bool jsonOutput = false;  // --output jsonl
+    std::string ringSocket;   // Shared-memory ring offered to local producers
+    uint32_t ringSlots = 4096;
+    uint32_t ringSlotSize = 1024;
+    bool noStdin = false;
+    std::string outboxFile;   // Crash-safe journal of unconfirmed messages
+    std::chrono::milliseconds outboxSync(100);
      
     // Parse command-line arguments
     for (int i = 1; i < argc; ++i) {
@@ -55,6 +139,61 @@ int main(int argc, char* argv[]) {
         }
            else if (arg == "-d" && i + 1 < argc) timeoutMs = std::stoi(argv[++i]);  // ✅ new
     else if (arg == "-r" && i + 1 < argc) retries = std::stoi(argv[++i]); 
+        else if (arg == "--stats-socket" && i + 1 < argc) statsSocket = argv[++i];
+        else if (arg == "--capture" && i + 1 < argc) captureFile = argv[++i];
+        else if (arg == "--replay" && i + 1 < argc) replayFile = argv[++i];
+        else if (arg == "--speed" && i + 1 < argc) replaySpeed = std::stod(argv[++i]);
+        else if (arg == "--trace" && i + 1 < argc) traceFile = argv[++i];
+        else if (arg == "--reconnect") reconnectPolicy.enabled = true;
+        else if (arg == "--reconnect-max" && i + 1 < argc) reconnectPolicy.maxDelay = std::chrono::milliseconds(std::stoi(argv[++i]));
+        else if (arg == "--outage-queue" && i + 1 < argc) reconnectPolicy.queueLimit = std::stoul(argv[++i]);
+        else if (arg == "--drain-timeout" && i + 1 < argc) drainTimeout = std::chrono::milliseconds(std::stoi(argv[++i]));
+        else if (arg == "--rate" && i + 1 < argc) sendRate = std::stod(argv[++i]);
+        else if (arg == "--burst" && i + 1 < argc) sendBurst = std::stod(argv[++i]);
+        else if (arg == "--pipeline") pipeline = true;
+        else if (arg == "--low-latency") lowLatency = true;
+        else if (arg == "--spin-cpu" && i + 1 < argc) spinCpu = std::stoi(argv[++i]);
+        else if (arg == "--history" && i + 1 < argc) historyLimits.messagesPerChannel = std::stoul(argv[++i]);
+        else if (arg == "--history-bytes" && i + 1 < argc) historyLimits.bytesPerChannel = std::stoul(argv[++i]);
+        else if (arg == "--history-channels" && i + 1 < argc) historyLimits.channels = std::stoul(argv[++i]);
+        else if (arg == "--batch" && i + 1 < argc) batchFile = argv[++i];
+        else if ((arg == "--reply-timeout" || arg == "--batch-timeout") && i + 1 < argc) replyTimeout = std::chrono::milliseconds(std::stoi(argv[++i]));
+        else if (arg == "--keepalive" && i + 1 < argc) {
+            liveness.enabled = true;
+            liveness.idle = std::chrono::milliseconds(std::stoi(argv[++i]));
+        }
+        else if (arg == "--output" && i + 1 < argc) {
+            std::string format = argv[++i];
+            if (format != "text" && format != "jsonl") {
+                std::cerr << "ERROR: Unknown output format: " << format << "\n";
+                return 1;
+            }
+            jsonOutput = format == "jsonl";
+        }
+        else if (arg == "--shm-ring" && i + 1 < argc) ringSocket = argv[++i];
+        else if ((arg == "--shm-slots" || arg == "--shm-slot-size") && i + 1 < argc) {
+            unsigned long value = std::stoul(argv[++i]);
+            uint32_t limit = arg == "--shm-slots" ? ShmInbox::MAX_SLOTS : ShmInbox::MAX_SLOT_SIZE;
+            if (value == 0 || value > limit) {
+                std::cerr << "ERROR: " << arg << " must be between 1 and " << limit << "\n";
+                return 1;
+            }
+            (arg == "--shm-slots" ? ringSlots : ringSlotSize) = static_cast<uint32_t>(value);
+        }
+        else if (arg == "--no-stdin") noStdin = true;
+        else if (arg == "--outbox" && i + 1 < argc) outboxFile = argv[++i];
+        else if (arg == "--outbox-sync" && i + 1 < argc) outboxSync = std::chrono::milliseconds(std::stoi(argv[++i]));
+        else if (arg == "--dead-after" && i + 1 < argc) {
+            liveness.deadAfter = std::chrono::milliseconds(std::stoi(argv[++i]));
+            deadAfterSet = true;
+        }
+        else if (arg == "--pin-stages" && i + 1 < argc) {
+            if (!parseCpuList(argv[++i], stageCpus)) {
+                std::cerr << "ERROR: Malformed CPU list: " << argv[i] << "\n";
+                return 1;
+            }
+            pipeline = true;
+        }
         else if (arg == "-h") {
             printHelp();
             return 0;
@@ -65,6 +204,8 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    if (!deadAfterSet) liveness.deadAfter = 3 * liveness.idle;
+
 // Check if required arguments are missing
 if (transport.empty() || server.empty()) {
     std::cerr << "ERROR: Missing required arguments (-t and -s are required).\n";
@@ -85,23 +226,114 @@ if (transport == "udp" && !portSet) {
     return 1;
 }
 
+    if (!batchFile.empty() && (!ringSocket.empty() || noStdin)) {
+        std::cerr << "ERROR: --batch cannot be combined with --shm-ring or --no-stdin\n";
+        return 1;
+    }
+
+    // Only UDP has CONFIRMs to tell when a message may leave the journal
+    if (!outboxFile.empty() && transport != "udp") {
+        std::cerr << "ERROR: --outbox requires -t udp\n";
+        return 1;
+    }
+
+    // Replay mode: re-drive a recorded session and exit
+    if (!replayFile.empty()) {
+        WireReplay replay(replayFile, transport, server, port, replaySpeed);
+        return replay.run() ? 0 : 1;
+    }
+
+    // SIGINT/SIGTERM are handled by the client loops through a signalfd (graceful shutdown).
+    // Installed before any further thread is started so that all threads keep them blocked.
+    if (!ShutdownSignals::install()) return 1;
+
+    // Message payloads, output lines and container nodes are recycled through the session pool
+    installSessionMemory();
+
+    // Low-latency mode: all memory is faulted in and locked before any client thread starts
+    if (lowLatency) prepareLowLatencyMemory();
+
+    // Optional wire capture, closed at exit so the file is always complete
+    if (!captureFile.empty()) {
+        static WireCapture capture(captureFile);
+        if (!capture.open()) return 1;
+        WireCapture::setActive(&capture);
+        std::atexit([]() {
+            WireCapture::setActive(nullptr);
+            capture.close();
+        });
+    }
+
+    // Optional event tracing, exported when the process exits
+    if (!traceFile.empty()) {
+        Trace::enable(traceFile);
+        std::atexit([]() { Trace::writeFile(); });
+    }
+
+    // Optional live statistics endpoint
+    std::unique_ptr<StatsServer> statsServer;
+    if (!statsSocket.empty()) {
+        statsServer = std::make_unique<StatsServer>(statsSocket);
+        if (!statsServer->start()) return 1;
+    }
+
+    // Optional shared-memory ring for local producers, drained by the input loop
+    std::unique_ptr<ShmInbox> inbox;
+    if (!ringSocket.empty()) {
+        inbox = std::make_unique<ShmInbox>(ringSocket, ringSlots, ringSlotSize);
+        if (!inbox->start()) return 1;
+    }
+
     // TCP client flow
     if (transport == "tcp") {
         TcpChatClient client(server, port);
-        globalClient = &client; 
+        client.setReconnectPolicy(reconnectPolicy);
+        client.setDrainTimeout(drainTimeout);
+        if (sendRate > 0) client.setPacing(sendRate, sendBurst);
+        if (lowLatency) client.setLowLatency(spinCpu);
+        client.setHistoryLimits(historyLimits);
+        client.setLiveness(liveness);
+        client.setReplyTimeout(replyTimeout);
+        if (jsonOutput) client.setEvents(ChatEvents::jsonLines(STDOUT_FILENO));
+        if (noStdin) client.setInputFd(-1);
+        client.setInbox(inbox.get());
+        if (!batchFile.empty() && !client.setBatchScript(batchFile)) return 1;
         if (!client.connectToServer()) return 1;
+        std::atexit(dumpLatencyAtExit);
         client.run();
+        if (client.batchFailed()) return 1;
+        return client.exitStatus();  // 1 after an ERR from the server
     }
 
     // UDP client flow
     else if (transport == "udp") {
+    // Outlives the client, closed (compacted and synced) after its threads have stopped
+    std::unique_ptr<Outbox> outbox;
+    if (!outboxFile.empty()) {
+        outbox = std::make_unique<Outbox>(outboxFile, 4 * 1024 * 1024, outboxSync);
+        if (!outbox->open()) return 1;
+    }
     UdpChatClient udpClient(server, port, timeoutMs, retries);
-        globalClient = &udpClient;
+        udpClient.setReconnectPolicy(reconnectPolicy);
+        udpClient.setDrainTimeout(drainTimeout);
+        if (sendRate > 0) udpClient.setPacing(sendRate, sendBurst);
+        if (pipeline) udpClient.setPipeline(stageCpus);
+        if (lowLatency) udpClient.setLowLatency(spinCpu);
+        udpClient.setHistoryLimits(historyLimits);
+        udpClient.setLiveness(liveness);
+        udpClient.setReplyTimeout(replyTimeout);
+        if (jsonOutput) udpClient.setEvents(ChatEvents::jsonLines(STDOUT_FILENO));
+        if (noStdin) udpClient.setInputFd(-1);
+        udpClient.setInbox(inbox.get());
+        udpClient.setOutbox(outbox.get());
+        if (!batchFile.empty() && !udpClient.setBatchScript(batchFile)) return 1;
         if (!udpClient.connectToServer()) return 1;
+        std::atexit(dumpLatencyAtExit);
         udpClient.run();
+        printf_debug("Total retransmissions: %d", totalRetransmissions.load());
+        if (udpClient.batchFailed()) return 1;
+        return udpClient.exitStatus();
     }
 
-    // Clean up and exit
-    delete globalClient;
     return 0;
 }
@@ -0,0 +1,692 @@
+// End-to-end benchmark: starts a local IPK25 server process and drives the real client binary
+// over loopback through a set of scenarios, for TCP and for UDP with each -d/-r pair given.
+// The client runs with --output jsonl; every message carries the monotonic time it was written
+// (by this tool into the client's stdin, or by the server for the flood), so latency is taken
+// when the client prints it:
+//
+//   idle       one message every 20 ms, round trip through the server's echo
+//   sustained  a steady rate (--rate) for a few seconds, echoed
+//   paste      10,000 lines written into stdin at once, echoed
+//   fanin      the server floods the joined channel from 8 members, one way to the client
+//   loss       like sustained at a lower rate with --loss dropped in each direction (UDP only,
+//              the server drops datagrams; TCP cannot lose on loopback)
+//
+// CPU is the client's user+system time (from wait4) per delivered message, retransmissions are
+// the client's "retransmit" records.
+//
+// Usage: ipk25bench [--client PATH] [--scenario a,b,...] [--udp d:r,d:r...] [--rate N]
+//                   [--loss P] [--seed N] [--quick]
+#include "MessageUdp.h"
+#include "UdpCommandBuilder.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <bitset>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <memory>
+#include <netinet/in.h>
+#include <poll.h>
+#include <random>
+#include <string>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+// Server behaviour for one run
+struct ServerConfig {
+    double loss = 0;            // Probability of dropping a UDP datagram, each direction
+    uint32_t seed = 1;
+    uint64_t floodCount = 0;    // Messages sent after JOIN to "flood"
+    int timeoutMs = 250;        // The server's own UDP retransmission
+    int retries = 5;
+};
+
+constexpr int FLOOD_MEMBERS = 8;
+constexpr size_t FLOOD_WINDOW = 64;          // Unconfirmed UDP flood messages
+constexpr size_t TCP_OUTPUT_LIMIT = 256 * 1024;
+
+// Minimal IPK25 server for the benchmark: confirms and echoes every MSG back from "echo",
+// answers AUTH/JOIN with REPLY OK, moves each UDP client to its own port and retransmits its
+// unconfirmed messages. Single-threaded poll loop in a child process.
+class BenchServer {
+public:
+    BenchServer(int udpFd, int tcpFd, const ServerConfig& config)
+        : udpListen(udpFd), tcpListen(tcpFd), config(config), random(config.seed) {}
+
+    void run() {
+        while (true) {
+            std::vector<pollfd> fds{{udpListen, POLLIN, 0}, {tcpListen, POLLIN, 0}};
+            for (auto& session : udpSessions) fds.push_back({session->fd, POLLIN, 0});
+            for (auto& conn : tcpConns) {
+                fds.push_back({conn->fd, static_cast<short>(POLLIN | (conn->output.empty() ? 0 : POLLOUT)), 0});
+            }
+            bool busy = false;
+            for (auto& session : udpSessions) busy |= session->flooding && session->pending.size() < FLOOD_WINDOW;
+            for (auto& conn : tcpConns) busy |= conn->flooding && conn->output.size() < TCP_OUTPUT_LIMIT;
+            if (poll(fds.data(), fds.size(), busy ? 0 : 10) < 0 && errno != EINTR) return;
+
+            if (fds[0].revents & POLLIN) receiveUdp(udpListen);
+            if (fds[1].revents & POLLIN) acceptTcp();
+            size_t index = 2;
+            for (size_t i = 0; i < udpSessions.size(); ++i, ++index) {
+                if (fds[index].revents & POLLIN) receiveUdp(udpSessions[i]->fd);
+            }
+            for (size_t i = 0; i < tcpConns.size(); ++i, ++index) {
+                TcpConn& conn = *tcpConns[i];
+                if (fds[index].revents & (POLLIN | POLLHUP | POLLERR)) readTcp(conn);
+                if (!conn.closed && !conn.output.empty()) flushTcp(conn);
+            }
+            tcpConns.erase(std::remove_if(tcpConns.begin(), tcpConns.end(),
+                                          [](const std::unique_ptr<TcpConn>& conn) {
+                                              if (conn->closed) ::close(conn->fd);
+                                              return conn->closed;
+                                          }),
+                           tcpConns.end());
+            for (auto& session : udpSessions) {
+                floodUdp(*session);
+                retransmit(*session);
+            }
+            for (auto& conn : tcpConns) floodTcp(*conn);
+        }
+    }
+
+private:
+    struct Pending {
+        std::vector<uint8_t> bytes;
+        Clock::time_point sentAt;
+        int retries = 0;
+    };
+    struct UdpSession {
+        int fd = -1;
+        sockaddr_in peer{};
+        uint16_t nextId = 0;
+        std::bitset<65536> seen;
+        std::map<uint16_t, Pending> pending;
+        bool flooding = false;
+        uint64_t flooded = 0;
+    };
+    struct TcpConn {
+        int fd = -1;
+        std::string input;
+        std::string output;
+        bool closed = false;
+        bool flooding = false;
+        uint64_t flooded = 0;
+    };
+
+    bool dropped() { return config.loss > 0 && std::uniform_real_distribution<double>(0, 1)(random) < config.loss; }
+
+    static std::string floodContent(uint64_t index) {
+        return "t=" + std::to_string(nowNs()) + " f=" + std::to_string(index);
+    }
+
+    static std::vector<std::string> fieldsOf(const UdpMessage& msg) {
+        std::vector<std::string> fields;
+        std::string field;
+        for (uint8_t byte : msg.payload) {
+            if (byte == 0) {
+                fields.push_back(field);
+                field.clear();
+            } else {
+                field.push_back(static_cast<char>(byte));
+            }
+        }
+        return fields;
+    }
+
+    void sendUdp(UdpSession& session, const std::vector<uint8_t>& bytes) {
+        if (dropped()) return;
+        sendto(session.fd, bytes.data(), bytes.size(), 0, reinterpret_cast<const sockaddr*>(&session.peer),
+               sizeof(session.peer));
+    }
+
+    void sendReliable(UdpSession& session, const UdpMessage& msg) {
+        Pending& pending = session.pending[msg.messageId];
+        pending.bytes = packUdpMessage(msg);
+        pending.sentAt = Clock::now();
+        sendUdp(session, pending.bytes);
+    }
+
+    UdpSession* sessionFor(const sockaddr_in& peer, bool create) {
+        for (auto& session : udpSessions) {
+            if (session->peer.sin_port == peer.sin_port && session->peer.sin_addr.s_addr == peer.sin_addr.s_addr) {
+                return session.get();
+            }
+        }
+        if (!create) return nullptr;
+        // The dynamic port the client switches to after the first reply
+        auto session = std::make_unique<UdpSession>();
+        session->fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+        sockaddr_in local{};
+        local.sin_family = AF_INET;
+        local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(session->fd, reinterpret_cast<sockaddr*>(&local), sizeof(local));
+        int size = 4 * 1024 * 1024;
+        setsockopt(session->fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        session->peer = peer;
+        udpSessions.push_back(std::move(session));
+        return udpSessions.back().get();
+    }
+
+    void receiveUdp(int fd) {
+        uint8_t buffer[65536];
+        while (true) {
+            sockaddr_in peer{};
+            socklen_t length = sizeof(peer);
+            ssize_t received = recvfrom(fd, buffer, sizeof(buffer), MSG_DONTWAIT, reinterpret_cast<sockaddr*>(&peer), &length);
+            if (received <= 0) return;
+            if (dropped()) continue;
+            UdpMessage msg;
+            if (!unpackUdpMessage(buffer, static_cast<size_t>(received), msg)) continue;
+            UdpSession* session = sessionFor(peer, msg.type == UdpMessageType::AUTH);
+            if (session != nullptr) handleUdp(*session, msg);
+        }
+    }
+
+    void handleUdp(UdpSession& session, const UdpMessage& msg) {
+        if (msg.type == UdpMessageType::CONFIRM) {
+            session.pending.erase(msg.messageId);
+            return;
+        }
+        sendUdp(session, packUdpMessage(buildConfirmUdpMessage(msg.messageId)));
+        if (session.seen[msg.messageId]) return;  // Retransmission, confirmed again
+        session.seen[msg.messageId] = true;
+
+        std::vector<std::string> fields = fieldsOf(msg);
+        switch (msg.type) {
+            case UdpMessageType::AUTH:
+            case UdpMessageType::JOIN:
+                sendReliable(session, buildReplyUdpMessage("OK", session.nextId++, msg.messageId, 1));
+                if (msg.type == UdpMessageType::JOIN && !fields.empty() && fields[0] == "flood") session.flooding = true;
+                break;
+            case UdpMessageType::MSG:
+                if (fields.size() >= 2) sendReliable(session, buildMsgUdpMessage("echo", fields[1], session.nextId++));
+                break;
+            case UdpMessageType::BYE:
+                session.flooding = false;
+                session.pending.clear();
+                break;
+            default:
+                break;
+        }
+    }
+
+    void floodUdp(UdpSession& session) {
+        while (session.flooding && session.pending.size() < FLOOD_WINDOW && session.flooded < config.floodCount) {
+            std::string member = "member" + std::to_string(session.flooded % FLOOD_MEMBERS);
+            sendReliable(session, buildMsgUdpMessage(member, floodContent(session.flooded), session.nextId++));
+            session.flooded++;
+        }
+    }
+
+    void retransmit(UdpSession& session) {
+        auto now = Clock::now();
+        for (auto it = session.pending.begin(); it != session.pending.end();) {
+            Pending& pending = it->second;
+            if (now - pending.sentAt < std::chrono::milliseconds(config.timeoutMs)) {
+                ++it;
+                continue;
+            }
+            if (pending.retries >= config.retries) {
+                it = session.pending.erase(it);
+                continue;
+            }
+            pending.retries++;
+            pending.sentAt = now;
+            sendUdp(session, pending.bytes);
+            ++it;
+        }
+    }
+
+    void acceptTcp() {
+        int fd = accept4(tcpListen, nullptr, nullptr, SOCK_NONBLOCK);
+        if (fd < 0) return;
+        auto conn = std::make_unique<TcpConn>();
+        conn->fd = fd;
+        tcpConns.push_back(std::move(conn));
+    }
+
+    void readTcp(TcpConn& conn) {
+        char buffer[65536];
+        while (true) {
+            ssize_t received = read(conn.fd, buffer, sizeof(buffer));
+            if (received == 0 || (received < 0 && errno != EAGAIN && errno != EINTR)) {
+                conn.closed = true;
+                return;
+            }
+            if (received < 0) break;
+            conn.input.append(buffer, static_cast<size_t>(received));
+        }
+        size_t start = 0, end;
+        while ((end = conn.input.find("\r\n", start)) != std::string::npos) {
+            handleTcpLine(conn, conn.input.substr(start, end - start));
+            start = end + 2;
+        }
+        conn.input.erase(0, start);
+    }
+
+    void handleTcpLine(TcpConn& conn, const std::string& line) {
+        auto startsWith = [&line](const char* prefix) { return strncasecmp(line.c_str(), prefix, std::strlen(prefix)) == 0; };
+        if (startsWith("AUTH ")) {
+            conn.output += "REPLY OK IS OK\r\n";
+        } else if (startsWith("JOIN ")) {
+            conn.output += "REPLY OK IS OK\r\n";
+            if (line.compare(5, 6, "flood ") == 0) conn.flooding = true;
+        } else if (startsWith("MSG FROM ")) {
+            size_t separator = line.find(" IS ");
+            if (separator != std::string::npos) conn.output += "MSG FROM echo IS " + line.substr(separator + 4) + "\r\n";
+        } else if (startsWith("BYE")) {
+            conn.closed = true;
+        }
+    }
+
+    void floodTcp(TcpConn& conn) {
+        while (conn.flooding && conn.output.size() < TCP_OUTPUT_LIMIT && conn.flooded < config.floodCount) {
+            conn.output += "MSG FROM member" + std::to_string(conn.flooded % FLOOD_MEMBERS) + " IS " +
+                           floodContent(conn.flooded) + "\r\n";
+            conn.flooded++;
+        }
+        if (conn.flooding && !conn.output.empty()) flushTcp(conn);
+    }
+
+    void flushTcp(TcpConn& conn) {
+        ssize_t written = send(conn.fd, conn.output.data(), conn.output.size(), MSG_NOSIGNAL);
+        if (written > 0) conn.output.erase(0, static_cast<size_t>(written));
+        else if (written < 0 && errno != EAGAIN) conn.closed = true;
+    }
+
+    int udpListen;
+    int tcpListen;
+    ServerConfig config;
+    std::mt19937 random;
+    std::vector<std::unique_ptr<UdpSession>> udpSessions;
+    std::vector<std::unique_ptr<TcpConn>> tcpConns;
+};
+
+// Binds the UDP and TCP listeners to the same free loopback port and forks the server
+pid_t startServer(const ServerConfig& config, uint16_t& port) {
+    int udp = -1, tcp = -1;
+    for (int attempt = 0; attempt < 20; ++attempt) {
+        udp = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(addr);
+        bind(udp, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        getsockname(udp, reinterpret_cast<sockaddr*>(&addr), &length);
+        tcp = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        int one = 1;
+        setsockopt(tcp, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(tcp, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0 && listen(tcp, 16) == 0) {
+            port = ntohs(addr.sin_port);
+            break;
+        }
+        close(udp);
+        close(tcp);
+        udp = tcp = -1;
+    }
+    if (udp < 0) {
+        std::fprintf(stderr, "ERROR: No free loopback port for the server\n");
+        return -1;
+    }
+    int size = 4 * 1024 * 1024;
+    setsockopt(udp, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    pid_t pid = fork();
+    if (pid == 0) {
+        BenchServer(udp, tcp, config).run();
+        _exit(0);
+    }
+    close(udp);
+    close(tcp);
+    return pid;
+}
+
+struct Scenario {
+    std::string name;
+    uint64_t count;           // Messages this tool writes, or the server floods
+    int64_t intervalNs;       // Between two writes, 0 = all at once
+    bool flood = false;
+    bool lossy = false;
+};
+
+struct Transport {
+    std::string name;         // tcp or udp
+    int timeoutMs = 0;
+    int retries = 0;
+};
+
+struct Result {
+    uint64_t expected = 0;
+    uint64_t delivered = 0;
+    uint64_t retransmissions = 0;
+    double seconds = 0;       // First write (or JOIN) to the last delivery
+    std::vector<int64_t> latencies;
+    double cpuSeconds = 0;
+    bool failed = false;
+};
+
+// The client binary under test, its stdin and its JSON-lines stdout
+class ClientProcess {
+public:
+    bool start(const std::string& path, const Transport& transport, uint16_t port) {
+        int input[2], output[2];
+        if (pipe2(input, O_CLOEXEC) != 0 || pipe2(output, O_CLOEXEC) != 0) {
+            perror("pipe");
+            return false;
+        }
+        std::vector<std::string> args{path, "-t", transport.name, "-s", "127.0.0.1", "-p", std::to_string(port),
+                                      "--output", "jsonl"};
+        if (transport.name == "udp") {
+            args.insert(args.end(), {"-d", std::to_string(transport.timeoutMs), "-r", std::to_string(transport.retries)});
+        }
+        pid = fork();
+        if (pid == 0) {
+            dup2(input[0], STDIN_FILENO);
+            dup2(output[1], STDOUT_FILENO);
+            int null = open("/dev/null", O_WRONLY);
+            dup2(null, STDERR_FILENO);  // The client logs every CONFIRM there
+            std::vector<char*> argv;
+            for (std::string& arg : args) argv.push_back(arg.data());
+            argv.push_back(nullptr);
+            execv(path.c_str(), argv.data());
+            _exit(127);
+        }
+        close(input[0]);
+        close(output[1]);
+        stdinFd = input[1];
+        stdoutFd = output[0];
+        fcntl(stdinFd, F_SETFL, O_NONBLOCK);
+        fcntl(stdoutFd, F_SETFL, O_NONBLOCK);
+        return pid > 0;
+    }
+
+    void queue(const std::string& text) { pendingInput += text; }
+
+    // Writes queued input and reads output for up to `timeoutMs`, calls onLine per output line.
+    // False once the client closed its stdout.
+    template <typename OnLine>
+    bool pump(int timeoutMs, OnLine&& onLine) {
+        pollfd fds[2] = {{stdoutFd, POLLIN, 0}, {stdinFd, static_cast<short>(pendingInput.empty() ? 0 : POLLOUT), 0}};
+        int count = stdinFd >= 0 ? 2 : 1;
+        if (poll(fds, count, timeoutMs) < 0 && errno != EINTR) return false;
+        if (count == 2 && (fds[1].revents & POLLOUT)) {
+            ssize_t written = write(stdinFd, pendingInput.data(), pendingInput.size());
+            if (written > 0) pendingInput.erase(0, static_cast<size_t>(written));
+        }
+        if (fds[0].revents & (POLLIN | POLLHUP)) {
+            char buffer[65536];
+            ssize_t received;
+            while ((received = read(stdoutFd, buffer, sizeof(buffer))) > 0) {
+                outputBuffer.append(buffer, static_cast<size_t>(received));
+            }
+            size_t start = 0, end;
+            while ((end = outputBuffer.find('\n', start)) != std::string::npos) {
+                onLine(std::string_view(outputBuffer).substr(start, end - start));
+                start = end + 1;
+            }
+            outputBuffer.erase(0, start);
+            if (received == 0) return false;
+        }
+        return true;
+    }
+
+    bool inputFlushed() const { return pendingInput.empty(); }
+
+    // Closes stdin (the client says BYE and exits) and returns its CPU time
+    double finish() {
+        if (stdinFd >= 0) close(stdinFd);
+        stdinFd = -1;
+        auto deadline = Clock::now() + std::chrono::seconds(5);
+        while (pump(100, [](std::string_view) {}) && Clock::now() < deadline) {
+        }
+        int status = 0;
+        rusage usage{};
+        if (wait4(pid, &status, WNOHANG, &usage) == 0) {
+            kill(pid, SIGKILL);
+            wait4(pid, &status, 0, &usage);
+        }
+        close(stdoutFd);
+        return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+    }
+
+private:
+    pid_t pid = -1;
+    int stdinFd = -1;
+    int stdoutFd = -1;
+    std::string pendingInput;
+    std::string outputBuffer;
+};
+
+bool contains(std::string_view line, std::string_view text) {
+    return line.find(text) != std::string_view::npos;
+}
+
+// Send time carried by a "msg" record as "t=<ns>"
+int64_t stampOf(std::string_view line) {
+    size_t at = line.find("\"content\":\"t=");
+    if (at == std::string_view::npos) return -1;
+    int64_t value = 0;
+    for (size_t i = at + 13; i < line.size() && line[i] >= '0' && line[i] <= '9'; ++i) value = value * 10 + (line[i] - '0');
+    return value;
+}
+
+Result runScenario(const std::string& clientPath, const Scenario& scenario, const Transport& transport,
+                   const ServerConfig& baseConfig) {
+    Result result;
+    ServerConfig config = baseConfig;
+    if (!scenario.lossy) config.loss = 0;
+    config.floodCount = scenario.flood ? scenario.count : 0;
+    uint16_t port = 0;
+    pid_t server = startServer(config, port);
+    if (server < 0) {
+        result.failed = true;
+        return result;
+    }
+    ClientProcess client;
+    if (!client.start(clientPath, transport, port)) {
+        kill(server, SIGKILL);
+        waitpid(server, nullptr, 0);
+        result.failed = true;
+        return result;
+    }
+
+    int replies = 0;
+    int64_t firstNs = 0, lastNs = 0;
+    auto onLine = [&](std::string_view line) {
+        if (contains(line, "\"event\":\"reply\"")) {
+            replies += contains(line, "\"ok\":true") ? 1 : 0;
+        } else if (contains(line, "\"event\":\"retransmit\"")) {
+            result.retransmissions++;
+        } else if (contains(line, "\"event\":\"msg\"")) {
+            int64_t stamp = stampOf(line);
+            if (stamp < 0) return;
+            lastNs = nowNs();
+            result.latencies.push_back(lastNs - stamp);
+            result.delivered++;
+        }
+    };
+    auto waitReplies = [&](int count) {
+        auto deadline = Clock::now() + std::chrono::seconds(5);
+        while (replies < count && Clock::now() < deadline && client.pump(50, onLine)) {
+        }
+        return replies >= count;
+    };
+
+    client.queue("/auth bench secret Bench\n");
+    bool ready = waitReplies(1);
+    if (ready) {
+        client.queue(scenario.flood ? "/join flood\n" : "/join bench\n");
+        firstNs = nowNs();  // The flood starts with the JOIN
+        ready = waitReplies(2);
+    }
+    result.expected = scenario.count;
+    if (ready) {
+        uint64_t written = 0;
+        if (!scenario.flood) firstNs = nowNs();
+        int64_t quietSince = nowNs();
+        uint64_t seen = 0;
+        bool open = true;
+        while (open && result.delivered < result.expected) {
+            int64_t now = nowNs();
+            if (!scenario.flood && written < scenario.count) {
+                if (scenario.intervalNs == 0) {
+                    std::string lines;
+                    for (; written < scenario.count; ++written) {
+                        lines += "t=" + std::to_string(now) + " i=" + std::to_string(written) + "\n";
+                    }
+                    client.queue(lines);
+                } else {
+                    while (written < scenario.count && firstNs + static_cast<int64_t>(written) * scenario.intervalNs <= now) {
+                        client.queue("t=" + std::to_string(nowNs()) + " i=" + std::to_string(written++) + "\n");
+                    }
+                }
+            }
+            int64_t nextDue = firstNs + static_cast<int64_t>(written) * scenario.intervalNs - now;
+            int wait = (written < scenario.count && scenario.intervalNs > 0) ? static_cast<int>(std::max<int64_t>(0, nextDue / 1000000)) : 20;
+            open = client.pump(client.inputFlushed() ? wait : 0, onLine);
+            if (result.delivered != seen) {
+                seen = result.delivered;
+                quietSince = nowNs();
+            }
+            // Done writing and nothing arrived for a while: the rest is lost
+            bool allWritten = scenario.flood || (written == scenario.count && client.inputFlushed());
+            if (allWritten && nowNs() - quietSince > 3000000000LL) break;
+        }
+    } else {
+        result.failed = true;
+    }
+    result.seconds = lastNs > firstNs ? (lastNs - firstNs) / 1e9 : 0;
+    result.cpuSeconds = client.finish();
+    kill(server, SIGTERM);
+    waitpid(server, nullptr, 0);
+    return result;
+}
+
+double percentileMs(std::vector<int64_t>& values, double fraction) {
+    if (values.empty()) return 0;
+    size_t index = std::min(values.size() - 1, static_cast<size_t>(fraction * values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index] / 1e6;
+}
+
+void printRow(const Scenario& scenario, const Transport& transport, Result& result) {
+    std::string name = transport.name;
+    if (transport.name == "udp") name += " -d " + std::to_string(transport.timeoutMs) + " -r " + std::to_string(transport.retries);
+    if (result.failed) {
+        std::printf("%-10s %-18s  session could not be established\n", scenario.name.c_str(), name.c_str());
+        return;
+    }
+    double rate = result.seconds > 0 ? result.delivered / result.seconds : 0;
+    double cpuUs = result.delivered > 0 ? result.cpuSeconds * 1e6 / result.delivered : 0;
+    std::string retrans = transport.name == "udp" ? std::to_string(result.retransmissions) : "-";
+    std::printf("%-10s %-18s %7llu/%-7llu %10.0f %9.2f %9.2f %10.1f %8s\n", scenario.name.c_str(), name.c_str(),
+                static_cast<unsigned long long>(result.delivered), static_cast<unsigned long long>(result.expected), rate,
+                percentileMs(result.latencies, 0.5), percentileMs(result.latencies, 0.99), cpuUs, retrans.c_str());
+    std::fflush(stdout);
+}
+
+bool parseUdpConfigs(const std::string& text, std::vector<Transport>& transports) {
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find(',', start);
+        if (end == std::string::npos) end = text.size();
+        std::string item = text.substr(start, end - start);
+        size_t colon = item.find(':');
+        if (colon == std::string::npos) return false;
+        transports.push_back({"udp", std::stoi(item.substr(0, colon)), std::stoi(item.substr(colon + 1))});
+        start = end + 1;
+    }
+    return true;
+}
+
+// Next to the tool's parent directory, like the shared-library tools find libipk25chat.so
+std::string defaultClientPath() {
+    char self[4096];
+    ssize_t length = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    if (length <= 0) return "./ipk25chat-client";
+    std::string path(self, static_cast<size_t>(length));
+    path = path.substr(0, path.rfind('/'));
+    return path.substr(0, path.rfind('/')) + "/ipk25chat-client";
+}
+
+void printUsage() {
+    std::printf("Usage: ipk25bench [--client PATH] [--scenario a,b,...] [--udp d:r,d:r...] [--rate N]\n"
+                "                  [--loss P] [--seed N] [--quick]\n"
+                "Scenarios: idle, sustained, paste, fanin, loss (default: all)\n");
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    std::string clientPath = defaultClientPath();
+    std::string selected = "idle,sustained,paste,fanin,loss";
+    std::string udpConfigs = "250:3,100:5";
+    double rate = 5000;
+    ServerConfig server;
+    server.loss = 0.2;
+    bool quick = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--client" && i + 1 < argc) clientPath = argv[++i];
+        else if (arg == "--scenario" && i + 1 < argc) selected = argv[++i];
+        else if (arg == "--udp" && i + 1 < argc) udpConfigs = argv[++i];
+        else if (arg == "--rate" && i + 1 < argc) rate = std::stod(argv[++i]);
+        else if (arg == "--loss" && i + 1 < argc) server.loss = std::stod(argv[++i]);
+        else if (arg == "--seed" && i + 1 < argc) server.seed = static_cast<uint32_t>(std::stoul(argv[++i]));
+        else if (arg == "--quick") quick = true;
+        else {
+            printUsage();
+            return arg == "-h" ? 0 : 1;
+        }
+    }
+    if (access(clientPath.c_str(), X_OK) != 0) {
+        std::fprintf(stderr, "ERROR: Client binary not found: %s (use --client)\n", clientPath.c_str());
+        return 1;
+    }
+    std::vector<Transport> transports{{"tcp", 0, 0}};
+    if (!parseUdpConfigs(udpConfigs, transports) || rate <= 0) {
+        printUsage();
+        return 1;
+    }
+
+    uint64_t scale = quick ? 10 : 1;
+    auto perRate = [](double perSecond) { return static_cast<int64_t>(1e9 / perSecond); };
+    std::vector<Scenario> scenarios{
+        {"idle", quick ? 50u : 100u, 20000000, false, false},
+        {"sustained", static_cast<uint64_t>(rate * 3) / scale, perRate(rate), false, false},
+        {"paste", 10000 / scale, 0, false, false},
+        {"fanin", 20000 / scale, 0, true, false},
+        {"loss", static_cast<uint64_t>(std::min(rate, 500.0) * 4) / scale, perRate(std::min(rate, 500.0)), false, true},
+    };
+
+    std::printf("Client: %s, loss scenario drops %.0f%% each way (seed %u)\n", clientPath.c_str(), server.loss * 100,
+                server.seed);
+    std::printf("Latency: round trip through the server's echo (fanin: server to client), CPU: client per delivered message\n\n");
+    std::printf("%-10s %-18s %15s %10s %9s %9s %10s %8s\n", "scenario", "transport", "delivered", "msg/s", "p50 ms",
+                "p99 ms", "CPU us/msg", "retrans");
+    for (const Scenario& scenario : scenarios) {
+        if (("," + selected + ",").find("," + scenario.name + ",") == std::string::npos) continue;
+        for (const Transport& transport : transports) {
+            if (scenario.lossy && transport.name == "tcp") continue;  // No loss on loopback TCP
+            Result result = runScenario(clientPath, scenario, transport, server);
+            printRow(scenario, transport, result);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,147 @@
+// UDP-to-TCP gateway: edge devices speak the UDP variant of IPK25-CHAT to the gateway, which
+// keeps one TCP session per device to a server that only offers TCP. CONFIRM, deduplication
+// and retransmission are handled at the gateway. Each --threads loop serves its sessions from
+// one epoll instance.
+//
+// Usage: ipk25gw -s server [-p port] [-l listen_port] [-d timeout_ms] [-r retries]
+//                [--threads N] [--stats-socket PATH]
+//        ipk25gw --bench [-n messages]
+#include "Gateway.h"
+#include "Shutdown.h"
+#include "Stats.h"
+#include "StatsServer.h"
+#include "UdpCommandBuilder.h"
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <poll.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+void printUsage() {
+    std::cout << "Usage: ipk25gw -s server [-p port] [-l listen_port] [-d timeout_ms] [-r retries]\n"
+                 "               [--threads N] [--stats-socket PATH]\n"
+                 "       ipk25gw --bench [-n messages]\n";
+}
+
+// Transcodes `count` messages each way with the same unpacking, parsing and packing the gateway
+// does per message and reports the rate of one core
+void runBench(uint64_t count) {
+    const std::string content = "Status report from edge device 0042: all sensors nominal, 23.5 C";
+    std::vector<uint8_t> datagram = packUdpMessage(buildMsgUdpMessage("edge0042", content, 1));
+    const std::string serverLine = "MSG FROM operator IS " + content;
+
+    std::string line;
+    std::string displayName;
+    size_t bytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < count; ++i) {
+        UdpMessage msg;
+        unpackUdpMessage(datagram, msg);
+        transcodeUdpToTcp(msg, line, displayName);
+        bytes += line.size();
+    }
+    auto middle = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < count; ++i) {
+        UdpMessage msg;
+        transcodeTcpToUdp(serverLine, static_cast<uint16_t>(i), 0, msg);
+        bytes += packUdpMessage(msg).size();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    auto report = [count](const char* direction, std::chrono::steady_clock::duration elapsed) {
+        double seconds = std::chrono::duration<double>(elapsed).count();
+        std::printf("%s %10.0f messages/s  %6.1f ns/message\n", direction, count / seconds, seconds * 1e9 / count);
+    };
+    report("UDP -> TCP:", middle - start);
+    report("TCP -> UDP:", end - middle);
+    std::printf("(%llu messages each way, %zu bytes produced)\n", static_cast<unsigned long long>(count), bytes);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    GatewayConfig config;
+    unsigned threads = 1;
+    std::string statsSocket;
+    bool bench = false;
+    uint64_t benchMessages = 2000000;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-s" && i + 1 < argc) config.server = argv[++i];
+        else if (arg == "-p" && i + 1 < argc) config.serverPort = std::stoi(argv[++i]);
+        else if (arg == "-l" && i + 1 < argc) config.listenPort = static_cast<uint16_t>(std::stoi(argv[++i]));
+        else if (arg == "-d" && i + 1 < argc) config.timeoutMs = std::stoi(argv[++i]);
+        else if (arg == "-r" && i + 1 < argc) config.retries = std::stoi(argv[++i]);
+        else if (arg == "--threads" && i + 1 < argc) threads = static_cast<unsigned>(std::stoul(argv[++i]));
+        else if (arg == "--stats-socket" && i + 1 < argc) statsSocket = argv[++i];
+        else if (arg == "--bench") bench = true;
+        else if (arg == "-n" && i + 1 < argc) benchMessages = std::stoull(argv[++i]);
+        else {
+            printUsage();
+            return arg == "-h" ? 0 : 1;
+        }
+    }
+    if (bench) {
+        runBench(benchMessages);
+        return 0;
+    }
+    if (config.server.empty() || threads == 0) {
+        printUsage();
+        return 1;
+    }
+
+    // Blocked before the loops start, so only the main thread sees SIGINT/SIGTERM
+    if (!ShutdownSignals::install()) return 1;
+    Wakeup stop;
+    std::vector<std::unique_ptr<Gateway>> loops;
+    for (unsigned i = 0; i < threads; ++i) {
+        loops.push_back(std::make_unique<Gateway>(config, stop));
+        if (!loops.back()->open()) return 1;
+    }
+
+    int gaugeId = registerStatGauge("ipk25_gateway_sessions", "Gateway sessions currently open.", [&loops]() {
+        uint64_t open = 0;
+        for (const auto& loop : loops) open += loop->totals().sessions.load(std::memory_order_relaxed);
+        return static_cast<int64_t>(open);
+    });
+    std::unique_ptr<StatsServer> statsServer;
+    if (!statsSocket.empty()) {
+        statsServer = std::make_unique<StatsServer>(statsSocket);
+        if (!statsServer->start()) return 1;
+    }
+
+    std::vector<std::thread> workers;
+    for (auto& loop : loops) workers.emplace_back([&loop]() { loop->run(); });
+    std::cerr << "Gateway listening on UDP port " << config.listenPort << ", forwarding to " << config.server << ":"
+              << config.serverPort << " over TCP (" << threads << " loop(s))" << std::endl;
+
+    pollfd signals{ShutdownSignals::fd(), POLLIN, 0};
+    while (poll(&signals, 1, -1) == -1 && errno == EINTR) {
+    }
+    int signal = ShutdownSignals::read();
+    std::cerr << (signal != 0 ? strsignal(signal) : "Stopped") << ", closing the sessions." << std::endl;
+    stop.notify();
+    for (std::thread& worker : workers) worker.join();
+    if (statsServer) statsServer->stop();
+    unregisterStatGauge(gaugeId);
+
+    uint64_t opened = 0, upstream = 0, downstream = 0, retransmissions = 0, duplicates = 0;
+    for (const auto& loop : loops) {
+        const GatewayTotals& totals = loop->totals();
+        opened += totals.sessionsOpened;
+        upstream += totals.upstream;
+        downstream += totals.downstream;
+        retransmissions += totals.retransmissions;
+        duplicates += totals.duplicates;
+    }
+    std::cerr << "Sessions: " << opened << ", UDP->TCP: " << upstream << ", TCP->UDP: " << downstream
+              << ", retransmissions: " << retransmissions << ", duplicates: " << duplicates << std::endl;
+    return 0;
+}
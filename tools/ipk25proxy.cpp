@@ -0,0 +1,531 @@
+// Network impairment proxy for testing the client without tc netem: sits between client and
+// server on loopback and applies seeded loss, duplication, reordering, delay and jitter per
+// direction ("up" = client to server, "down" = server to client).
+//
+// UDP: every client gets its own upstream socket. When the server answers from its dynamic
+// port, the proxy answers the client from a new port of its own as well, so the client's port
+// switch is exercised, and forwards the rest of the session to the server's dynamic port.
+// TCP: the byte stream is relayed with delay and jitter only (in order; dropping bytes of a
+// stream is not loss, the kernel would have retransmitted them).
+//
+// Every datagram's fate is written to --log (time, direction, type, MessageID, action); the
+// totals per direction and message type are printed on exit, so a client's retransmission
+// count can be checked against the loss injected into its MSGs and the server's CONFIRMs.
+//
+// Usage: ipk25proxy -s server [-p port] [-l listen_port] [--up PROFILE] [--down PROFILE]
+//                   [--profile PROFILE] [--seed N] [--log FILE]
+// PROFILE: comma-separated loss=P,dup=P,reorder=P,delay=MS,jitter=MS
+#include "Shutdown.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <memory>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <queue>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Profile {
+    double loss = 0;
+    double duplicate = 0;
+    double reorder = 0;       // Held back behind the datagrams that follow
+    double delayMs = 0;
+    double jitterMs = 0;      // Uniform in [-jitter, +jitter] around delay
+};
+
+bool parseProfile(const std::string& text, Profile& profile) {
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find(',', start);
+        if (end == std::string::npos) end = text.size();
+        std::string item = text.substr(start, end - start);
+        size_t equals = item.find('=');
+        if (equals == std::string::npos) return false;
+        std::string key = item.substr(0, equals);
+        double value;
+        try {
+            value = std::stod(item.substr(equals + 1));
+        } catch (const std::exception&) {
+            return false;
+        }
+        if (key == "loss") profile.loss = value;
+        else if (key == "dup") profile.duplicate = value;
+        else if (key == "reorder") profile.reorder = value;
+        else if (key == "delay") profile.delayMs = value;
+        else if (key == "jitter") profile.jitterMs = value;
+        else return false;
+        start = end + 1;
+    }
+    return true;
+}
+
+std::string describe(const Profile& profile) {
+    char text[160];
+    std::snprintf(text, sizeof(text), "loss=%g dup=%g reorder=%g delay=%gms jitter=%gms", profile.loss,
+                  profile.duplicate, profile.reorder, profile.delayMs, profile.jitterMs);
+    return text;
+}
+
+const char* typeName(uint8_t type) {
+    switch (type) {
+        case 0x00: return "CONFIRM";
+        case 0x01: return "REPLY";
+        case 0x02: return "AUTH";
+        case 0x03: return "JOIN";
+        case 0x04: return "MSG";
+        case 0xFD: return "PING";
+        case 0xFE: return "ERR";
+        case 0xFF: return "BYE";
+        default: return "OTHER";
+    }
+}
+
+// Decisions for one direction, drawn from its own generator so the other direction's traffic
+// does not change them
+class Impairment {
+public:
+    Impairment(const Profile& profile, uint32_t seed) : profile(profile), random(seed) {}
+
+    struct Decision {
+        bool drop = false;
+        bool duplicate = false;
+        bool reorder = false;
+        Clock::duration delay{0};
+    };
+
+    Decision decide() {
+        Decision decision;
+        decision.drop = chance(profile.loss);
+        decision.duplicate = !decision.drop && chance(profile.duplicate);
+        decision.reorder = !decision.drop && chance(profile.reorder);
+        double delayMs = profile.delayMs;
+        if (profile.jitterMs > 0) delayMs += std::uniform_real_distribution<double>(-profile.jitterMs, profile.jitterMs)(random);
+        // Reordered datagrams wait long enough for the following ones to overtake them
+        if (decision.reorder) delayMs += profile.delayMs + 2 * profile.jitterMs + 5;
+        decision.delay = std::chrono::microseconds(static_cast<int64_t>(std::max(0.0, delayMs) * 1000));
+        return decision;
+    }
+
+    // Stream delay, never earlier than the previous chunk so the bytes stay in order
+    Clock::time_point streamDue(Clock::time_point& last) {
+        Clock::time_point due = Clock::now() + decide().delay;
+        last = std::max(last, due);
+        return last;
+    }
+
+    const Profile& settings() const { return profile; }
+
+private:
+    bool chance(double probability) {
+        return probability > 0 && std::uniform_real_distribution<double>(0, 1)(random) < probability;
+    }
+
+    Profile profile;
+    std::mt19937 random;
+};
+
+// Totals per direction and message type
+struct Counters {
+    uint64_t forwarded[256] = {};
+    uint64_t dropped[256] = {};
+    uint64_t duplicated[256] = {};
+    uint64_t reordered[256] = {};
+    uint64_t streamBytes = 0;
+};
+
+enum Direction { UP = 0, DOWN = 1 };
+const char* const DIRECTION_NAMES[2] = {"up", "down"};
+
+struct UdpSession {
+    sockaddr_in client{};
+    int upstreamFd = -1;          // Talks to the server
+    int downstreamFd = -1;        // The proxy's own dynamic port, once the server switched
+    sockaddr_in server{};         // Well-known address, then the server's dynamic port
+    Clock::time_point lastActivity;
+};
+
+struct TcpPair {
+    int clientFd = -1;
+    int serverFd = -1;
+    std::deque<std::pair<Clock::time_point, std::string>> delayed[2];  // Per direction
+    std::string output[2];        // Due bytes not yet written: to the server, to the client
+    Clock::time_point lastDue[2];
+    bool closed = false;
+};
+
+// A datagram waiting for its delay
+struct Delayed {
+    Clock::time_point due;
+    uint64_t order;
+    int fd;
+    sockaddr_in to;
+    std::vector<uint8_t> bytes;
+    bool operator>(const Delayed& other) const { return due != other.due ? due > other.due : order > other.order; }
+};
+
+class Proxy {
+public:
+    Proxy(const sockaddr_in& server, uint16_t listenPort, const Profile& up, const Profile& down, uint32_t seed,
+          FILE* log)
+        : serverAddr(server), listenPort(listenPort), impairments{{up, seed}, {down, seed + 1}}, log(log) {}
+
+    bool open() {
+        sockaddr_in local{};
+        local.sin_family = AF_INET;
+        local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        local.sin_port = htons(listenPort);
+        udpListen = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        tcpListen = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int one = 1;
+        setsockopt(tcpListen, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (udpListen < 0 || tcpListen < 0 || bind(udpListen, reinterpret_cast<sockaddr*>(&local), sizeof(local)) < 0 ||
+            bind(tcpListen, reinterpret_cast<sockaddr*>(&local), sizeof(local)) < 0 || listen(tcpListen, 64) < 0) {
+            perror("ERROR: Unable to listen");
+            return false;
+        }
+        start = Clock::now();
+        return true;
+    }
+
+    // Runs until SIGINT/SIGTERM
+    void run() {
+        while (true) {
+            std::vector<pollfd> fds{{ShutdownSignals::fd(), POLLIN, 0}, {udpListen, POLLIN, 0}, {tcpListen, POLLIN, 0}};
+            for (auto& session : sessions) {
+                fds.push_back({session->upstreamFd, POLLIN, 0});
+                fds.push_back({session->downstreamFd, static_cast<short>(session->downstreamFd >= 0 ? POLLIN : 0), 0});
+            }
+            for (auto& pair : pairs) {
+                fds.push_back({pair->clientFd, static_cast<short>(POLLIN | (pair->output[DOWN].empty() ? 0 : POLLOUT)), 0});
+                fds.push_back({pair->serverFd, static_cast<short>(POLLIN | (pair->output[UP].empty() ? 0 : POLLOUT)), 0});
+            }
+            if (poll(fds.data(), fds.size(), nextTimeoutMs()) < 0 && errno != EINTR) {
+                perror("ERROR: poll");
+                return;
+            }
+            if (fds[0].revents & POLLIN) return;
+
+            if (fds[1].revents & POLLIN) receiveFromClients(udpListen, nullptr);
+            if (fds[2].revents & POLLIN) acceptTcp();
+            size_t index = 3;
+            for (size_t i = 0; i < sessions.size(); ++i, index += 2) {
+                if (fds[index].revents & POLLIN) receiveFromServer(*sessions[i]);
+                if (fds[index + 1].revents & POLLIN) receiveFromClients(sessions[i]->downstreamFd, sessions[i].get());
+            }
+            for (size_t i = 0; i < pairs.size(); ++i, index += 2) {
+                TcpPair& pair = *pairs[i];
+                if (fds[index].revents & (POLLIN | POLLHUP | POLLERR)) readStream(pair, pair.clientFd, UP);
+                if (fds[index + 1].revents & (POLLIN | POLLHUP | POLLERR)) readStream(pair, pair.serverFd, DOWN);
+            }
+            releaseDue();
+            expireSessions();
+        }
+    }
+
+    void printTotals() const {
+        for (int direction : {UP, DOWN}) {
+            const Counters& counters = totals[direction];
+            std::fprintf(stderr, "%-4s %s\n", DIRECTION_NAMES[direction], describe(impairments[direction].settings()).c_str());
+            for (int type = 0; type < 256; ++type) {
+                uint64_t seen = counters.forwarded[type] + counters.dropped[type];
+                if (seen == 0) continue;
+                std::fprintf(stderr, "       %-8s %8llu datagrams  %7llu dropped  %7llu duplicated  %7llu reordered\n",
+                             typeName(static_cast<uint8_t>(type)), static_cast<unsigned long long>(seen),
+                             static_cast<unsigned long long>(counters.dropped[type]),
+                             static_cast<unsigned long long>(counters.duplicated[type]),
+                             static_cast<unsigned long long>(counters.reordered[type]));
+            }
+            if (counters.streamBytes > 0) {
+                std::fprintf(stderr, "       TCP      %8llu bytes relayed\n", static_cast<unsigned long long>(counters.streamBytes));
+            }
+        }
+    }
+
+private:
+    double elapsedSeconds() const { return std::chrono::duration<double>(Clock::now() - start).count(); }
+
+    // Applies the direction's profile to one datagram and logs its fate
+    void impairDatagram(Direction direction, int fd, const sockaddr_in& to, const uint8_t* data, size_t length) {
+        Impairment::Decision decision = impairments[direction].decide();
+        uint8_t type = data[0];
+        int messageId = length >= 3 ? (data[1] << 8 | data[2]) : -1;
+        Counters& counters = totals[direction];
+        if (log != nullptr) {
+            std::fprintf(log, "%.6f %s %s id=%d %s delay=%.1fms%s%s\n", elapsedSeconds(), DIRECTION_NAMES[direction],
+                         typeName(type), messageId, decision.drop ? "drop" : "forward",
+                         std::chrono::duration<double, std::milli>(decision.delay).count(),
+                         decision.duplicate ? " dup" : "", decision.reorder ? " reorder" : "");
+        }
+        if (decision.drop) {
+            counters.dropped[type]++;
+            return;
+        }
+        counters.forwarded[type]++;
+        if (decision.reorder) counters.reordered[type]++;
+        Delayed delayed{Clock::now() + decision.delay, nextOrder++, fd, to, std::vector<uint8_t>(data, data + length)};
+        if (decision.duplicate) {
+            counters.duplicated[type]++;
+            Delayed copy = delayed;
+            copy.order = nextOrder++;
+            queue.push(std::move(copy));
+        }
+        queue.push(std::move(delayed));
+    }
+
+    UdpSession* sessionFor(const sockaddr_in& client) {
+        for (auto& session : sessions) {
+            if (session->client.sin_port == client.sin_port && session->client.sin_addr.s_addr == client.sin_addr.s_addr) {
+                return session.get();
+            }
+        }
+        auto session = std::make_unique<UdpSession>();
+        session->client = client;
+        session->server = serverAddr;
+        session->upstreamFd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        sessions.push_back(std::move(session));
+        return sessions.back().get();
+    }
+
+    // From a client, to the listen port or to the session's own dynamic port
+    void receiveFromClients(int fd, UdpSession* known) {
+        uint8_t buffer[65536];
+        while (true) {
+            sockaddr_in from{};
+            socklen_t length = sizeof(from);
+            ssize_t received = recvfrom(fd, buffer, sizeof(buffer), MSG_DONTWAIT, reinterpret_cast<sockaddr*>(&from), &length);
+            if (received <= 0) return;
+            UdpSession* session = known != nullptr ? known : sessionFor(from);
+            session->lastActivity = Clock::now();
+            impairDatagram(UP, session->upstreamFd, session->server, buffer, static_cast<size_t>(received));
+        }
+    }
+
+    void receiveFromServer(UdpSession& session) {
+        uint8_t buffer[65536];
+        while (true) {
+            sockaddr_in from{};
+            socklen_t length = sizeof(from);
+            ssize_t received = recvfrom(session.upstreamFd, buffer, sizeof(buffer), MSG_DONTWAIT,
+                                        reinterpret_cast<sockaddr*>(&from), &length);
+            if (received <= 0) return;
+            session.lastActivity = Clock::now();
+            // The server moved the session to its dynamic port: follow it and move the client too
+            if (from.sin_port != session.server.sin_port || from.sin_addr.s_addr != session.server.sin_addr.s_addr) {
+                session.server = from;
+                if (session.downstreamFd < 0) openDownstream(session);
+                if (log != nullptr) {
+                    std::fprintf(log, "%.6f switch server port %d\n", elapsedSeconds(), ntohs(from.sin_port));
+                }
+            }
+            int fd = session.downstreamFd >= 0 ? session.downstreamFd : udpListen;
+            impairDatagram(DOWN, fd, session.client, buffer, static_cast<size_t>(received));
+        }
+    }
+
+    void openDownstream(UdpSession& session) {
+        session.downstreamFd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        sockaddr_in local{};
+        local.sin_family = AF_INET;
+        local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(session.downstreamFd, reinterpret_cast<sockaddr*>(&local), sizeof(local));
+    }
+
+    void acceptTcp() {
+        int clientFd = accept4(tcpListen, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (clientFd < 0) return;
+        int serverFd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (connect(serverFd, reinterpret_cast<const sockaddr*>(&serverAddr), sizeof(serverAddr)) < 0) {
+            perror("ERROR: Unable to connect to the server");
+            close(serverFd);
+            close(clientFd);
+            return;
+        }
+        fcntl(serverFd, F_SETFL, O_NONBLOCK);
+        auto pair = std::make_unique<TcpPair>();
+        pair->clientFd = clientFd;
+        pair->serverFd = serverFd;
+        pairs.push_back(std::move(pair));
+        if (log != nullptr) std::fprintf(log, "%.6f tcp connection\n", elapsedSeconds());
+    }
+
+    void readStream(TcpPair& pair, int fd, Direction direction) {
+        char buffer[65536];
+        ssize_t received = read(fd, buffer, sizeof(buffer));
+        if (received == 0 || (received < 0 && errno != EAGAIN && errno != EINTR)) {
+            pair.closed = true;
+            return;
+        }
+        if (received < 0) return;
+        totals[direction].streamBytes += static_cast<size_t>(received);
+        Clock::time_point due = impairments[direction].streamDue(pair.lastDue[direction]);
+        pair.delayed[direction].emplace_back(due, std::string(buffer, static_cast<size_t>(received)));
+    }
+
+    // Sends every datagram and stream chunk whose delay has passed
+    void releaseDue() {
+        auto now = Clock::now();
+        while (!queue.empty() && queue.top().due <= now) {
+            const Delayed& delayed = queue.top();
+            sendto(delayed.fd, delayed.bytes.data(), delayed.bytes.size(), 0,
+                   reinterpret_cast<const sockaddr*>(&delayed.to), sizeof(delayed.to));
+            queue.pop();
+        }
+        for (auto& pair : pairs) {
+            for (int direction : {UP, DOWN}) {
+                auto& delayed = pair->delayed[direction];
+                while (!delayed.empty() && delayed.front().first <= now) {
+                    pair->output[direction] += delayed.front().second;
+                    delayed.pop_front();
+                }
+                std::string& output = pair->output[direction];
+                if (output.empty()) continue;
+                int fd = direction == UP ? pair->serverFd : pair->clientFd;
+                ssize_t written = send(fd, output.data(), output.size(), MSG_NOSIGNAL);
+                if (written > 0) output.erase(0, static_cast<size_t>(written));
+                else if (written < 0 && errno != EAGAIN) pair->closed = true;
+            }
+        }
+        pairs.erase(std::remove_if(pairs.begin(), pairs.end(),
+                                   [](const std::unique_ptr<TcpPair>& pair) {
+                                       // Data already read is still delivered before closing
+                                       bool drained = pair->delayed[UP].empty() && pair->delayed[DOWN].empty() &&
+                                                      pair->output[UP].empty() && pair->output[DOWN].empty();
+                                       if (!pair->closed || !drained) return false;
+                                       close(pair->clientFd);
+                                       close(pair->serverFd);
+                                       return true;
+                                   }),
+                    pairs.end());
+    }
+
+    void expireSessions() {
+        auto idleSince = Clock::now() - std::chrono::minutes(2);
+        sessions.erase(std::remove_if(sessions.begin(), sessions.end(),
+                                      [idleSince](const std::unique_ptr<UdpSession>& session) {
+                                          if (session->lastActivity > idleSince) return false;
+                                          close(session->upstreamFd);
+                                          if (session->downstreamFd >= 0) close(session->downstreamFd);
+                                          return true;
+                                      }),
+                       sessions.end());
+    }
+
+    int nextTimeoutMs() const {
+        Clock::time_point next = Clock::now() + std::chrono::seconds(1);
+        if (!queue.empty()) next = std::min(next, queue.top().due);
+        for (const auto& pair : pairs) {
+            for (int direction : {UP, DOWN}) {
+                if (!pair->delayed[direction].empty()) next = std::min(next, pair->delayed[direction].front().first);
+            }
+        }
+        auto wait = std::chrono::duration_cast<std::chrono::microseconds>(next - Clock::now()).count();
+        return wait <= 0 ? 0 : static_cast<int>((wait + 999) / 1000);
+    }
+
+    sockaddr_in serverAddr;
+    uint16_t listenPort;
+    Impairment impairments[2];
+    FILE* log;
+    int udpListen = -1;
+    int tcpListen = -1;
+    Clock::time_point start;
+    std::vector<std::unique_ptr<UdpSession>> sessions;
+    std::vector<std::unique_ptr<TcpPair>> pairs;
+    std::priority_queue<Delayed, std::vector<Delayed>, std::greater<Delayed>> queue;
+    uint64_t nextOrder = 0;
+    Counters totals[2];
+};
+
+bool resolveServer(const std::string& host, int port, sockaddr_in& addr) {
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host.c_str(), nullptr, &hints, &result) != 0 || result == nullptr) {
+        std::fprintf(stderr, "ERROR: Unable to resolve %s\n", host.c_str());
+        return false;
+    }
+    addr = *reinterpret_cast<sockaddr_in*>(result->ai_addr);
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    freeaddrinfo(result);
+    return true;
+}
+
+void printUsage() {
+    std::printf("Usage: ipk25proxy -s server [-p port] [-l listen_port] [--up PROFILE] [--down PROFILE]\n"
+                "                  [--profile PROFILE] [--seed N] [--log FILE]\n"
+                "PROFILE: comma-separated loss=P,dup=P,reorder=P,delay=MS,jitter=MS\n"
+                "         (up = client to server, down = server to client, --profile sets both)\n");
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    std::string server;
+    int serverPort = 4567;
+    uint16_t listenPort = 14567;
+    Profile up, down;
+    uint32_t seed = 1;
+    std::string logFile;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool ok = true;
+        if (arg == "-s" && i + 1 < argc) server = argv[++i];
+        else if (arg == "-p" && i + 1 < argc) serverPort = std::stoi(argv[++i]);
+        else if (arg == "-l" && i + 1 < argc) listenPort = static_cast<uint16_t>(std::stoi(argv[++i]));
+        else if (arg == "--up" && i + 1 < argc) ok = parseProfile(argv[++i], up);
+        else if (arg == "--down" && i + 1 < argc) ok = parseProfile(argv[++i], down);
+        else if (arg == "--profile" && i + 1 < argc) {
+            ++i;
+            ok = parseProfile(argv[i], up) && parseProfile(argv[i], down);
+        }
+        else if (arg == "--seed" && i + 1 < argc) seed = static_cast<uint32_t>(std::stoul(argv[++i]));
+        else if (arg == "--log" && i + 1 < argc) logFile = argv[++i];
+        else {
+            printUsage();
+            return arg == "-h" ? 0 : 1;
+        }
+        if (!ok) {
+            std::fprintf(stderr, "ERROR: Malformed profile: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    sockaddr_in serverAddr{};
+    if (server.empty()) {
+        printUsage();
+        return 1;
+    }
+    if (!resolveServer(server, serverPort, serverAddr)) return 1;
+
+    FILE* log = nullptr;
+    if (!logFile.empty()) {
+        log = logFile == "-" ? stdout : std::fopen(logFile.c_str(), "w");
+        if (log == nullptr) {
+            perror(("ERROR: Unable to open " + logFile).c_str());
+            return 1;
+        }
+    }
+
+    if (!ShutdownSignals::install()) return 1;
+    Proxy proxy(serverAddr, listenPort, up, down, seed, log);
+    if (!proxy.open()) return 1;
+    std::fprintf(stderr, "Proxy on port %d (UDP and TCP) to %s:%d, seed %u\n  up   %s\n  down %s\n", listenPort,
+                 server.c_str(), serverPort, seed, describe(up).c_str(), describe(down).c_str());
+    proxy.run();
+    if (log != nullptr && log != stdout) std::fclose(log);
+    proxy.printTotals();
+    return 0;
+}
@@ -0,0 +1,147 @@
+// Compares the two ways a local process can feed messages to the client: piping lines into
+// stdin and posting records into the shared-memory ring (--shm-ring). A forked producer sends
+// `-n` messages of `-s` bytes, the parent consumes them through the client's own InputLoop and
+// ShmInbox. Reports the rate and the consumer's CPU time and context switches per message.
+//
+// Usage: ipk25ringbench [-n messages] [-s size]
+#include "ShmInbox.h"
+#include "ShmRing.h"
+#include "Shutdown.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+struct Usage {
+    std::chrono::steady_clock::time_point wall;
+    double cpuSeconds;
+    long contextSwitches;
+
+    static Usage now() {
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+        double cpu = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+                     (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+        return {std::chrono::steady_clock::now(), cpu, usage.ru_nvcsw + usage.ru_nivcsw};
+    }
+};
+
+void report(const char* name, const Usage& start, const Usage& end, uint64_t count, uint64_t bytes) {
+    double seconds = std::chrono::duration<double>(end.wall - start.wall).count();
+    std::printf("%-22s %9.0f msg/s  %7.1f MB/s  consumer CPU %6.0f ns/msg  %6.3f switches/msg\n", name,
+                count / seconds, bytes / seconds / 1e6, (end.cpuSeconds - start.cpuSeconds) * 1e9 / count,
+                static_cast<double>(end.contextSwitches - start.contextSwitches) / count);
+}
+
+std::string makeMessage(size_t size) {
+    std::string message;
+    for (size_t i = 0; i < size; ++i) message.push_back(static_cast<char>('a' + i % 26));
+    return message;
+}
+
+// Producer writes lines into a pipe, one write(2) per message or buffered by stdio
+void benchStdin(uint64_t count, const std::string& message, bool buffered) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        perror("pipe");
+        std::exit(1);
+    }
+    pid_t child = fork();
+    if (child == 0) {
+        close(fds[0]);
+        std::string line = message + "\n";
+        if (buffered) {
+            FILE* out = fdopen(fds[1], "w");
+            for (uint64_t i = 0; i < count; ++i) std::fwrite(line.data(), 1, line.size(), out);
+            std::fclose(out);
+        } else {
+            for (uint64_t i = 0; i < count; ++i) {
+                if (write(fds[1], line.data(), line.size()) < 0) break;
+            }
+        }
+        _exit(0);
+    }
+    close(fds[1]);
+
+    Wakeup stop;
+    InputLoop input(stop, fds[0]);
+    std::string line;
+    uint64_t received = 0, bytes = 0;
+    Usage start = Usage::now();
+    while (input.next(line) == InputLoop::Event::LINE) {
+        received++;
+        bytes += line.size();
+    }
+    Usage end = Usage::now();
+    close(fds[0]);
+    waitpid(child, nullptr, 0);
+    report(buffered ? "stdin (stdio buffered)" : "stdin (write per msg)", start, end, received, bytes);
+}
+
+// Producer posts records into the ring, the parent drains them on SOURCE like the client does
+void benchRing(uint64_t count, const std::string& message) {
+    std::string path = "/tmp/ipk25ringbench." + std::to_string(getpid()) + ".sock";
+    pid_t child = fork();
+    if (child == 0) {
+        ShmRingProducer ring;
+        while (!ring.attach(path.c_str())) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        for (uint64_t i = 0; i < count; ++i) {
+            if (ring.post(message) != ShmRingProducer::Status::OK) _exit(1);
+        }
+        _exit(0);
+    }
+
+    ShmInbox inbox(path, 4096, static_cast<uint32_t>(message.size() + sizeof(ShmRingSlot)));
+    if (!inbox.start()) std::exit(1);
+    Wakeup stop;
+    InputLoop input(stop, -1, nullptr, inbox.fd());
+    std::string unused;
+    uint64_t received = 0, bytes = 0;
+    Usage start;
+    bool started = false;
+    while (received < count && input.next(unused) == InputLoop::Event::SOURCE) {
+        if (!started) {
+            start = Usage::now();  // From the first record, the producer attaches first
+            started = true;
+        }
+        inbox.drain([&](std::string_view text, uint32_t) {
+            received++;
+            bytes += text.size();
+            return true;
+        });
+    }
+    Usage end = Usage::now();
+    int status = 0;
+    waitpid(child, &status, 0);
+    inbox.stop();
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) std::fprintf(stderr, "ERROR: The ring producer failed\n");
+    report("shared-memory ring", start, end, received, bytes);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    uint64_t count = 1000000;
+    size_t size = 64;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-n" && i + 1 < argc) count = std::stoull(argv[++i]);
+        else if (arg == "-s" && i + 1 < argc) size = std::stoul(argv[++i]);
+        else {
+            std::printf("Usage: ipk25ringbench [-n messages] [-s size]\n");
+            return arg == "-h" ? 0 : 1;
+        }
+    }
+    std::string message = makeMessage(size);
+    std::printf("%llu messages of %zu bytes\n", static_cast<unsigned long long>(count), size);
+    benchStdin(count, message, false);
+    benchStdin(count, message, true);
+    benchRing(count, message);
+    return 0;
+}
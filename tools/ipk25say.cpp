@@ -0,0 +1,65 @@
+// Minimal consumer of libipk25chat: authenticates, optionally joins a channel, sends the given
+// messages and prints everything received until the drain after BYE. Linked against the
+// shared library to keep the embedding API honest.
+//
+// Usage: ipk25say -t tcp|udp -s server [-p port] -a user:secret:name [-c channel] [-w ms] message...
+#include "ChatSession.h"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+void usage() {
+    std::cerr << "Usage: ipk25say -t tcp|udp -s server [-p port] -a user:secret:name [-c channel] [-w ms] message...\n";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    ChatSessionConfig config;
+    std::string credentials;
+    std::string channel;
+    std::chrono::milliseconds linger(0);  // Time to keep receiving after the last message
+    std::vector<std::string> messages;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-t" && i + 1 < argc) config.transport = argv[++i];
+        else if (arg == "-s" && i + 1 < argc) config.server = argv[++i];
+        else if (arg == "-p" && i + 1 < argc) config.port = std::stoi(argv[++i]);
+        else if (arg == "-a" && i + 1 < argc) credentials = argv[++i];
+        else if (arg == "-c" && i + 1 < argc) channel = argv[++i];
+        else if (arg == "-w" && i + 1 < argc) linger = std::chrono::milliseconds(std::stoi(argv[++i]));
+        else messages.push_back(arg);
+    }
+    size_t first = credentials.find(':');
+    size_t second = first == std::string::npos ? first : credentials.find(':', first + 1);
+    if (config.server.empty() || second == std::string::npos) {
+        usage();
+        return 1;
+    }
+
+    std::atomic<bool> refused{false};
+    ChatEvents events = ChatEvents::console();
+    events.onReply = [&refused](bool ok, std::string_view content) {
+        std::cout << (ok ? "Action Success: " : "Action Failure: ") << content << std::endl;
+        if (!ok) refused = true;
+    };
+
+    auto session = ChatSession::open(config, events);
+    if (!session) return 1;
+
+    // No need to wait for the REPLYs: the session holds the messages until AUTH and JOIN are done
+    session->auth(credentials.substr(0, first), credentials.substr(first + 1, second - first - 1),
+                  credentials.substr(second + 1));
+    if (!channel.empty()) session->join(channel);
+    for (const std::string& message : messages) {
+        if (!session->send(message)) break;
+    }
+    std::this_thread::sleep_for(linger);
+    int status = session->close();
+    return refused ? 1 : status;
+}
@@ -0,0 +1,318 @@
+// Deterministic simulation of the chat clients over SimNetwork.
+// Runs the real UdpChatClient/TcpChatClient code single-threaded against a scripted server
+// on a virtual clock, so millions of exchanges under loss finish in seconds and every run
+// with the same seed produces the same numbers.
+//
+// Usage: ipk25sim [-t udp|tcp] [-n messages] [-w window] [-d timeout_ms] [-r retries]
+//                 [--loss P] [--dup P] [--delay us] [--jitter us] [--seed N] [--verbose]
+#include "Clock.h"
+#include "LatencyHistogram.h"
+#include "MessageUdp.h"
+#include "SimNetwork.h"
+#include "TcpChatClient.h"
+#include "UdpChatClient.h"
+#include "UdpCommandBuilder.h"
+#include <arpa/inet.h>
+#include <bitset>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint16_t SERVER_PORT = 4567;          // Port the client sends AUTH to
+constexpr uint16_t SERVER_SESSION_PORT = 4568;  // Dynamic port the server answers from
+constexpr uint16_t CLIENT_PORT = 50000;
+constexpr auto TICK = std::chrono::milliseconds(100);  // Same period as the client's retransmission thread
+
+struct Options {
+    std::string transport = "udp";
+    uint64_t messages = 100000;
+    int64_t window = 32;
+    int timeoutMs = 250;
+    int retries = 3;
+    bool verbose = false;
+    SimConfig network;
+};
+
+// Scripted UDP server: confirms everything, answers AUTH/JOIN with REPLY OK and retransmits
+// unconfirmed REPLYs. Duplicate detection uses a sliding half of the 16-bit ID space,
+// so it keeps working after message IDs wrap around.
+class SimUdpServer {
+public:
+    SimUdpServer(SimNetwork& network, Clock& clock, int timeoutMs)
+        : listenSocket(network.bindDatagram(SERVER_PORT)),
+          sessionSocket(network.bindDatagram(SERVER_SESSION_PORT)),
+          clock(clock),
+          timeout(timeoutMs) {}
+
+    void poll() {
+        drain(*listenSocket);
+        drain(*sessionSocket);
+    }
+
+    void retransmit() {
+        for (auto& entry : pendingReplies) {
+            if (clock.now() - entry.second.sentAt >= timeout) {
+                sessionSocket->sendTo(entry.second.data.data(), entry.second.data.size(), clientAddr);
+                entry.second.sentAt = clock.now();
+            }
+        }
+    }
+
+    bool replyConfirmed() const { return repliesSent > 0 && pendingReplies.empty(); }
+
+    uint64_t uniqueMessages = 0;
+    uint64_t duplicateMessages = 0;
+
+private:
+    struct PendingReply {
+        std::vector<uint8_t> data;
+        Clock::time_point sentAt;
+    };
+
+    std::unique_ptr<DatagramSocket> listenSocket;
+    std::unique_ptr<DatagramSocket> sessionSocket;
+    Clock& clock;
+    std::chrono::milliseconds timeout;
+    sockaddr_in clientAddr{};
+    std::bitset<65536> seen;
+    std::map<uint16_t, PendingReply> pendingReplies;
+    uint16_t nextId = 0;
+    uint64_t repliesSent = 0;
+
+    void drain(DatagramSocket& socket) {
+        uint8_t buffer[2048];
+        sockaddr_in from;
+        ssize_t n;
+        while ((n = socket.recvFrom(buffer, sizeof(buffer), from)) > 0) {
+            handle(buffer, static_cast<size_t>(n), from);
+        }
+    }
+
+    void handle(const uint8_t* data, size_t length, const sockaddr_in& from) {
+        if (length < 3) return;
+        clientAddr = from;
+        uint16_t netId;
+        std::memcpy(&netId, data + 1, sizeof(netId));
+        uint16_t id = ntohs(netId);
+        auto type = static_cast<UdpMessageType>(data[0]);
+
+        if (type == UdpMessageType::CONFIRM) {
+            pendingReplies.erase(id);
+            return;
+        }
+
+        std::vector<uint8_t> confirm = packUdpMessage(buildConfirmUdpMessage(id));
+        sessionSocket->sendTo(confirm.data(), confirm.size(), from);
+
+        if (seen[id]) {
+            duplicateMessages++;
+            return;
+        }
+        seen[id] = true;
+        seen[static_cast<uint16_t>(id + 32768)] = false;  // Forget the opposite half of the ID space
+
+        if (type == UdpMessageType::AUTH || type == UdpMessageType::JOIN) {
+            uint16_t replyId = nextId++;
+            std::vector<uint8_t> reply = packUdpMessage(buildReplyUdpMessage("Success.", replyId, id, 1));
+            sessionSocket->sendTo(reply.data(), reply.size(), from);
+            pendingReplies[replyId] = {reply, clock.now()};
+            repliesSent++;
+        } else if (type == UdpMessageType::MSG) {
+            uniqueMessages++;
+        }
+    }
+};
+
+// Scripted TCP server: answers AUTH/JOIN with REPLY OK and counts MSG lines
+class SimTcpServer {
+public:
+    explicit SimTcpServer(std::unique_ptr<StreamSocket> socket) : socket(std::move(socket)) {}
+
+    void poll() {
+        char buffer[4096];
+        ssize_t n;
+        while ((n = socket->read(buffer, sizeof(buffer))) > 0) {
+            pending.append(buffer, static_cast<size_t>(n));
+        }
+        size_t pos;
+        while ((pos = pending.find("\r\n")) != std::string::npos) {
+            std::string line = pending.substr(0, pos);
+            pending.erase(0, pos + 2);
+            if (line.rfind("AUTH", 0) == 0 || line.rfind("JOIN", 0) == 0) {
+                const std::string reply = "REPLY OK IS Success.\r\n";
+                socket->send(reply.data(), reply.size());
+                repliesSent++;
+            } else if (line.rfind("MSG", 0) == 0) {
+                uniqueMessages++;
+            }
+        }
+    }
+
+    uint64_t uniqueMessages = 0;
+    uint64_t repliesSent = 0;
+
+private:
+    std::unique_ptr<StreamSocket> socket;
+    std::string pending;
+};
+
+// Advances the virtual clock to the next packet delivery or retransmission tick
+template <typename Poll, typename Tick>
+void step(VirtualClock& clock, SimNetwork& network, Clock::time_point& nextTick, Poll poll, Tick tick) {
+    Clock::time_point next = nextTick;
+    Clock::time_point delivery;
+    if (network.nextDelivery(delivery) && delivery < next) next = delivery;
+    clock.advanceTo(next);
+    poll();
+    if (clock.now() >= nextTick) {
+        tick();
+        nextTick += TICK;
+    }
+}
+
+uint64_t confirmedCount() {
+    uint64_t total = 0;
+    for (const auto& histogram : latencyMetrics().confirmRtt) total += histogram.count();
+    return total;
+}
+
+void runUdp(const Options& options, VirtualClock& clock, SimNetwork& network, std::ostream& report) {
+    SimUdpServer server(network, clock, options.timeoutMs);
+    UdpChatClient client(network.bindDatagram(CLIENT_PORT), SimNetwork::address(SERVER_PORT),
+                         clock, options.timeoutMs, options.retries);
+    Clock::time_point nextTick = clock.now() + TICK;
+
+    auto poll = [&]() {
+        server.poll();
+        while (client.pollNetwork()) {
+        }
+    };
+    auto tick = [&]() {
+        client.pollRetransmissions();
+        server.retransmit();
+    };
+
+    client.handleInputLine("/auth sim secret simbot");
+    Clock::time_point authDeadline = clock.now() + std::chrono::seconds(60);
+    while (!server.replyConfirmed() && clock.now() < authDeadline) {
+        step(clock, network, nextTick, poll, tick);
+    }
+
+    uint64_t sent = 0;
+    while (sent < options.messages || client.inFlightMessages() > 0) {
+        while (sent < options.messages && client.inFlightMessages() < options.window) {
+            client.handleInputLine("message " + std::to_string(sent));
+            sent++;
+        }
+        step(clock, network, nextTick, poll, tick);
+    }
+
+    uint64_t confirmed = confirmedCount();
+    report << "  delivered (unique at server): " << server.uniqueMessages << "\n"
+           << "  duplicates seen by server:    " << server.duplicateMessages << "\n"
+           << "  retransmissions:              " << totalRetransmissions.load() << "\n"
+           << "  given up after -r retries:    " << (sent + 1 > confirmed ? sent + 1 - confirmed : 0) << "\n";
+}
+
+void runTcp(const Options& options, VirtualClock& clock, SimNetwork& network, std::ostream& report) {
+    auto sockets = network.connectStream();
+    TcpChatClient client(std::move(sockets.first), clock);
+    SimTcpServer server(std::move(sockets.second));
+    Clock::time_point nextTick = clock.now() + TICK;
+
+    auto poll = [&]() {
+        server.poll();
+        client.pollNetwork();
+    };
+    auto tick = []() {};
+
+    client.handleInputLine("/auth sim secret simbot");
+    while (server.repliesSent == 0) {
+        step(clock, network, nextTick, poll, tick);
+    }
+
+    uint64_t sent = 0;
+    while (server.uniqueMessages < options.messages) {
+        while (sent < options.messages && static_cast<int64_t>(sent - server.uniqueMessages) < options.window) {
+            client.handleInputLine("message " + std::to_string(sent));
+            sent++;
+        }
+        step(clock, network, nextTick, poll, tick);
+    }
+    report << "  delivered (at server):        " << server.uniqueMessages << "\n";
+}
+
+void printUsage() {
+    std::cout << "Usage: ipk25sim [-t udp|tcp] [-n messages] [-w window] [-d timeout_ms] [-r retries]\n"
+              << "                [--loss P] [--dup P] [--delay us] [--jitter us] [--seed N] [--verbose]\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-t" && i + 1 < argc) options.transport = argv[++i];
+        else if (arg == "-n" && i + 1 < argc) options.messages = std::stoull(argv[++i]);
+        else if (arg == "-w" && i + 1 < argc) options.window = std::stoll(argv[++i]);
+        else if (arg == "-d" && i + 1 < argc) options.timeoutMs = std::stoi(argv[++i]);
+        else if (arg == "-r" && i + 1 < argc) options.retries = std::stoi(argv[++i]);
+        else if (arg == "--loss" && i + 1 < argc) options.network.lossRate = std::stod(argv[++i]);
+        else if (arg == "--dup" && i + 1 < argc) options.network.duplicateRate = std::stod(argv[++i]);
+        else if (arg == "--delay" && i + 1 < argc) options.network.baseDelay = std::chrono::microseconds(std::stoll(argv[++i]));
+        else if (arg == "--jitter" && i + 1 < argc) options.network.jitter = std::chrono::microseconds(std::stoll(argv[++i]));
+        else if (arg == "--seed" && i + 1 < argc) options.network.seed = std::stoull(argv[++i]);
+        else if (arg == "--verbose") options.verbose = true;
+        else {
+            printUsage();
+            return arg == "-h" ? 0 : 1;
+        }
+    }
+    if (options.transport != "udp" && options.transport != "tcp") {
+        printUsage();
+        return 1;
+    }
+
+    // The clients print every message; keep the report on the original stdout and silence the rest
+    FILE* reportFile = fdopen(dup(STDOUT_FILENO), "w");
+    if (!options.verbose) {
+        std::freopen("/dev/null", "w", stdout);
+        std::freopen("/dev/null", "w", stderr);
+    }
+
+    VirtualClock clock;
+    SimNetwork network(clock, options.network);
+    auto wallStart = std::chrono::steady_clock::now();
+    Clock::time_point virtualStart = clock.now();
+
+    std::ostringstream report;
+    report << "Simulation " << options.transport << ": " << options.messages << " messages, window "
+           << options.window << ", seed " << options.network.seed << ", loss " << options.network.lossRate
+           << ", dup " << options.network.duplicateRate << ", delay " << options.network.baseDelay.count()
+           << "us + jitter " << options.network.jitter.count() << "us\n";
+
+    if (options.transport == "udp") {
+        runUdp(options, clock, network, report);
+    } else {
+        runTcp(options, clock, network, report);
+    }
+
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    double virtualSeconds = std::chrono::duration<double>(clock.now() - virtualStart).count();
+    report << "  packets sent/dropped/duplicated: " << network.packetsSent() << "/" << network.packetsDropped()
+           << "/" << network.packetsDuplicated() << "\n"
+           << "  virtual time: " << virtualSeconds << " s, wall time: " << wallSeconds << " s ("
+           << static_cast<uint64_t>(options.messages / (wallSeconds > 0 ? wallSeconds : 1)) << " messages/s)\n";
+    dumpLatencyMetrics(report);
+
+    std::fputs(report.str().c_str(), reportFile);
+    std::fclose(reportFile);
+    return 0;
+}